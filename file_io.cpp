@@ -91,8 +91,15 @@ void annotationFileLoad(const QString & filename, const bool mergeSkeleton, cons
             }
             state->mainWindow->loadCustomPreferences(fileName);
         });
-        getSpecificFile("mergelist.txt", [](auto & file){
+        bool binaryMergelistLoaded = false;
+        getSpecificFile("mergelist.bin", [&binaryMergelistLoaded](auto & file){
             Segmentation::singleton().mergelistLoad(file);
+            binaryMergelistLoaded = true;
+        });
+        getSpecificFile("mergelist.txt", [binaryMergelistLoaded](auto & file){
+            if (!binaryMergelistLoaded) {// a text copy next to the binary one is not kept
+                Segmentation::singleton().mergelistLoad(file);
+            }
         });
         getSpecificFile("microworker.txt", [](auto & file){
             Segmentation::singleton().jobLoad(file);
@@ -168,8 +175,13 @@ void annotationFileSave(const QString & filename) {
         }
         if (Segmentation::singleton().hasObjects()) {
             QuaZipFile file_write(&archive_write);
-            if (zipCreateFile(file_write, "mergelist.txt", 1)) {
-                Segmentation::singleton().mergelistSave(file_write);
+            const auto binary = Segmentation::singleton().binaryMergelist;
+            if (zipCreateFile(file_write, binary ? "mergelist.bin" : "mergelist.txt", 1)) {
+                if (binary) {
+                    Segmentation::singleton().mergelistSaveBinary(file_write);
+                } else {
+                    Segmentation::singleton().mergelistSave(file_write);
+                }
             } else {
                 throw std::runtime_error((filename + ": saving mergelist failed").toStdString());
             }
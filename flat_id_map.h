@@ -0,0 +1,153 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef FLAT_ID_MAP_H
+#define FLAT_ID_MAP_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Open-addressed (linear probing) map from 64 bit ids to small values.
+ * All slots live in one contiguous vector so lookups touch one or two cache lines
+ * instead of following the node chains of an unordered_map.
+ * Concurrent find calls are safe as long as nobody modifies the map meanwhile.
+ */
+template<typename T>
+class flat_id_map {
+    struct slot {
+        std::uint64_t id;
+        bool used{false};
+        T value;
+    };
+    std::vector<slot> slots;
+    std::size_t count{0};
+    std::size_t mask{0};
+
+    std::size_t home(const std::uint64_t id) const {
+        return static_cast<std::size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) & mask;// fibonacci hashing, ids are often consecutive
+    }
+    void rehash(const std::size_t capacity) {
+        auto old = std::move(slots);
+        slots = decltype(slots)(capacity);
+        mask = capacity - 1;
+        count = 0;
+        for (auto & entry : old) {
+            if (entry.used) {
+                emplace(entry.id, std::move(entry.value));
+            }
+        }
+    }
+
+public:
+    explicit flat_id_map(const std::size_t capacity = 64) {
+        reserve(capacity);
+    }
+    void clear() {
+        for (auto & entry : slots) {
+            entry.used = false;
+        }
+        count = 0;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+    std::size_t size() const {
+        return count;
+    }
+    void reserve(const std::size_t size) {
+        std::size_t capacity = 16;
+        while (capacity < 2 * size) {// keep the load factor at or below 1/2
+            capacity *= 2;
+        }
+        if (capacity > slots.size()) {
+            rehash(capacity);
+        }
+    }
+    const T * find(const std::uint64_t id) const {
+        for (auto i = home(id);; i = (i + 1) & mask) {
+            const auto & entry = slots[i];
+            if (!entry.used) {
+                return nullptr;
+            }
+            if (entry.id == id) {
+                return &entry.value;
+            }
+        }
+    }
+    T * find(const std::uint64_t id) {
+        return const_cast<T *>(static_cast<const flat_id_map &>(*this).find(id));
+    }
+    /**
+     * @brief emplace inserts or overwrites the value for id
+     */
+    T & emplace(const std::uint64_t id, T value) {
+        if (2 * (count + 1) > slots.size()) {
+            rehash(2 * slots.size());
+        }
+        for (auto i = home(id);; i = (i + 1) & mask) {
+            auto & entry = slots[i];
+            if (!entry.used) {
+                entry.id = id;
+                entry.used = true;
+                entry.value = std::move(value);
+                ++count;
+                return entry.value;
+            }
+            if (entry.id == id) {
+                entry.value = std::move(value);
+                return entry.value;
+            }
+        }
+    }
+    /**
+     * @brief erase removes id without tombstones by shifting the rest of its probe run back
+     */
+    bool erase(const std::uint64_t id) {
+        auto hole = home(id);
+        for (;; hole = (hole + 1) & mask) {
+            if (!slots[hole].used) {
+                return false;
+            }
+            if (slots[hole].id == id) {
+                break;
+            }
+        }
+        for (auto i = (hole + 1) & mask; slots[i].used; i = (i + 1) & mask) {
+            const auto target = home(slots[i].id);
+            // the entry may fill the hole if its home does not lie cyclically within (hole, i]
+            const bool movable = hole <= i ? (target <= hole || target > i) : (target <= hole && target > i);
+            if (movable) {
+                slots[hole].id = slots[i].id;
+                slots[hole].value = std::move(slots[i].value);
+                hole = i;
+            }
+        }
+        slots[hole].used = false;
+        --count;
+        return true;
+    }
+};
+
+#endif//FLAT_ID_MAP_H
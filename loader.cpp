@@ -25,6 +25,7 @@
 #include "functions.h"
 #include "network.h"
 #include "segmentation/segmentation.h"
+#include "segmentation/voxelstats.h"
 #include "session.h"
 #include "skeleton/skeletonizer.h"
 #include "stateInfo.h"
@@ -43,6 +44,7 @@
 #include <QNetworkReply>
 #include <QtConcurrent>
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <stdexcept>
@@ -71,6 +73,28 @@ void Loader::Controller::suspendLoader() {
     }
 }
 
+void transposeRawCube(const std::uint8_t * cube, std::uint8_t * transposed) {
+    const std::size_t edge = Dataset::current().cubeEdgeLength;
+    const std::size_t area = state->cubeSliceArea;
+    auto * zy = transposed;
+    auto * xz = transposed + state->cubeBytes;
+    const std::size_t block = 16;// transpose x and z in blocks which fit into the cache
+    for (std::size_t y = 0; y < edge; ++y) {
+        for (std::size_t zBlock = 0; zBlock < edge; zBlock += block) {
+            for (std::size_t xBlock = 0; xBlock < edge; xBlock += block) {
+                for (std::size_t z = zBlock; z < std::min(edge, zBlock + block); ++z) {
+                    for (std::size_t x = xBlock; x < std::min(edge, xBlock + block); ++x) {
+                        zy[x * area + y * edge + z] = cube[z * area + y * edge + x];
+                    }
+                }
+            }
+        }
+        for (std::size_t z = 0; z < edge; ++z) {// rows along x stay contiguous
+            std::copy_n(cube + z * area + y * edge, edge, xz + y * area + z * edge);
+        }
+    }
+}
+
 Loader::Controller::~Controller() {
     suspendLoader();
 }
@@ -83,9 +107,18 @@ void Loader::Controller::unloadCurrentMagnification() {
 void Loader::Controller::markOcCubeAsModified(const CoordOfCube &cubeCoord, const int magnification) {
     emit markOcCubeAsModifiedSignal(cubeCoord, magnification);
     state->viewer->window->notifyUnsavedChanges();
+    VoxelStatsIndex::singleton().cubeEdited(cubeCoord, magnification);
     state->viewer->oc_reslice_notify_all(cubeCoord.cube2Global(Dataset::current().cubeEdgeLength, magnification));
 }
 
+void Loader::Controller::setTransposedCubesBudget(const std::size_t bytes) {
+    const auto previous = transposedCubesBudget.exchange(bytes);
+    if (bytes < previous && worker != nullptr) {
+        //dispatch to loader thread, which owns the slots
+        QTimer::singleShot(0, worker.get(), &Loader::Worker::trimTransposedSlots);
+    }
+}
+
 decltype(Loader::Worker::snappyCache) Loader::Controller::getAllModifiedCubes() {
     if (worker != nullptr) {
         worker->snappyMutex.lock();
@@ -201,6 +234,7 @@ std::vector<CoordOfCube> Loader::Worker::DcoiFromPos(const CoordOfCube & current
 
 Loader::Worker::Worker(const decltype(datasets) & datasets)
     : datasets{datasets}, OcModifiedCacheQueue(std::log2(Dataset::current().highestAvailableMag)+1), snappyCache(std::log2(Dataset::current().highestAvailableMag)+1)
+    , pinnedUnloads(std::log2(Dataset::current().highestAvailableMag)+1)
 {
 
     // freeDcSlots / freeOcSlots are lists of pointers to locations that
@@ -215,6 +249,8 @@ Loader::Worker::Worker(const decltype(datasets) & datasets)
         freeDcSlots.emplace_back(DcSetChunk.back().data());//append newest element
     }
 
+    VoxelStatsIndex::singleton().clear();// cubes of the previous dataset, this also creates the index in the gui thread
+
     if(Dataset::current().overlay) {
         allocateOverlayCubes();
     }
@@ -238,6 +274,53 @@ Loader::Worker::~Worker() {
     state->protectCube2Pointer.lock();
     for (auto &elem : state->Dc2Pointer) { elem.clear(); }
     for (auto &elem : state->Oc2Pointer) { elem.clear(); }
+    for (auto &elem : state->DcTransposed2Pointer) { elem.clear(); }
+    state->protectCube2Pointer.unlock();
+}
+
+void * Loader::Worker::takeTransposedSlot() {
+    const auto slotBytes = 2 * state->cubeBytes;
+    const auto slotsInUse = TransposedSetChunk.size() - freeTransposedSlots.size();
+    if ((slotsInUse + 1) * slotBytes > Loader::Controller::singleton().transposedCubesBudget) {
+        return nullptr;
+    }
+    if (freeTransposedSlots.empty()) {
+        TransposedSetChunk.emplace_back(slotBytes);
+        freeTransposedSlots.emplace_back(TransposedSetChunk.back().data());
+    }
+    auto * slot = freeTransposedSlots.front();
+    freeTransposedSlots.pop_front();
+    return slot;
+}
+
+void Loader::Worker::releaseTransposedSlot(const CoordOfCube & cubeCoord) {// protectCube2Pointer has to be locked
+    auto & transposedCubes = state->DcTransposed2Pointer[loaderMagnification];
+    auto it = transposedCubes.find(cubeCoord);
+    if (it != std::end(transposedCubes)) {
+        freeTransposedSlots.emplace_back(it->second);
+        transposedCubes.erase(it);
+    }
+}
+
+/**
+ * @brief Loader::Worker::trimTransposedSlots frees the transposed slots exceeding a lowered budget,
+ *      transposed copies in use are dropped first, the viewer slices their raw cubes meanwhile.
+ *      Slots of decompressions in flight are returned to the free list and trimmed with the next call.
+ */
+void Loader::Worker::trimTransposedSlots() {
+    const auto slotBytes = 2 * state->cubeBytes;
+    const std::size_t budgetSlots = Loader::Controller::singleton().transposedCubesBudget / slotBytes;
+    state->protectCube2Pointer.lock();
+    auto & transposedCubes = state->DcTransposed2Pointer[loaderMagnification];
+    while (TransposedSetChunk.size() - freeTransposedSlots.size() > budgetSlots && !transposedCubes.empty()) {
+        freeTransposedSlots.emplace_back(std::begin(transposedCubes)->second);
+        transposedCubes.erase(std::begin(transposedCubes));
+    }
+    while (TransposedSetChunk.size() > budgetSlots && !freeTransposedSlots.empty()) {
+        const auto * slot = freeTransposedSlots.back();
+        freeTransposedSlots.pop_back();
+        TransposedSetChunk.remove_if([slot](const std::vector<std::uint8_t> & chunk){ return chunk.data() == slot; });
+    }
     state->protectCube2Pointer.unlock();
 }
 
@@ -267,20 +350,64 @@ void Loader::Worker::unloadCurrentMagnification() {
         freeDcSlots.emplace_back(elem.second);
     }
     state->Dc2Pointer[loaderMagnification].clear();
-    for (auto &elem : state->Oc2Pointer[loaderMagnification]) {
-        const auto cubeCoord = elem.first;
-        const auto remSlotPtr = elem.second;
-        freeOcSlots.emplace_back(elem.second);
-        if (OcModifiedCacheQueue[loaderMagnification].find(cubeCoord) != std::end(OcModifiedCacheQueue[loaderMagnification])) {
-            snappyCacheBackupRaw(cubeCoord, remSlotPtr);
-            //remove from work queue
-            OcModifiedCacheQueue[loaderMagnification].erase(cubeCoord);
-        }
+    for (auto &elem : state->DcTransposed2Pointer[loaderMagnification]) {
+        freeTransposedSlots.emplace_back(elem.second);
+    }
+    state->DcTransposed2Pointer[loaderMagnification].clear();
+    std::vector<CoordOfCube> ocCubes;
+    for (const auto & elem : state->Oc2Pointer[loaderMagnification]) {
+        ocCubes.emplace_back(elem.first);
+    }
+    for (const auto & cubeCoord : ocCubes) {
+        unloadOcCube(loaderMagnification, cubeCoord, true);
     }
-    state->Oc2Pointer[loaderMagnification].clear();
     state->protectCube2Pointer.unlock();
 }
 
+/**
+ * @brief Loader::Worker::unloadOcCube returns the slot of an overlay cube, the caller has to hold protectCube2Pointer.
+ *      Cubes pinned by a VoxelCursor or an open edit keep their slot until unloadUnpinnedCubes finds them unpinned.
+ */
+void Loader::Worker::unloadOcCube(const std::size_t mag, const CoordOfCube & cubeCoord, const bool backup) {
+    if (state->OcPinned[mag].find(cubeCoord) != std::end(state->OcPinned[mag])) {
+        auto it = pinnedUnloads[mag].find(cubeCoord);
+        if (it == std::end(pinnedUnloads[mag])) {
+            pinnedUnloads[mag].emplace(cubeCoord, backup);
+        } else {
+            it->second = it->second && backup;// discarding the cube takes precedence
+        }
+        return;
+    }
+    auto it = state->Oc2Pointer[mag].find(cubeCoord);
+    if (it == std::end(state->Oc2Pointer[mag])) {
+        return;
+    }
+    if (backup && OcModifiedCacheQueue[mag].find(cubeCoord) != std::end(OcModifiedCacheQueue[mag])) {
+        snappyCacheBackupRaw(mag, cubeCoord, it->second);
+        //remove from work queue
+        OcModifiedCacheQueue[mag].erase(cubeCoord);
+    } else if (backup && snappyCache[mag].find(cubeCoord) == std::end(snappyCache[mag])) {
+        VoxelStatsIndex::singleton().collapseCube(mag, cubeCoord);// it loads unchanged from the dataset again
+    }
+    freeOcSlots.emplace_back(it->second);
+    state->Oc2Pointer[mag].erase(it);
+}
+
+void Loader::Worker::unloadUnpinnedCubes() {
+    for (std::size_t mag = 0; mag < pinnedUnloads.size(); ++mag) {
+        for (auto it = std::begin(pinnedUnloads[mag]); it != std::end(pinnedUnloads[mag]);) {
+            if (state->OcPinned[mag].find(it->first) == std::end(state->OcPinned[mag])) {
+                const auto cubeCoord = it->first;
+                const auto backup = it->second;
+                it = pinnedUnloads[mag].erase(it);
+                unloadOcCube(mag, cubeCoord, backup);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
 void Loader::Worker::markOcCubeAsModified(const CoordOfCube &cubeCoord, const int magnification) {
     OcModifiedCacheQueue[std::log2(magnification)].emplace(cubeCoord);
 }
@@ -288,6 +415,7 @@ void Loader::Worker::markOcCubeAsModified(const CoordOfCube &cubeCoord, const in
 void Loader::Worker::snappyCacheSupplySnappy(const CoordOfCube cubeCoord, const int magnification, const std::string cube) {
     const auto cubeMagnification = std::log2(magnification);
     snappyCache[cubeMagnification].emplace(std::piecewise_construct, std::forward_as_tuple(cubeCoord), std::forward_as_tuple(cube));
+    VoxelStatsIndex::singleton().uncollapseCube(cubeMagnification, cubeCoord);
 
     if (cubeMagnification == loaderMagnification) {//unload if currently loaded
         const auto globalCoord = cubeCoord.cube2Global(Dataset::current().cubeEdgeLength, magnification);
@@ -300,34 +428,37 @@ void Loader::Worker::snappyCacheSupplySnappy(const CoordOfCube cubeCoord, const
             decompressionIt->second->waitForFinished();
         }
         state->protectCube2Pointer.lock();
-        const auto coord = cubeCoord;
-        auto cubePtr = Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[loaderMagnification], coord);
-        if (cubePtr != nullptr) {
-            freeOcSlots.emplace_back(cubePtr);
-            state->Oc2Pointer[loaderMagnification].erase(coord);
-        }
+        unloadOcCube(loaderMagnification, cubeCoord, false);// the supplied cube replaces it
         state->protectCube2Pointer.unlock();
     }
 }
 
-void Loader::Worker::snappyCacheBackupRaw(const CoordOfCube & cubeCoord, const void * cube) {
+void Loader::Worker::snappyCacheBackupRaw(const std::size_t mag, const CoordOfCube & cubeCoord, const void * cube) {
     //insert empty string into snappy cache
-    auto snappyIt = snappyCache[loaderMagnification].emplace(std::piecewise_construct, std::forward_as_tuple(cubeCoord), std::forward_as_tuple()).first;
+    auto snappyIt = snappyCache[mag].emplace(std::piecewise_construct, std::forward_as_tuple(cubeCoord), std::forward_as_tuple()).first;
     //compress cube into the new string
     snappy::Compress(reinterpret_cast<const char *>(cube), OBJID_BYTES * state->cubeBytes, &snappyIt->second);
 }
 
 void Loader::Worker::snappyCacheClear() {
     //unload all modified cubes
+    state->protectCube2Pointer.lock();
     for (std::size_t mag = 0; mag < OcModifiedCacheQueue.size(); ++mag) {
-        unloadCubes(state->Oc2Pointer[mag], freeOcSlots, [this, mag](const CoordOfCube & cubeCoord){
-            const bool unflushed = OcModifiedCacheQueue[mag].find(cubeCoord) != std::end(OcModifiedCacheQueue[mag]);
-            const bool flushed = snappyCache[mag].find(cubeCoord) != std::end(snappyCache[mag]);
-            return !unflushed && !flushed;//only keep cubes which are neither in snappy cache nor in modified queue
-        });
+        std::vector<CoordOfCube> modifiedCubes;
+        for (const auto & elem : state->Oc2Pointer[mag]) {
+            const bool unflushed = OcModifiedCacheQueue[mag].find(elem.first) != std::end(OcModifiedCacheQueue[mag]);
+            const bool flushed = snappyCache[mag].find(elem.first) != std::end(snappyCache[mag]);
+            if (unflushed || flushed) {//keep only cubes which are neither in snappy cache nor in modified queue
+                modifiedCubes.emplace_back(elem.first);
+            }
+        }
+        for (const auto & cubeCoord : modifiedCubes) {
+            unloadOcCube(mag, cubeCoord, false);
+        }
         OcModifiedCacheQueue[mag].clear();
         snappyCache[mag].clear();
     }
+    state->protectCube2Pointer.unlock();
     state->viewer->loader_notify();//a bit of a detour…
 }
 
@@ -340,7 +471,7 @@ void Loader::Worker::flushIntoSnappyCache() {
             auto cube = Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[mag], {cubeCoord.x, cubeCoord.y, cubeCoord.z});
             state->protectCube2Pointer.unlock();
             if (cube != nullptr) {
-                snappyCacheBackupRaw(cubeCoord, cube);
+                snappyCacheBackupRaw(mag, cubeCoord, cube);
             }
         }
         //clear work queue
@@ -391,7 +522,11 @@ void Loader::Worker::abortDownloadsFinishDecompression(Func keep) {
     finishDecompression(ocDecompression, keep);
 }
 
-std::pair<bool, void*> decompressCube(void * currentSlot, QIODevice & reply, const Dataset dataset, coord2bytep_map_t & cubeHash, const Coordinate globalCoord) {
+void indexOverlayCube(const Dataset & dataset, const Coordinate & globalCoord, const void * slot) {// before the cube becomes visible for edits
+    VoxelStatsIndex::singleton().publishCube(globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification), dataset.cubeEdgeLength, dataset.magnification, reinterpret_cast<const std::uint64_t *>(slot));
+}
+
+std::pair<bool, void*> decompressCube(void * currentSlot, void * transposedSlot, QIODevice & reply, const Dataset dataset, coord2bytep_map_t & cubeHash, const Coordinate globalCoord) {
     if (!reply.isOpen()) {// sanity check, finished replies with no error should be ready for reading (https://bugreports.qt.io/browse/QTBUG-45944)
         return {false, currentSlot};
     }
@@ -449,8 +584,17 @@ std::pair<bool, void*> decompressCube(void * currentSlot, QIODevice & reply, con
     }
 
     if (success) {
+        if (transposedSlot != nullptr) {
+            transposeRawCube(reinterpret_cast<std::uint8_t *>(currentSlot), reinterpret_cast<std::uint8_t *>(transposedSlot));
+        }
+        if (dataset.isOverlay()) {
+            indexOverlayCube(dataset, globalCoord, currentSlot);
+        }
         state->protectCube2Pointer.lock();
         cubeHash[globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification)] = currentSlot;
+        if (transposedSlot != nullptr) {
+            state->DcTransposed2Pointer[int_log(dataset.magnification)][globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification)] = transposedSlot;
+        }
         state->protectCube2Pointer.unlock();
         if (dataset.isOverlay()) {
             state->viewer->oc_reslice_notify_all(globalCoord);
@@ -465,17 +609,26 @@ std::pair<bool, void*> decompressCube(void * currentSlot, QIODevice & reply, con
 void Loader::Worker::cleanup(const Coordinate center) {
     abortDownloadsFinishDecompression(currentlyVisibleWrap(center));
     state->protectCube2Pointer.lock();
-    unloadCubes(state->Dc2Pointer[loaderMagnification], freeDcSlots, insideCurrentSupercubeWrap(center, datasets[0]));
+    unloadCubes(state->Dc2Pointer[loaderMagnification], freeDcSlots, insideCurrentSupercubeWrap(center, datasets[0])
+                , [this](const CoordOfCube & cubeCoord, void *){
+        releaseTransposedSlot(cubeCoord);
+    });
     if (datasets.size() > 1) {
-        unloadCubes(state->Oc2Pointer[loaderMagnification], freeOcSlots, insideCurrentSupercubeWrap(center, datasets[1])
-                , [this](const CoordOfCube & cubeCoord, void * remSlotPtr){
+        const auto insideSupercube = insideCurrentSupercubeWrap(center, datasets[1]);
+        const auto & pinned = state->OcPinned[loaderMagnification];
+        unloadCubes(state->Oc2Pointer[loaderMagnification], freeOcSlots, [&insideSupercube, &pinned](const CoordOfCube & coord){
+            return insideSupercube(coord) || pinned.find(coord) != std::end(pinned);
+        }, [this](const CoordOfCube & cubeCoord, void * remSlotPtr){
             if (OcModifiedCacheQueue[loaderMagnification].find(cubeCoord) != std::end(OcModifiedCacheQueue[loaderMagnification])) {
-                snappyCacheBackupRaw(cubeCoord, remSlotPtr);
+                snappyCacheBackupRaw(loaderMagnification, cubeCoord, remSlotPtr);
                 //remove from work queue
                 OcModifiedCacheQueue[loaderMagnification].erase(cubeCoord);
+            } else if (snappyCache[loaderMagnification].find(cubeCoord) == std::end(snappyCache[loaderMagnification])) {
+                VoxelStatsIndex::singleton().collapseCube(loaderMagnification, cubeCoord);// it loads unchanged from the dataset again
             }
         });
     }
+    unloadUnpinnedCubes();
     state->protectCube2Pointer.unlock();
 }
 
@@ -536,6 +689,11 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                     }
                     const auto cubeCoord = globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification);
                     state->protectCube2Pointer.lock();
+                    const auto & pinned = state->OcPinned[loaderMagnification];
+                    if (pinned.find(cubeCoord) != std::end(pinned)) {// don’t overwrite a cube that is being edited
+                        state->protectCube2Pointer.unlock();
+                        return;
+                    }
                     auto * currentSlot = Coordinate2BytePtr_hash_get_or_fail(cubeHash, cubeCoord);
                     cubeHash.erase(cubeCoord);
                     state->protectCube2Pointer.unlock();
@@ -546,6 +704,7 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                     //directly uncompress snappy cube into the OC slot
                     const auto success = snappy::RawUncompress(snappyIt->second.c_str(), snappyIt->second.size(), reinterpret_cast<char*>(currentSlot));
                     if (success) {
+                        indexOverlayCube(dataset, globalCoord, currentSlot);
                         state->protectCube2Pointer.lock();
                         cubeHash[globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification)] = currentSlot;
                         state->protectCube2Pointer.unlock();
@@ -575,6 +734,9 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                     auto * currentSlot = freeSlots.front();
                     freeSlots.pop_front();
                     std::fill(reinterpret_cast<std::uint8_t *>(currentSlot), reinterpret_cast<std::uint8_t *>(currentSlot) + state->cubeBytes * (dataset.isOverlay() ? OBJID_BYTES : 1), 0);
+                    if (dataset.isOverlay()) {
+                        indexOverlayCube(dataset, globalCoord, currentSlot);
+                    }
                     state->protectCube2Pointer.lock();
                     cubeHash[globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification)] = currentSlot;
                     state->protectCube2Pointer.unlock();
@@ -629,11 +791,13 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                 if (reply->error() == QNetworkReply::NoError) {
                     auto * currentSlot = freeSlots.front();
                     freeSlots.pop_front();
+                    auto * transposedSlot = dataset.isOverlay() ? nullptr : takeTransposedSlot();
                     auto * watcher = new QFutureWatcher<DecompressionResult>;
-                    QObject::connect(watcher, &QFutureWatcher<DecompressionResult>::finished, [this, reply, dataset, &freeSlots, &decompressions, globalCoord, watcher, currentSlot](){
+                    QObject::connect(watcher, &QFutureWatcher<DecompressionResult>::finished, [this, reply, dataset, &freeSlots, &decompressions, globalCoord, watcher, currentSlot, transposedSlot](){
+                        bool success = false;
                         if (!watcher->isCanceled()) {
                             auto result = watcher->result();
-
+                            success = result.first;
                             if (!result.first) {//decompression unsuccessful
                                 qCritical() << globalCoord << static_cast<int>(dataset.type) << "decompression failed → no fill";
                                 freeSlots.emplace_back(result.second);
@@ -642,18 +806,24 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                             qCritical() << globalCoord << static_cast<int>(dataset.type) << "future canceled";
                             freeSlots.emplace_back(currentSlot);
                         }
+                        if (!success && transposedSlot != nullptr) {
+                            freeTransposedSlots.emplace_back(transposedSlot);
+                        }
                         reply->deleteLater();
                         decompressions.erase(globalCoord);
                         broadcastProgress();
                     });
                     decompressions[globalCoord].reset(watcher);
                     downloads.erase(globalCoord);
-                    watcher->setFuture(QtConcurrent::run(&decompressionPool, std::bind(&decompressCube, currentSlot, std::ref(*reply), dataset, std::ref(cubeHash), globalCoord)));
+                    watcher->setFuture(QtConcurrent::run(&decompressionPool, std::bind(&decompressCube, currentSlot, transposedSlot, std::ref(*reply), dataset, std::ref(cubeHash), globalCoord)));
                 } else {
                     if (reply->error() == QNetworkReply::ContentNotFoundError) {//404 → fill
                         auto * currentSlot = freeSlots.front();
                         freeSlots.pop_front();
                         std::fill(reinterpret_cast<std::uint8_t *>(currentSlot), reinterpret_cast<std::uint8_t *>(currentSlot) + state->cubeBytes * (dataset.isOverlay() ? OBJID_BYTES : 1), 0);
+                        if (dataset.isOverlay()) {
+                            indexOverlayCube(dataset, globalCoord, currentSlot);
+                        }
                         state->protectCube2Pointer.lock();
                         cubeHash[globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification)] = currentSlot;
                         state->protectCube2Pointer.unlock();
@@ -58,6 +58,11 @@
 #define LM_FTP      1
 
 bool currentlyVisibleWrapWrap(const Coordinate & center, const Coordinate & coord);
+/**
+ * @brief transposeRawCube writes the zy layout (x slowest, z fastest) of a raw cube into the first cubeBytes of transposed
+ *      and the xz layout (y slowest, x fastest) into the second cubeBytes. See stateInfo::DcTransposed2Pointer.
+ */
+void transposeRawCube(const std::uint8_t * cube, std::uint8_t * transposed);
 
 namespace Loader{
 class Controller;
@@ -88,6 +93,8 @@ private:
     std::list<std::vector<std::uint8_t>> OcSetChunk;
     std::list<void*> freeDcSlots;
     std::list<void*> freeOcSlots;
+    std::list<std::vector<std::uint8_t>> TransposedSetChunk;
+    std::list<void*> freeTransposedSlots;
     int currentMaxMetric;
 
     std::atomic_bool isFinished{false};
@@ -96,7 +103,13 @@ private:
     floatCoordinate find_close_xyz(floatCoordinate direction);
     std::vector<CoordOfCube> DcoiFromPos(const CoordOfCube & currentOrigin, const UserMoveType userMoveType, const floatCoordinate & direction);
     uint loadCubes();
-    void snappyCacheBackupRaw(const CoordOfCube &, const void * cube);
+    void snappyCacheBackupRaw(const std::size_t mag, const CoordOfCube &, const void * cube);
+    std::vector<std::unordered_map<CoordOfCube, bool>> pinnedUnloads;// by mag, whether their modifications are to be backed up
+    void unloadOcCube(const std::size_t mag, const CoordOfCube & cubeCoord, const bool backup);
+    void unloadUnpinnedCubes();
+    void * takeTransposedSlot();
+    void releaseTransposedSlot(const CoordOfCube & cubeCoord);
+    void trimTransposedSlots();
     void snappyCacheClear();
 
     void abortDownloadsFinishDecompression();
@@ -136,6 +149,8 @@ class Controller : public QObject {
 public:
     std::unique_ptr<Loader::Worker> worker;
     std::atomic_uint loadingNr{0};
+    // memory for transposed copies of raw cubes (2 × cubeBytes each), 0 disables them
+    std::atomic<std::size_t> transposedCubesBudget{0};
     static Controller & singleton(){
         static Loader::Controller & loader = *new Loader::Controller;
         return loader;
@@ -143,6 +158,7 @@ public:
     void suspendLoader();
     ~Controller();
     void unloadCurrentMagnification();
+    void setTransposedCubesBudget(const std::size_t bytes);// frees the surplus slots when lowered
     void enableOverlay() {
         suspendLoader();
         worker->allocateOverlayCubes();
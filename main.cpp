@@ -149,7 +149,7 @@ int main(int argc, char *argv[]) {
     Scripting scripts;
     state.mainWindow->loadSettings();// load settings after viewer and window are accessible through state and viewer
     state.mainWindow->widgetContainer.datasetLoadWidget.loadDataset();// load last used dataset or show
-    viewer.timer.start(0);
+    viewer.requestFrame();
 #ifdef NDEBUG
     splash.finish(state.mainWindow);
 #endif
@@ -0,0 +1,53 @@
+#version 110
+
+uniform sampler3D volumeTexture;
+uniform sampler3D occupancyTexture;
+uniform mat4 texture_matrix;// screen slab to volume texture coordinates
+uniform int stepCount;// samples across the whole slab
+uniform float referenceSteps;// sample count the opacity is given for
+uniform float occupancyBlocks;// edge length of the occupancy grid
+uniform float opacity;
+varying vec2 screenPos;
+
+void main() {
+    vec2 st = vec2(0.5 * (screenPos.x + 1.0), 0.5 * (1.0 - screenPos.y));
+    vec3 front = (texture_matrix * vec4(st, 1.0, 1.0)).xyz;
+    vec3 back = (texture_matrix * vec4(st, 0.0, 1.0)).xyz;
+    vec3 dir = back - front;
+    vec3 invDir = 1.0 / (dir + vec3(equal(dir, vec3(0.0))) * 1e-6);
+    // only march the part of the ray inside the volume
+    vec3 tEnter = min(-front * invDir, (vec3(1.0) - front) * invDir);
+    vec3 tLeave = max(-front * invDir, (vec3(1.0) - front) * invDir);
+    float tNear = max(max(max(tEnter.x, tEnter.y), tEnter.z), 0.0);
+    float tFar = min(min(min(tLeave.x, tLeave.y), tLeave.z), 1.0);
+    if (tNear >= tFar) {
+        discard;
+    }
+
+    float stepSize = 1.0 / float(stepCount);
+    float alphaExponent = referenceSteps / float(stepCount);
+    vec4 color = vec4(0.0);
+    float t = stepSize * (ceil(tNear / stepSize - 0.5) + 0.5);// samples stay on the same grid when skipping
+    for (int i = 0; i < stepCount; ++i) {
+        if (t >= tFar || color.a >= 0.99) {// early ray termination
+            break;
+        }
+        vec3 pos = front + t * dir;
+        if (texture3D(occupancyTexture, pos).r == 0.0) {// jump to where the ray leaves the empty block
+            vec3 exitPlane = (floor(pos * occupancyBlocks) + step(0.0, dir)) / occupancyBlocks;
+            vec3 tExit = (exitPlane - front) * invDir;
+            float leave = min(min(tExit.x, tExit.y), tExit.z);
+            t = max(t + stepSize, stepSize * (ceil(leave / stepSize - 0.5) + 0.5));
+            continue;
+        }
+        vec4 voxel = texture3D(volumeTexture, pos);
+        float alpha = 1.0 - pow(1.0 - voxel.a * opacity, alphaExponent);
+        color.rgb += (1.0 - color.a) * alpha * voxel.rgb;
+        color.a += (1.0 - color.a) * alpha;
+        t += stepSize;
+    }
+    if (color.a == 0.0) {
+        discard;
+    }
+    gl_FragColor = vec4(color.rgb / color.a, color.a);
+}
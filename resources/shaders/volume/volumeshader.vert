@@ -0,0 +1,9 @@
+#version 110
+
+attribute vec2 vertex;
+varying vec2 screenPos;
+
+void main() {
+    gl_Position = vec4(vertex, 0.0, 1.0);
+    screenPos = vertex;
+}
@@ -26,6 +26,7 @@
 #include "functions.h"
 #include "loader.h"
 #include "segmentation/cubeloader.h"
+#include "segmentation/editjournal.h"
 #include "skeleton/node.h"
 #include "skeleton/skeletonizer.h"
 #include "skeleton/tree.h"
@@ -37,6 +38,7 @@
 
 #include <QApplication>
 #include <QFile>
+#include <QMutexLocker>
 
 void PythonProxy::annotationLoad(const QString & filename, const bool merge) {
     state->mainWindow->openFileDispatch({filename}, merge, true);
@@ -125,6 +127,11 @@ bool PythonProxy::writeDc2Pointer(QList<int> coord, char *bytes) {
     }
 
     memcpy(data, bytes, state->cubeBytes);
+    QMutexLocker locker(&state->protectCube2Pointer);
+    auto * transposed = Coordinate2BytePtr_hash_get_or_fail(state->DcTransposed2Pointer[int_log(Dataset::current().magnification)], coord);
+    if (transposed != nullptr) {
+        transposeRawCube(reinterpret_cast<std::uint8_t *>(data), reinterpret_cast<std::uint8_t *>(transposed));
+    }
     return true;
 }
 
@@ -135,6 +142,14 @@ bool PythonProxy::writeDc2PointerPos(QList<int> coord, int pos, int val) {
     }
 
     data[pos] = val;
+    QMutexLocker locker(&state->protectCube2Pointer);
+    auto * transposed = reinterpret_cast<char *>(Coordinate2BytePtr_hash_get_or_fail(state->DcTransposed2Pointer[int_log(Dataset::current().magnification)], coord));
+    if (transposed != nullptr) {// zy and xz layout
+        const auto edge = Dataset::current().cubeEdgeLength;
+        const int x = pos % edge, y = (pos / edge) % edge, z = pos / state->cubeSliceArea;
+        transposed[x * state->cubeSliceArea + y * edge + z] = val;
+        transposed[state->cubeBytes + y * state->cubeSliceArea + z * edge + x] = val;
+    }
     return true;
 }
 
@@ -178,6 +193,7 @@ bool PythonProxy::writeOc2PointerPos(QList<int> coord, int pos, quint64 val) {
 
 QVector<int> PythonProxy::processRegionByStridedBufProxy(QList<int> globalFirst, QList<int> size,
                              quint64 dataPtr, QList<int> strides, bool isWrite, bool isMarkChanged) {
+    EditJournal::ScopedEdit edit;// script writes are undone like brush strokes
     auto cubeChangeSet = processRegionByStridedBuf(Coordinate(globalFirst), Coordinate(globalFirst) + Coordinate(size) - 1, (char*)dataPtr, Coordinate(strides), isWrite, isMarkChanged);
     QVector<int> cubeChangeSetVector;
     for (auto &elem : cubeChangeSet) {
@@ -200,9 +216,30 @@ quint64 PythonProxy::readOverlayVoxel(QList<int> coord) {
 }
 
 bool PythonProxy::writeOverlayVoxel(QList<int> coord, quint64 val) {
+    EditJournal::ScopedEdit edit;
     return writeVoxel(coord, val);
 }
 
+QList<quint64> PythonProxy::readOverlayVoxels(QList<int> coords) {// flat list of x, y, z triples
+    VoxelCursor cursor;
+    QList<quint64> vals;
+    vals.reserve(coords.size() / 3);
+    for (int i = 0; i + 2 < coords.size(); i += 3) {
+        vals.append(cursor.read({coords[i], coords[i+1], coords[i+2]}));
+    }
+    return vals;
+}
+
+bool PythonProxy::writeOverlayVoxels(QList<int> coords, QList<quint64> vals) {// changed cubes are marked once
+    EditJournal::ScopedEdit edit;
+    VoxelCursor cursor;
+    bool success = coords.size() == 3 * vals.size();
+    for (int i = 0; i < vals.size() && 3 * i + 2 < coords.size(); ++i) {
+        success &= cursor.write({coords[3*i], coords[3*i+1], coords[3*i+2]}, vals[i]);
+    }
+    return success;
+}
+
 void PythonProxy::setPosition(QList<int> coord) {
     state->viewer->setPosition({static_cast<float>(coord[0]), static_cast<float>(coord[1]), static_cast<float>(coord[2])});
 }
@@ -64,6 +64,8 @@ public slots:
 
     quint64 readOverlayVoxel(QList<int> coord);
     bool writeOverlayVoxel(QList<int> coord, quint64 val);
+    QList<quint64> readOverlayVoxels(QList<int> coords);
+    bool writeOverlayVoxels(QList<int> coords, QList<quint64> vals);
     char *addrDcOc2Pointer(QList<int> coord, bool isOc);
     PyObject *PyBufferAddrDcOc2Pointer(QList<int> coord, bool isOc);
     QByteArray readDc2Pointer(QList<int> coord);
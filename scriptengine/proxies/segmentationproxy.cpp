@@ -110,3 +110,19 @@ void SegmentationProxy::jumpToObject(const quint64 objId) {
 QList<int> SegmentationProxy::objectLocation(const quint64 objId) {
     return objectFromId(objId).location.list();
 }
+
+quint64 SegmentationProxy::objectVoxelCount(const quint64 objId) {
+    return Segmentation::singleton().objectVoxelStats(objectFromId(objId).index).count;
+}
+
+quint64 SegmentationProxy::subobjectVoxelCount(const quint64 subObjId) {
+    return Segmentation::singleton().subobjectVoxelStats(subObjId).count;
+}
+
+QList<int> SegmentationProxy::objectBoundingBox(const quint64 objId) {
+    const auto stats = Segmentation::singleton().objectVoxelStats(objectFromId(objId).index);
+    if (stats.empty()) {
+        return {};
+    }
+    return stats.min.list() + stats.max.list();
+}
@@ -48,6 +48,9 @@ public slots:
     void unselectObject(const quint64 objId);
     void jumpToObject(const quint64 objId);
     QList<int> objectLocation(const quint64 objId);
+    quint64 objectVoxelCount(const quint64 objId);
+    quint64 subobjectVoxelCount(const quint64 subObjId);
+    QList<int> objectBoundingBox(const quint64 objId);
 };
 
 #endif // SEGMENTATIONPROXY_H
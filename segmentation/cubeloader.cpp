@@ -22,50 +22,120 @@
 
 #include "cubeloader.h"
 
+#include "editjournal.h"
 #include "loader.h"
+#include "profiler.h"
 #include "session.h"
 #include "segmentation.h"
 #include "segmentationsplit.h"
 #include "stateInfo.h"
 
-#include <boost/multi_array.hpp>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtConcurrentMap>
 
-std::pair<bool, void *> getRawCube(const Coordinate & pos) {
-    const auto posDc = pos.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <utility>
+#include <vector>
 
-    state->protectCube2Pointer.lock();
-    auto rawcube = Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[int_log(Dataset::current().magnification)], posDc);
-    state->protectCube2Pointer.unlock();
+VoxelCursor::VoxelCursor() : cubeEdgeLen{Dataset::current().cubeEdgeLength}, mag{Dataset::current().magnification}, magIndex{int_log(Dataset::current().magnification)} {}
 
-    return std::make_pair(rawcube != nullptr, rawcube);
+VoxelCursor::~VoxelCursor() {
+    if (!cubes.empty()) {
+        QMutexLocker locker(&state->protectCube2Pointer);
+        auto & pinned = state->OcPinned[magIndex];
+        for (const auto & pair : cubes) {
+            if (pair.second != nullptr) {
+                auto it = pinned.find(pair.first);
+                if (--it->second == 0) {
+                    pinned.erase(it);
+                }
+            }
+        }
+    }
+    coordCubesMarkChanged(changedCubes);
 }
 
-boost::multi_array_ref<uint64_t, 3> getCubeRef(void * const rawcube) {
-    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
-    const auto dims = boost::extents[cubeEdgeLen][cubeEdgeLen][cubeEdgeLen];
-    return boost::multi_array_ref<uint64_t, 3>(reinterpret_cast<uint64_t *>(rawcube), dims);
+uint64_t * VoxelCursor::cube(const CoordOfCube & cubeCoord) {
+    auto it = cubes.find(cubeCoord);
+    if (it == std::end(cubes)) {
+        uint64_t * rawcube = nullptr;
+        if (Dataset::current().overlay) {
+            QMutexLocker locker(&state->protectCube2Pointer);
+            rawcube = reinterpret_cast<uint64_t *>(Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[magIndex], cubeCoord));
+            if (rawcube != nullptr) {
+                ++state->OcPinned[magIndex][cubeCoord];
+            }
+        }
+        it = cubes.emplace(cubeCoord, rawcube).first;
+    }
+    return it->second;
 }
 
+uint64_t * VoxelCursor::voxel(const Coordinate & pos) {
+    if (Session::singleton().outsideMovementArea(pos)) {
+        return nullptr;
+    }
+    auto * rawcube = cube(pos.cube(cubeEdgeLen, mag));
+    return rawcube != nullptr ? rawcube + index(pos.insideCube(cubeEdgeLen, mag)) : nullptr;
+}
+
+uint64_t VoxelCursor::read(const Coordinate & pos) {
+    const auto * value = voxel(pos);
+    return value != nullptr ? *value : Segmentation::singleton().getBackgroundId();
+}
+
+bool VoxelCursor::write(const Coordinate & pos, const uint64_t value) {
+    auto * target = voxel(pos);
+    if (target == nullptr) {
+        return false;
+    }
+    markChanged(pos.cube(cubeEdgeLen, mag));
+    *target = value;
+    return true;
+}
+
+void VoxelCursor::markChanged(const CoordOfCube & cubeCoord) {
+    if (changedCubes.emplace(cubeCoord).second) {
+        EditJournal::singleton().record(magIndex, cubeCoord, cube(cubeCoord));
+    }
+}
+
+CubeCoordSet VoxelCursor::takeChangedCubes() {
+    CubeCoordSet taken;
+    std::swap(taken, changedCubes);
+    return taken;
+}
+
+/**
+ * @brief readVoxel looks a single voxel up without pinning its cube, loops should read through one VoxelCursor instead.
+ */
 uint64_t readVoxel(const Coordinate & pos) {
-    auto cubeIt = getRawCube(pos);
-    if (Session::singleton().outsideMovementArea(pos) || !Dataset::current().overlay || !cubeIt.first) {
+    if (Session::singleton().outsideMovementArea(pos) || !Dataset::current().overlay) {
+        return Segmentation::singleton().getBackgroundId();
+    }
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const auto mag = Dataset::current().magnification;
+    QMutexLocker locker(&state->protectCube2Pointer);// the cube cannot be unloaded while it is read
+    const auto * rawcube = reinterpret_cast<uint64_t *>(Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[int_log(mag)], pos.cube(cubeEdgeLen, mag)));
+    if (rawcube == nullptr) {
         return Segmentation::singleton().getBackgroundId();
     }
-    const auto inCube = pos.insideCube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
-    return getCubeRef(cubeIt.second)[inCube.z][inCube.y][inCube.x];
+    const auto inCube = pos.insideCube(cubeEdgeLen, mag);
+    return rawcube[static_cast<std::size_t>(inCube.z) * cubeEdgeLen * cubeEdgeLen + inCube.y * cubeEdgeLen + inCube.x];
 }
 
 bool writeVoxel(const Coordinate & pos, const uint64_t value, bool isMarkChanged) {
-    auto cubeIt = getRawCube(pos);
-    if (Session::singleton().outsideMovementArea(pos) || !Dataset::current().overlay || !cubeIt.first) {
-        return false;
-    }
-    const auto inCube = pos.insideCube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
-    getCubeRef(cubeIt.second)[inCube.z][inCube.y][inCube.x] = value;
-    if (isMarkChanged) {
-        Loader::Controller::singleton().markOcCubeAsModified(pos.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification), Dataset::current().magnification);
+    VoxelCursor cursor;
+    const auto written = cursor.write(pos, value);
+    if (!isMarkChanged) {
+        cursor.takeChangedCubes();
     }
-    return true;
+    return written;
 }
 
 bool isInsideSphere(const double xi, const double yi, const double zi, const double radius) {
@@ -76,6 +146,53 @@ bool isInsideSphere(const double xi, const double yi, const double zi, const dou
     return sqdistance < radius * radius;
 }
 
+/**
+ * @brief sphereSpan narrows a row of voxels to those isInsideSphere accepts.
+ *      The x extent of the brush ellipsoid is computed once per row, only the voxels at its ends are tested exactly.
+ * @return index range [first, last) within the row
+ */
+std::pair<std::ptrdiff_t, std::ptrdiff_t> sphereSpan(const Coordinate & rowBegin, const std::ptrdiff_t rowLength, const int mag, const Coordinate & centerPos, const double radius) {
+    const auto inside = [&rowBegin, mag, &centerPos, radius](const std::ptrdiff_t i){
+        return isInsideSphere(rowBegin.x + i * mag - centerPos.x, rowBegin.y - centerPos.y, rowBegin.z - centerPos.z, radius);
+    };
+    const auto scale = Dataset::current().scale;
+    const double y = (rowBegin.y - centerPos.y) * scale.y;
+    const double z = (rowBegin.z - centerPos.z) * scale.z;
+    const double remaining = radius * radius - y * y - z * z;
+    if (remaining <= 0) {
+        return {0, 0};
+    }
+    const double halfWidth = std::sqrt(remaining) / scale.x;
+    // one voxel of slack on each side for rounding, then shrink to the exact span
+    auto first = std::max<std::ptrdiff_t>(0, std::ceil((centerPos.x - halfWidth - rowBegin.x) / mag) - 1);
+    auto last = std::min<std::ptrdiff_t>(rowLength, std::floor((centerPos.x + halfWidth - rowBegin.x) / mag) + 2);
+    while (first < last && !inside(first)) {
+        ++first;
+    }
+    while (last > first && !inside(last - 1)) {
+        --last;
+    }
+    return {first, std::max(first, last)};
+}
+
+/**
+ * @brief clearSelected erases the voxels of selected subobjects, the selection is only looked up when the id changes
+ */
+void clearSelected(uint64_t * voxel, uint64_t * const rowEnd) {
+    const auto & seg = Segmentation::singleton();
+    uint64_t lastId = *voxel;
+    bool lastSelected = seg.isSubObjectIdSelected(lastId);
+    for (; voxel != rowEnd; ++voxel) {
+        if (*voxel != lastId) {
+            lastId = *voxel;
+            lastSelected = seg.isSubObjectIdSelected(lastId);
+        }
+        if (lastSelected) {
+            *voxel = 0;
+        }
+    }
+}
+
 std::pair<Coordinate, Coordinate> getRegion(const floatCoordinate & centerPos, const brush_t & brush) { // calcs global AABB of local coordinate system's region
     const auto posArb = centerPos.toLocal(brush.v1, brush.v2, brush.n);
     const auto width = brush.radius / Dataset::current().scale.componentMul(brush.v1).length();
@@ -105,6 +222,7 @@ void coordCubesMarkChanged(const CubeCoordSet & cubeChangeSet) {
 
 auto wholeCubes = [](const Coordinate & globalFirst, const Coordinate & globalLast, const uint64_t value, CubeCoordSet & cubeChangeSet) {
     const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    VoxelCursor cursor;
     const auto wholeCubeBegin = (globalFirst + cubeEdgeLen - 1).cube(cubeEdgeLen, Dataset::current().magnification);
     const auto wholeCubeEnd = globalLast.cube(cubeEdgeLen, Dataset::current().magnification);
 
@@ -113,11 +231,10 @@ auto wholeCubes = [](const Coordinate & globalFirst, const Coordinate & globalLa
     for (int y = wholeCubeBegin.y; y < wholeCubeEnd.y; ++y)
     for (int x = wholeCubeBegin.x; x < wholeCubeEnd.x; ++x) {
         const auto cubeCoord = CoordOfCube(x, y, z);
-        const auto globalCoord = cubeCoord.cube2Global(cubeEdgeLen, Dataset::current().magnification);
-        auto rawcube = getRawCube(globalCoord);
-        if (rawcube.first) {
-            auto cubeRef = getCubeRef(rawcube.second);
-            std::fill(cubeRef.data(), cubeRef.data() + cubeRef.num_elements(), value);
+        auto * rawcube = cursor.cube(cubeCoord);
+        if (rawcube != nullptr) {
+            EditJournal::singleton().record(cursor.magIndex, cubeCoord, rawcube);
+            std::fill(rawcube, rawcube + cubeEdgeLen * cubeEdgeLen * cubeEdgeLen, value);
             cubeChangeSet.emplace(cubeCoord);
         } else {
             qCritical() << x << y << z << "cube missing for (complete) writeVoxels";
@@ -131,52 +248,78 @@ auto wholeCubes = [](const Coordinate & globalFirst, const Coordinate & globalLa
     };
 };
 
-template<typename Func, typename Skip>
-CubeCoordSet processRegion(const Coordinate & globalFirst, const Coordinate &  globalLast, Func func, Skip skip) {
-    const auto & cubeEdgeLen = Dataset::current().cubeEdgeLength;
-    const auto cubeBegin = globalFirst.cube(cubeEdgeLen, Dataset::current().magnification);
-    const auto cubeEnd = globalLast.cube(cubeEdgeLen, Dataset::current().magnification) + 1;
+/**
+ * @brief processRegionRows calls rowFunc(rowBegin, rowEnd, globalPos of rowBegin) for every x row of the region within the loaded overlay cubes.
+ *      Cubes are disjoint and processed in parallel, so rowFunc is called concurrently for different rows.
+ *      With isWrite the cubes are recorded in the EditJournal before rowFunc may change them.
+ */
+template<typename RowFunc, typename Skip>
+CubeCoordSet processRegionRows(const Coordinate & globalFirst, const Coordinate &  globalLast, const bool isWrite, RowFunc rowFunc, Skip skip) {
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const auto mag = Dataset::current().magnification;
+    const auto cubeBegin = globalFirst.cube(cubeEdgeLen, mag);
+    const auto cubeEnd = globalLast.cube(cubeEdgeLen, mag) + 1;
     CubeCoordSet cubeCoords;
+    VoxelCursor cursor;
 
-    //traverse all remaining cubes
+    //collect all remaining cubes
+    std::vector<std::pair<CoordOfCube, uint64_t *>> cubes;
     for (int z = cubeBegin.z; z < cubeEnd.z; ++z)
     for (int y = cubeBegin.y; y < cubeEnd.y; ++y)
     for (int x = cubeBegin.x; x < cubeEnd.x; ++x) {
         skip(x, y, z);//skip cubes which got processed before
         const auto cubeCoord = CoordOfCube(x, y, z);
-        const auto globalCubeBegin = cubeCoord.cube2Global(cubeEdgeLen, Dataset::current().magnification);
-        auto rawcube = getRawCube(globalCubeBegin);
-        if (rawcube.first) {
-            auto cubeRef = getCubeRef(rawcube.second);
-            const auto globalCubeEnd = globalCubeBegin + cubeEdgeLen * Dataset::current().magnification - 1;
-            const auto localStart = globalFirst.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, Dataset::current().magnification);
-            const auto localEnd = globalLast.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, Dataset::current().magnification);
-
-            for (int z = localStart.z; z <= localEnd.z; ++z)
-            for (int y = localStart.y; y <= localEnd.y; ++y)
-            for (int x = localStart.x; x <= localEnd.x; ++x) {
-                const Coordinate globalCoord{globalCubeBegin.x + x * Dataset::current().magnification, globalCubeBegin.y + y * Dataset::current().magnification, globalCubeBegin.z + z * Dataset::current().magnification};
-                func(cubeRef[z][y][x], globalCoord);
+        auto * rawcube = cursor.cube(cubeCoord);
+        if (rawcube != nullptr) {
+            if (isWrite) {
+                EditJournal::singleton().record(cursor.magIndex, cubeCoord, rawcube);
             }
+            cubes.emplace_back(cubeCoord, rawcube);
             cubeCoords.emplace(cubeCoord);
         } else {
             qCritical() << x << y << z << "cube missing for (partial) writeVoxels";
         }
     }
+    QtConcurrent::blockingMap(cubes, [&globalFirst, &globalLast, &rowFunc, cubeEdgeLen, mag](const std::pair<CoordOfCube, uint64_t *> & cube){
+        const auto globalCubeBegin = cube.first.cube2Global(cubeEdgeLen, mag);
+        const auto globalCubeEnd = globalCubeBegin + cubeEdgeLen * mag - 1;
+        const auto localStart = globalFirst.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, mag);
+        const auto localEnd = globalLast.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, mag);
+        for (int z = localStart.z; z <= localEnd.z; ++z)
+        for (int y = localStart.y; y <= localEnd.y; ++y) {
+            auto * row = cube.second + static_cast<std::size_t>(z) * cubeEdgeLen * cubeEdgeLen + y * cubeEdgeLen;
+            rowFunc(row + localStart.x, row + localEnd.x + 1, Coordinate{globalCubeBegin.x + localStart.x * mag, globalCubeBegin.y + y * mag, globalCubeBegin.z + z * mag});
+        }
+    });
     return cubeCoords;
 }
 
-template<typename Func>//wrapper without Skip
-CubeCoordSet processRegion(const Coordinate & globalFirst, const Coordinate &  globalLast, Func func) {
-    return processRegion(globalFirst, globalLast, func, [](int &, int, int){});
+template<typename RowFunc>//wrapper without Skip
+CubeCoordSet processRegionRows(const Coordinate & globalFirst, const Coordinate &  globalLast, const bool isWrite, RowFunc rowFunc) {
+    return processRegionRows(globalFirst, globalLast, isWrite, rowFunc, [](int &, int, int){});
 }
 
 subobjectRetrievalMap readVoxels(const Coordinate & centerPos, const brush_t &brush) {
     subobjectRetrievalMap subobjects;
+    QMutex subobjectsMutex;
     const auto region = getRegion(centerPos, brush);
-    processRegion(region.first, region.second, [&subobjects](uint64_t & voxel, Coordinate position){
-        if (voxel != 0) {//don’t select the unsegmented area as object
-            subobjects.emplace(std::piecewise_construct, std::make_tuple(voxel), std::make_tuple(position));
+    const auto mag = Dataset::current().magnification;
+    processRegionRows(region.first, region.second, false, [&subobjects, &subobjectsMutex, mag](uint64_t * voxel, uint64_t * const rowEnd, Coordinate position){
+        subobjectRetrievalMap rowSubobjects;
+        for (; voxel != rowEnd; ++voxel, position.x += mag) {
+            if (*voxel != 0) {//don’t select the unsegmented area as object
+                rowSubobjects.emplace(std::piecewise_construct, std::make_tuple(*voxel), std::make_tuple(position));
+            }
+        }
+        if (!rowSubobjects.empty()) {// rows finish in any order, keep the first position in z, y, x order like a serial scan
+            QMutexLocker locker(&subobjectsMutex);
+            for (const auto & pair : rowSubobjects) {
+                const auto inserted = subobjects.emplace(pair);
+                auto & kept = inserted.first->second;
+                if (!inserted.second && std::make_tuple(pair.second.z, pair.second.y, pair.second.x) < std::make_tuple(kept.z, kept.y, kept.x)) {
+                    kept = pair.second;
+                }
+            }
         }
     });
     return subobjects;
@@ -185,6 +328,8 @@ subobjectRetrievalMap readVoxels(const Coordinate & centerPos, const brush_t &br
 void writeVoxels(const Coordinate & centerPos, const uint64_t value, const brush_t & brush, bool isMarkChanged) {
     //all the different invocations here are listed explicitly so the compiler can inline the fuck out of it
     //the brush differentiations were moved outside the core lambda which is called for every voxel
+    static Profiler brush_profiler;
+    brush_profiler.start(); // ----------------------------------------------------------- profiling
     CubeCoordSet cubeChangeSet;
     CubeCoordSet cubeChangeSetWholeCube;
     if (Session::singleton().annotationMode.testFlag(AnnotationMode::Mode_Paint)) {
@@ -194,37 +339,38 @@ void writeVoxels(const Coordinate & centerPos, const uint64_t value, const brush
                 //for rectangular brushes no further range checks are needed
                 if (brush.mode == brush_t::mode_t::three_dim && brush.shape == brush_t::shape_t::angular) {
                     //rarest special case: processes completely exclosed cubes first
-                    cubeChangeSet = processRegion(region.first, region.second, [value](uint64_t & voxel, Coordinate){
-                        voxel = value;
+                    cubeChangeSet = processRegionRows(region.first, region.second, true, [value](uint64_t * rowBegin, uint64_t * rowEnd, Coordinate){
+                        std::fill(rowBegin, rowEnd, value);
                     }, wholeCubes(region.first, region.second, value, cubeChangeSetWholeCube));
                 } else {
-                    cubeChangeSet = processRegion(region.first, region.second, [value](uint64_t & voxel, Coordinate){
-                        voxel = value;
+                    cubeChangeSet = processRegionRows(region.first, region.second, true, [value](uint64_t * rowBegin, uint64_t * rowEnd, Coordinate){
+                        std::fill(rowBegin, rowEnd, value);
                     });
                 }
             } else {//inverse but selected
-                cubeChangeSet = processRegion(region.first, region.second, [](uint64_t & voxel, Coordinate){
-                    if (Segmentation::singleton().isSubObjectIdSelected(voxel)) {//if there’re selected objects, we only want to erase these
-                        voxel = 0;
-                    }
+                cubeChangeSet = processRegionRows(region.first, region.second, true, [](uint64_t * rowBegin, uint64_t * rowEnd, Coordinate){
+                    clearSelected(rowBegin, rowEnd);//if there’re selected objects, we only want to erase these
                 });
             }
         } else if (!brush.inverse || Segmentation::singleton().selectedObjectsCount() == 0) {
-            //voxel need to check if they are inside the circle
-            cubeChangeSet = processRegion(region.first, region.second, [&brush, centerPos, value](uint64_t & voxel, Coordinate globalPos){
-                if (isInsideSphere(globalPos.x - centerPos.x, globalPos.y - centerPos.y, globalPos.z - centerPos.z, brush.radius)) {
-                    voxel = value;
-                }
+            //only the span of each row inside the circle is written
+            const auto mag = Dataset::current().magnification;
+            cubeChangeSet = processRegionRows(region.first, region.second, true, [&brush, centerPos, value, mag](uint64_t * rowBegin, uint64_t * rowEnd, Coordinate globalPos){
+                const auto span = sphereSpan(globalPos, rowEnd - rowBegin, mag, centerPos, brush.radius);
+                std::fill(rowBegin + span.first, rowBegin + span.second, value);
             });
         } else {//circle, inverse and selected
-            cubeChangeSet = processRegion(region.first, region.second, [&brush, centerPos](uint64_t & voxel, Coordinate globalPos){
-                if (isInsideSphere(globalPos.x - centerPos.x, globalPos.y - centerPos.y, globalPos.z - centerPos.z, brush.radius)
-                        && Segmentation::singleton().isSubObjectIdSelected(voxel)) {
-                    voxel = 0;
+            const auto mag = Dataset::current().magnification;
+            cubeChangeSet = processRegionRows(region.first, region.second, true, [&brush, centerPos, mag](uint64_t * rowBegin, uint64_t * rowEnd, Coordinate globalPos){
+                const auto span = sphereSpan(globalPos, rowEnd - rowBegin, mag, centerPos, brush.radius);
+                if (span.first != span.second) {
+                    clearSelected(rowBegin + span.first, rowBegin + span.second);
                 }
             });
         }
     }
+    brush_profiler.end(); // ----------------------------------------------------------- profiling
+    // qDebug() << "brush avg time: " << brush_profiler.average_time()*1000 << "ms";
     if (isMarkChanged) {
         for (auto &elem : cubeChangeSetWholeCube) {
             cubeChangeSet.emplace(elem);
@@ -235,30 +381,35 @@ void writeVoxels(const Coordinate & centerPos, const uint64_t value, const brush
 
 CubeCoordSet processRegionByStridedBuf(const Coordinate & globalFirst, const Coordinate &  globalLast, char * data, const Coordinate & strides, bool isWrite, bool markChanged) {
     CubeCoordSet cubeChangeSet;
+    const auto step = strides.x * Dataset::current().magnification;// buffer bytes between neighbouring voxels of a row
     if (isWrite) {
-        cubeChangeSet = processRegion(globalFirst, globalLast,
-                [globalFirst,data,strides](uint64_t & voxel, Coordinate globalPos){
-                voxel = reinterpret_cast<const uint64_t &>(data[(globalPos - globalFirst).componentMul(strides).sum()]);
+        cubeChangeSet = processRegionRows(globalFirst, globalLast, true,
+                [globalFirst,data,strides,step](uint64_t * voxel, uint64_t * const rowEnd, Coordinate globalPos){
+                const char * source = &data[(globalPos - globalFirst).componentMul(strides).sum()];
+                if (step == sizeof(uint64_t)) {
+                    std::memcpy(voxel, source, (rowEnd - voxel) * sizeof(uint64_t));
+                } else {
+                    for (; voxel != rowEnd; ++voxel, source += step) {
+                        *voxel = reinterpret_cast<const uint64_t &>(*source);
+                    }
+                }
             });
         if (markChanged) {
             coordCubesMarkChanged(cubeChangeSet);
         }
     }
     else {
-        cubeChangeSet = processRegion(globalFirst, globalLast,
-                [globalFirst,data,strides](uint64_t & voxel, Coordinate globalPos){
-                reinterpret_cast<uint64_t &>(data[(globalPos - globalFirst).componentMul(strides).sum()]) = voxel;
+        cubeChangeSet = processRegionRows(globalFirst, globalLast, false,
+                [globalFirst,data,strides,step](uint64_t * voxel, uint64_t * const rowEnd, Coordinate globalPos){
+                char * target = &data[(globalPos - globalFirst).componentMul(strides).sum()];
+                if (step == sizeof(uint64_t)) {
+                    std::memcpy(target, voxel, (rowEnd - voxel) * sizeof(uint64_t));
+                } else {
+                    for (; voxel != rowEnd; ++voxel, target += step) {
+                        reinterpret_cast<uint64_t &>(*target) = *voxel;
+                    }
+                }
             });
     }
     return cubeChangeSet;
 }
-
-void listFill(const Coordinate & centerPos, const brush_t & brush, const uint64_t fillsoid, const std::unordered_set<Coordinate> & voxels) {
-    const auto region = getRegion(centerPos, brush);
-    auto cubeChangeSet = processRegion(region.first, region.second, [fillsoid, &voxels](uint64_t & voxel, Coordinate globalPos){
-        if (voxels.find(globalPos) != std::end(voxels)) {
-            voxel = fillsoid;
-        }
-    });
-    coordCubesMarkChanged(cubeChangeSet);
-}
@@ -25,14 +25,47 @@
 
 #include "coordinate.h"
 
+#include <cstddef>
 #include <cstdint>
 #include <unordered_set>
 #include <unordered_map>
+#include <utility>
 
 class brush_t;
 using CubeCoordSet = std::unordered_set<CoordOfCube>;
 using subobjectRetrievalMap = std::unordered_map<uint64_t, Coordinate>;
 
+/**
+ * @brief The VoxelCursor class gives direct access to the overlay voxels of the current magnification.
+ *      Cubes are looked up and pinned against unloading once, when they are first touched.
+ *      The cubes written through it are marked as changed once, when it is destroyed.
+ *      Raw writes have to be preceded by markChanged, it records the cube in the EditJournal.
+ */
+class VoxelCursor {
+    std::unordered_map<CoordOfCube, uint64_t *> cubes;
+    CubeCoordSet changedCubes;
+public:
+    const int cubeEdgeLen;
+    const int mag;
+    const std::size_t magIndex;
+
+    VoxelCursor();
+    VoxelCursor(const VoxelCursor &) = delete;
+    VoxelCursor & operator=(const VoxelCursor &) = delete;
+    ~VoxelCursor();
+
+    uint64_t * cube(const CoordOfCube & cubeCoord);// nullptr if the cube is not loaded
+    std::size_t index(const CoordInCube & inCube) const {
+        return static_cast<std::size_t>(inCube.z) * cubeEdgeLen * cubeEdgeLen + inCube.y * cubeEdgeLen + inCube.x;
+    }
+    uint64_t * voxel(const Coordinate & pos);// nullptr outside the movement area or loaded cubes
+    uint64_t read(const Coordinate & pos);
+    bool write(const Coordinate & pos, const uint64_t value);
+    void markChanged(const CoordOfCube & cubeCoord);
+    CubeCoordSet takeChangedCubes();// the caller takes over marking them
+};
+
+std::pair<Coordinate, Coordinate> getRegion(const floatCoordinate & centerPos, const brush_t & brush);
 bool isInsideSphere(const double xi, const double yi, const double zi, const double radius);
 
 void coordCubesMarkChanged(const CubeCoordSet & cubeChangeSet);
@@ -41,6 +74,5 @@ subobjectRetrievalMap readVoxels(const Coordinate & centerPos, const brush_t &);
 bool writeVoxel(const Coordinate & pos, const uint64_t value, bool isMarkChanged = true);
 void writeVoxels(const Coordinate & centerPos, const uint64_t value, const brush_t &, bool isMarkChanged = true);
 CubeCoordSet processRegionByStridedBuf(const Coordinate & globalFirst, const Coordinate &  globalLast, char * data, const Coordinate & strides, bool isWrite, bool markChanged);
-void listFill(const Coordinate & centerPos, const brush_t & brush, const uint64_t fillsoid, const std::unordered_set<Coordinate> & voxels);
 
 #endif//CUBELOADER_H
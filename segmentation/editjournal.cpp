@@ -0,0 +1,307 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#include "editjournal.h"
+
+#include "cubeloader.h"
+#include "stateInfo.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+
+#include <snappy.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+// a run is stored as [uint32 offset][uint32 length][length × uint64 before ^ after]
+void appendXorRuns(const uint64_t * before, const uint64_t * after, const std::size_t count, std::string & runs) {
+    for (std::size_t i = 0; i < count;) {
+        if (before[i] == after[i]) {
+            ++i;
+            continue;
+        }
+        const auto first = i;
+        while (i < count && before[i] != after[i]) {
+            ++i;
+        }
+        const uint32_t header[2]{static_cast<uint32_t>(first), static_cast<uint32_t>(i - first)};
+        runs.append(reinterpret_cast<const char *>(header), sizeof(header));
+        for (auto j = first; j < i; ++j) {
+            const uint64_t delta = before[j] ^ after[j];
+            runs.append(reinterpret_cast<const char *>(&delta), sizeof(delta));
+        }
+    }
+}
+
+/**
+ * @brief forEachXorRun calls func(offset, length, deltas) for every run, returns false if the runs don’t fit a cube of count voxels
+ */
+template<typename Func>
+bool forEachXorRun(const std::string & runs, const std::size_t count, Func func) {
+    const char * pos = runs.data();
+    const char * const end = pos + runs.size();
+    while (end - pos >= static_cast<std::ptrdiff_t>(2 * sizeof(uint32_t))) {
+        uint32_t header[2];
+        std::memcpy(header, pos, sizeof(header));
+        pos += sizeof(header);
+        const auto length = static_cast<std::size_t>(header[1]);
+        if (header[0] + length > count || static_cast<std::size_t>(end - pos) < length * sizeof(uint64_t)) {
+            return false;
+        }
+        func(header[0], length, pos);
+        pos += length * sizeof(uint64_t);
+    }
+    return pos == end;
+}
+
+void applyXorRuns(const std::string & runs, uint64_t * cube, const std::size_t count) {
+    forEachXorRun(runs, count, [cube](const std::size_t offset, const std::size_t length, const char * deltas){
+        for (auto * voxel = cube + offset; voxel != cube + offset + length; ++voxel, deltas += sizeof(uint64_t)) {
+            uint64_t delta;
+            std::memcpy(&delta, deltas, sizeof(delta));
+            *voxel ^= delta;
+        }
+    });
+}
+
+EditJournal & EditJournal::singleton() {
+    static EditJournal journal;
+    return journal;
+}
+
+void EditJournal::beginEdit() {
+    ++depth;
+}
+
+void EditJournal::endEdit() {
+    if (depth == 0 || --depth > 0 || snapshots.empty()) {
+        return;
+    }
+    Entry entry;
+    entry.magIndex = editMagIndex;
+    std::vector<uint64_t> before(state->cubeBytes);
+    std::string runs;
+    for (const auto & snapshot : snapshots) {
+        const uint64_t * after;
+        {
+            QMutexLocker locker(&state->protectCube2Pointer);
+            after = reinterpret_cast<const uint64_t *>(Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[editMagIndex], snapshot.first));
+        }// the cube stays pinned until unpinSnapshots
+        if (after == nullptr || !snappy::RawUncompress(snapshot.second.data(), snapshot.second.size(), reinterpret_cast<char *>(before.data()))) {
+            qWarning() << snapshot.first.x << snapshot.first.y << snapshot.first.z << "cube unloaded before its edit could be journaled";
+            continue;
+        }
+        runs.clear();
+        appendXorRuns(before.data(), after, before.size(), runs);
+        if (!runs.empty()) {
+            entry.cubes.emplace_back(snapshot.first, std::string{});
+            snappy::Compress(runs.data(), runs.size(), &entry.cubes.back().second);
+            entry.bytes += entry.cubes.back().second.size();
+        }
+    }
+    unpinSnapshots();
+    snapshots.clear();
+    if (!entry.cubes.empty()) {
+        for (const auto & redoEntry : redoStack) {
+            (redoEntry.spill ? diskBytes : memoryBytes) -= redoEntry.bytes;
+        }
+        redoStack.clear();
+        memoryBytes += entry.bytes;
+        undoStack.emplace_back(std::move(entry));
+        enforceBudgets();
+        emit changed();
+    }
+}
+
+void EditJournal::record(const std::size_t magIndex, const CoordOfCube & cubeCoord, const uint64_t * rawcube) {
+    if (rawcube == nullptr) {
+        return;
+    }
+    if (depth == 0) {// the deltas of the journal would not apply on top of an unjournaled write
+        if (!applying && (canUndo() || canRedo())) {
+            qWarning() << "voxels written outside of an edit, undo history cleared";
+            clear();
+        }
+        return;
+    }
+    if (snapshots.empty()) {
+        editMagIndex = magIndex;
+    } else if (magIndex != editMagIndex) {
+        qWarning() << cubeCoord.x << cubeCoord.y << cubeCoord.z << "edit spans magnifications, cube is not journaled";
+        return;
+    }
+    auto it = snapshots.find(cubeCoord);
+    if (it == std::end(snapshots)) {
+        {
+            QMutexLocker locker(&state->protectCube2Pointer);
+            ++state->OcPinned[magIndex][cubeCoord];
+        }
+        it = snapshots.emplace(cubeCoord, std::string{}).first;
+        snappy::Compress(reinterpret_cast<const char *>(rawcube), OBJID_BYTES * state->cubeBytes, &it->second);
+    }
+}
+
+void EditJournal::unpinSnapshots() {
+    QMutexLocker locker(&state->protectCube2Pointer);
+    auto & pinned = state->OcPinned[editMagIndex];
+    for (const auto & snapshot : snapshots) {
+        auto it = pinned.find(snapshot.first);
+        if (it != std::end(pinned) && --it->second == 0) {
+            pinned.erase(it);
+        }
+    }
+}
+
+void EditJournal::spill(Entry & entry) {
+    auto file = std::make_unique<QTemporaryFile>(QDir::tempPath() + "/knossos_edit_XXXXXX");
+    if (!file->open()) {
+        throw std::runtime_error("edit journal spill open failed");
+    }
+    QDataStream stream(file.get());
+    stream << static_cast<quint32>(entry.cubes.size());
+    for (const auto & cube : entry.cubes) {
+        stream << static_cast<qint32>(cube.first.x) << static_cast<qint32>(cube.first.y) << static_cast<qint32>(cube.first.z);
+        stream.writeBytes(cube.second.data(), static_cast<uint>(cube.second.size()));
+    }
+    if (stream.status() != QDataStream::Ok || !file->flush()) {
+        throw std::runtime_error("edit journal spill write failed");
+    }
+    entry.cubes = {};
+    entry.spill = std::move(file);
+    memoryBytes -= entry.bytes;
+    diskBytes += entry.bytes;
+}
+
+bool EditJournal::unspill(Entry & entry) {
+    if (!entry.spill) {
+        return true;
+    }
+    entry.spill->seek(0);
+    QDataStream stream(entry.spill.get());
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 x, y, z;
+        char * data = nullptr;
+        uint size = 0;
+        stream >> x >> y >> z;
+        stream.readBytes(data, size);
+        entry.cubes.emplace_back(CoordOfCube(x, y, z), std::string(data, size));
+        delete [] data;
+    }
+    if (stream.status() != QDataStream::Ok || entry.cubes.size() != count) {
+        qWarning() << "edit journal could not read back" << entry.spill->fileName();
+        entry.cubes = {};
+        return false;
+    }
+    entry.spill.reset();
+    diskBytes -= entry.bytes;
+    memoryBytes += entry.bytes;
+    return true;
+}
+
+void EditJournal::enforceBudgets() {
+    // spill the entries farthest from being applied: the oldest undos, then the last redos
+    for (auto * stack : {&undoStack, &redoStack}) {
+        for (auto it = std::begin(*stack); it != std::end(*stack) && memoryBytes > memoryBudget; ++it) {
+            if (!it->spill) {
+                try {
+                    spill(*it);
+                } catch (const std::runtime_error & error) {
+                    qWarning() << error.what();// keep the entries in memory for now
+                    return;
+                }
+            }
+        }
+    }
+    while (diskBytes > diskBudget && !undoStack.empty()) {
+        (undoStack.front().spill ? diskBytes : memoryBytes) -= undoStack.front().bytes;
+        undoStack.pop_front();
+    }
+}
+
+bool EditJournal::apply(std::deque<Entry> & from, std::deque<Entry> & to) {
+    if (depth > 0 || from.empty()) {
+        return false;
+    }
+    auto & entry = from.back();
+    VoxelCursor cursor;
+    if (cursor.magIndex != entry.magIndex || !unspill(entry)) {
+        return false;
+    }
+    std::vector<uint64_t *> targets;
+    for (const auto & cube : entry.cubes) {
+        targets.emplace_back(cursor.cube(cube.first));
+        if (targets.back() == nullptr) {// apply all or nothing
+            return false;
+        }
+    }
+    std::vector<std::string> runs(entry.cubes.size());
+    for (std::size_t i = 0; i < entry.cubes.size(); ++i) {// validate all runs before touching any voxel
+        const auto & compressed = entry.cubes[i].second;
+        if (!snappy::Uncompress(compressed.data(), compressed.size(), &runs[i]) || !forEachXorRun(runs[i], state->cubeBytes, [](std::size_t, std::size_t, const char *){})) {
+            qCritical() << "edit journal entry is corrupt";
+            return false;
+        }
+    }
+    applying = true;
+    for (std::size_t i = 0; i < entry.cubes.size(); ++i) {
+        applyXorRuns(runs[i], targets[i], state->cubeBytes);
+        cursor.markChanged(entry.cubes[i].first);
+    }
+    applying = false;
+    to.emplace_back(std::move(entry));
+    from.pop_back();
+    enforceBudgets();
+    emit changed();
+    return true;
+}
+
+bool EditJournal::undo() {
+    return apply(undoStack, redoStack);
+}
+
+bool EditJournal::redo() {
+    return apply(redoStack, undoStack);
+}
+
+bool EditJournal::canUndo() const {
+    return !undoStack.empty();
+}
+
+bool EditJournal::canRedo() const {
+    return !redoStack.empty();
+}
+
+void EditJournal::clear() {
+    unpinSnapshots();
+    snapshots.clear();
+    undoStack.clear();
+    redoStack.clear();
+    memoryBytes = 0;
+    diskBytes = 0;
+    emit changed();
+}
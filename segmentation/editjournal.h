@@ -0,0 +1,94 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include "coordinate.h"
+
+#include <QObject>
+#include <QTemporaryFile>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The EditJournal class records overlay voxel edits for undo and redo.
+ *      While an edit is open the first write to each cube stores a snappy compressed copy of it.
+ *      Closing the edit turns these copies into snappy compressed xor runs against the edited cubes,
+ *      applying them again toggles between both states at a cost proportional to the runs.
+ *      Entries beyond memoryBudget are spilled to temporary files, beyond diskBudget the oldest are dropped.
+ */
+class EditJournal : public QObject {
+    Q_OBJECT
+    struct Entry {
+        std::size_t magIndex;
+        std::vector<std::pair<CoordOfCube, std::string>> cubes;// compressed xor runs
+        std::size_t bytes{0};
+        std::unique_ptr<QTemporaryFile> spill;// holds the cubes while they are not in memory
+    };
+    int depth{0};
+    bool applying{false};// undo and redo write outside of an edit
+    std::size_t editMagIndex{0};
+    std::unordered_map<CoordOfCube, std::string> snapshots;// compressed cubes before the open edit
+    std::deque<Entry> undoStack;
+    std::deque<Entry> redoStack;
+    std::size_t memoryBytes{0};
+    std::size_t diskBytes{0};
+
+    void unpinSnapshots();
+    void spill(Entry & entry);
+    bool unspill(Entry & entry);
+    void enforceBudgets();
+    bool apply(std::deque<Entry> & from, std::deque<Entry> & to);
+public:
+    class ScopedEdit {
+    public:
+        ScopedEdit() { EditJournal::singleton().beginEdit(); }
+        ~ScopedEdit() { EditJournal::singleton().endEdit(); }
+    };
+
+    std::size_t memoryBudget{256 * 1024 * 1024};
+    std::size_t diskBudget{std::size_t{4} * 1024 * 1024 * 1024};
+
+    static EditJournal & singleton();
+
+    void beginEdit();// edits nest, only the outermost one creates an entry
+    void endEdit();
+    void record(const std::size_t magIndex, const CoordOfCube & cubeCoord, const uint64_t * rawcube);// call before writing to rawcube, outside of an edit it clears the journal
+    bool canUndo() const;
+    bool canRedo() const;
+signals:
+    void changed();
+public slots:
+    bool undo();
+    bool redo();
+    void clear();
+};
+
+#endif//EDITJOURNAL_H
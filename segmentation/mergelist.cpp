@@ -0,0 +1,275 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#include "mergelist.h"
+
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+constexpr char binaryMagic[8] = {'K', 'M', 'L', 'B', 'I', 'N', '0', '1'};
+constexpr std::size_t parallelThreshold = 8 * 1024 * 1024;// smaller mergelists are parsed in one part
+
+const char * skipBlanks(const char * pos, const char * end) {
+    while (pos != end && (*pos == ' ' || *pos == '\t')) {
+        ++pos;
+    }
+    return pos;
+}
+
+/**
+ * @brief parseUnsigned parses a decimal number like from_chars, returns nullptr if there is none or it overflows
+ */
+const char * parseUnsigned(const char * pos, const char * end, std::uint64_t & value) {
+    pos = skipBlanks(pos, end);
+    const auto * const first = pos;
+    std::uint64_t result = 0;
+    for (; pos != end && *pos >= '0' && *pos <= '9'; ++pos) {
+        const std::uint64_t digit = *pos - '0';
+        if (result > (std::numeric_limits<std::uint64_t>::max() - digit) / 10) {
+            return nullptr;
+        }
+        result = 10 * result + digit;
+    }
+    if (pos == first) {
+        return nullptr;
+    }
+    value = result;
+    return pos;
+}
+
+const char * parseSigned(const char * pos, const char * end, int & value) {
+    pos = skipBlanks(pos, end);
+    const bool negative = pos != end && *pos == '-';
+    std::uint64_t magnitude;
+    pos = parseUnsigned(pos + negative, end, magnitude);
+    if (pos == nullptr || magnitude > static_cast<std::uint64_t>(std::numeric_limits<int>::max()) + negative) {
+        return nullptr;
+    }
+    value = negative ? static_cast<int>(-static_cast<std::int64_t>(magnitude)) : static_cast<int>(magnitude);
+    return pos;
+}
+
+const char * parseFlag(const char * pos, const char * end, bool & value) {
+    std::uint64_t number;
+    pos = parseUnsigned(pos, end, number);
+    if (pos == nullptr || number > 1) {
+        return nullptr;
+    }
+    value = number == 1;
+    return pos;
+}
+
+/**
+ * @brief line returns the end of the line starting at pos without a trailing carriage return and the start of the next one
+ */
+std::pair<const char *, const char *> line(const char * pos, const char * end) {
+    const auto * newline = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+    const auto * const next = newline != nullptr ? newline + 1 : end;
+    auto * lineEnd = newline != nullptr ? newline : end;
+    if (lineEnd != pos && *(lineEnd - 1) == '\r') {
+        --lineEnd;
+    }
+    return {lineEnd, next};
+}
+
+/**
+ * @brief parseTextEntry parses the 4 lines of one object starting at pos and returns the start of the next one
+ */
+const char * parseTextEntry(const char * pos, const char * end, MergelistPart & part) {
+    MergelistEntry entry;
+    // id todo immutable subobject…
+    auto bounds = line(pos, end);
+    pos = parseUnsigned(pos, bounds.first, entry.id);
+    pos = pos != nullptr ? parseFlag(pos, bounds.first, entry.todo) : nullptr;
+    pos = pos != nullptr ? parseFlag(pos, bounds.first, entry.immutable) : nullptr;
+    if (pos == nullptr) {
+        return nullptr;
+    }
+    entry.firstSubobject = part.subobjectIds.size();
+    std::uint64_t subobjectId;
+    while (const auto * next = parseUnsigned(pos, bounds.first, subobjectId)) {
+        part.subobjectIds.emplace_back(subobjectId);
+        pos = next;
+    }
+    entry.subobjectCount = part.subobjectIds.size() - entry.firstSubobject;
+    if (entry.subobjectCount == 0 || bounds.second == end) {
+        return nullptr;
+    }
+    // x y z [r g b]
+    pos = bounds.second;
+    bounds = line(pos, end);
+    pos = parseSigned(pos, bounds.first, entry.location.x);
+    pos = pos != nullptr ? parseSigned(pos, bounds.first, entry.location.y) : nullptr;
+    pos = pos != nullptr ? parseSigned(pos, bounds.first, entry.location.z) : nullptr;
+    if (pos == nullptr || bounds.second == end) {
+        return nullptr;
+    }
+    std::uint64_t r, g, b;
+    const auto * colorPos = parseUnsigned(pos, bounds.first, r);
+    colorPos = colorPos != nullptr ? parseUnsigned(colorPos, bounds.first, g) : nullptr;
+    colorPos = colorPos != nullptr ? parseUnsigned(colorPos, bounds.first, b) : nullptr;
+    if (colorPos != nullptr) {
+        entry.color = std::make_tuple(static_cast<std::uint8_t>(r), static_cast<std::uint8_t>(g), static_cast<std::uint8_t>(b));
+    }
+    // category
+    pos = bounds.second;
+    bounds = line(pos, end);
+    entry.category = pos;
+    entry.categoryLength = bounds.first - pos;
+    if (bounds.second == end) {
+        return nullptr;
+    }
+    // comment
+    pos = bounds.second;
+    bounds = line(pos, end);
+    entry.comment = pos;
+    entry.commentLength = bounds.first - pos;
+    part.entries.emplace_back(entry);
+    return bounds.second;
+}
+
+const char * nextLine(const char * pos, const char * end) {
+    const auto * newline = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+    return newline != nullptr ? newline + 1 : end;
+}
+
+template<typename T>
+T readLittleEndian(const char * & pos) {
+    T value;
+    std::memcpy(&value, pos, sizeof(value));
+    pos += sizeof(value);
+    return qFromLittleEndian(value);
+}
+}
+
+bool isBinaryMergelist(const char * begin, const char * end) {
+    return end - begin >= static_cast<std::ptrdiff_t>(sizeof(binaryMagic)) && std::memcmp(begin, binaryMagic, sizeof(binaryMagic)) == 0;
+}
+
+/**
+ * @brief parseMergelistText parses a text mergelist in place.
+ *      Large buffers are cut into parts at line boundaries, the newlines of each part are counted in parallel,
+ *      so every part knows where its first object (every 4th line) begins and all parts can be parsed concurrently.
+ */
+std::vector<MergelistPart> parseMergelistText(const char * begin, const char * end) {
+    const std::size_t size = end - begin;
+    const std::size_t partCount = size < parallelThreshold ? 1 : 4 * std::max(1, QThread::idealThreadCount());
+    std::vector<const char *> partBegin{begin};
+    for (std::size_t i = 1; i < partCount; ++i) {
+        partBegin.emplace_back(std::max(partBegin.back(), nextLine(begin + i * size / partCount, end)));
+    }
+    partBegin.emplace_back(end);
+    std::vector<std::size_t> lineCount(partCount);
+    std::vector<std::size_t> parts(partCount);
+    std::iota(std::begin(parts), std::end(parts), 0);
+    QtConcurrent::blockingMap(parts, [&partBegin, &lineCount](const std::size_t i){
+        lineCount[i] = std::count(partBegin[i], partBegin[i + 1], '\n');
+    });
+    // move each part start to the first line of an object
+    std::size_t firstLine = 0;
+    std::vector<const char *> entryBegin{begin};
+    for (std::size_t i = 1; i <= partCount; ++i) {
+        firstLine += lineCount[i - 1];
+        auto * pos = partBegin[i];
+        for (auto skip = (4 - firstLine % 4) % 4; skip > 0 && pos != end; --skip) {
+            pos = nextLine(pos, end);
+        }
+        entryBegin.emplace_back(i == partCount ? end : std::max(entryBegin.back(), pos));
+    }
+    std::vector<MergelistPart> result(partCount);
+    std::vector<char> valid(partCount, true);
+    QtConcurrent::blockingMap(parts, [&entryBegin, &result, &valid, end](const std::size_t i){
+        auto & part = result[i];
+        part.entries.reserve((entryBegin[i + 1] - entryBegin[i]) / 64);
+        part.subobjectIds.reserve((entryBegin[i + 1] - entryBegin[i]) / 16);
+        for (auto * pos = entryBegin[i]; pos != nullptr && pos < entryBegin[i + 1];) {
+            pos = parseTextEntry(pos, end, part);
+            valid[i] = valid[i] && pos != nullptr;
+        }
+    });
+    if (std::find(std::begin(valid), std::end(valid), false) != std::end(valid)) {
+        throw std::runtime_error("mergelist text parsing failed");
+    }
+    return result;
+}
+
+std::vector<MergelistPart> parseMergelistBinary(const char * begin, const char * end) {
+    const auto remaining = [&end](const char * pos, const std::uint64_t bytes){
+        return static_cast<std::uint64_t>(end - pos) >= bytes;
+    };
+    if (!isBinaryMergelist(begin, end) || !remaining(begin, sizeof(binaryMagic) + sizeof(std::uint64_t))) {
+        throw std::runtime_error("mergelist binary header invalid");
+    }
+    const char * pos = begin + sizeof(binaryMagic);
+    const auto objectCount = readLittleEndian<quint64>(pos);
+    const std::size_t recordHeaderBytes = 2 * sizeof(quint64) + 3 * sizeof(qint32) + 4 * sizeof(quint8) + 2 * sizeof(quint32);
+    std::vector<MergelistPart> result(1);
+    auto & part = result.front();
+    part.entries.reserve(std::min<std::uint64_t>(objectCount, (end - pos) / recordHeaderBytes));
+    for (std::uint64_t i = 0; i < objectCount; ++i) {
+        if (!remaining(pos, recordHeaderBytes)) {
+            throw std::runtime_error("mergelist binary truncated");
+        }
+        MergelistEntry entry;
+        entry.id = readLittleEndian<quint64>(pos);
+        entry.subobjectCount = readLittleEndian<quint64>(pos);
+        entry.location.x = readLittleEndian<qint32>(pos);
+        entry.location.y = readLittleEndian<qint32>(pos);
+        entry.location.z = readLittleEndian<qint32>(pos);
+        const auto flags = readLittleEndian<quint8>(pos);
+        const auto r = readLittleEndian<quint8>(pos);
+        const auto g = readLittleEndian<quint8>(pos);
+        const auto b = readLittleEndian<quint8>(pos);
+        entry.categoryLength = readLittleEndian<quint32>(pos);
+        entry.commentLength = readLittleEndian<quint32>(pos);
+        entry.todo = flags & 1;
+        entry.immutable = flags & 2;
+        if (flags & 4) {
+            entry.color = std::make_tuple(r, g, b);
+        }
+        if (entry.subobjectCount == 0 || entry.subobjectCount > (end - pos) / sizeof(quint64)
+                || !remaining(pos, entry.subobjectCount * sizeof(quint64) + entry.categoryLength + entry.commentLength)) {
+            throw std::runtime_error("mergelist binary truncated");
+        }
+        entry.firstSubobject = part.subobjectIds.size();
+        part.subobjectIds.resize(part.subobjectIds.size() + entry.subobjectCount);
+        std::memcpy(part.subobjectIds.data() + entry.firstSubobject, pos, entry.subobjectCount * sizeof(quint64));
+        pos += entry.subobjectCount * sizeof(quint64);
+        for (auto it = std::next(std::begin(part.subobjectIds), entry.firstSubobject); it != std::end(part.subobjectIds); ++it) {
+            *it = qFromLittleEndian(*it);// no-op on little-endian hosts
+        }
+        entry.category = pos;
+        pos += entry.categoryLength;
+        entry.comment = pos;
+        pos += entry.commentLength;
+        part.entries.emplace_back(entry);
+    }
+    return result;
+}
@@ -0,0 +1,71 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef MERGELIST_H
+#define MERGELIST_H
+
+#include "coordinate.h"
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+/**
+ * A parsed mergelist entry, category and comment point into the parsed buffer.
+ */
+struct MergelistEntry {
+    std::uint64_t id;
+    bool todo;
+    bool immutable;
+    Coordinate location;
+    boost::optional<std::tuple<std::uint8_t, std::uint8_t, std::uint8_t>> color;
+    std::size_t firstSubobject;// into the subobjectIds of its part
+    std::size_t subobjectCount;
+    const char * category;
+    std::size_t categoryLength;
+    const char * comment;
+    std::size_t commentLength;
+};
+
+/**
+ * Entries of one consecutive range of the buffer, parts are parsed independently.
+ */
+struct MergelistPart {
+    std::vector<MergelistEntry> entries;
+    std::vector<std::uint64_t> subobjectIds;
+};
+
+/*
+ * The binary mergelist (mergelist.bin) stores the same content as the text one in little-endian:
+ * [8 byte magic "KMLBIN01"][uint64 object count] followed by one record per object:
+ * [uint64 id][uint64 subobject count][3 × int32 location][uint8 flags: 1 todo, 2 immutable, 4 color][3 × uint8 color]
+ * [uint32 category bytes][uint32 comment bytes][subobject count × uint64 ids][utf-8 category][utf-8 comment]
+ */
+bool isBinaryMergelist(const char * begin, const char * end);
+// both throw std::runtime_error on malformed input
+std::vector<MergelistPart> parseMergelistText(const char * begin, const char * end);
+std::vector<MergelistPart> parseMergelistBinary(const char * begin, const char * end);
+
+#endif//MERGELIST_H
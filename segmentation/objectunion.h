@@ -0,0 +1,97 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef OBJECTUNION_H
+#define OBJECTUNION_H
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * Union-find over object handles with path halving and union by size.
+ * Every object gets a handle for its lifetime, subobjects refer to their objects by handle.
+ * When an object is merged into another its handle is united with the survivor’s,
+ * so the subobjects referring to it resolve to the survivor without being touched.
+ * The root of each set carries the current index of its object.
+ * Lookups compress paths, so they must not run concurrently with each other.
+ */
+class ObjectUnion {
+    mutable std::vector<std::uint64_t> parent;
+    std::vector<std::uint64_t> size;
+    std::vector<std::uint64_t> index;// valid at roots
+public:
+    static constexpr std::uint64_t removed = std::numeric_limits<std::uint64_t>::max();
+
+    void clear() {
+        parent.clear();
+        size.clear();
+        index.clear();
+    }
+    void reserve(const std::size_t count) {
+        parent.reserve(count);
+        size.reserve(count);
+        index.reserve(count);
+    }
+    std::uint64_t add(const std::uint64_t objectIndex) {
+        parent.emplace_back(parent.size());
+        size.emplace_back(1);
+        index.emplace_back(objectIndex);
+        return parent.size() - 1;
+    }
+    std::uint64_t find(std::uint64_t handle) const {
+        while (parent[handle] != handle) {
+            parent[handle] = parent[parent[handle]];
+            handle = parent[handle];
+        }
+        return handle;
+    }
+    /**
+     * @brief unite makes merged resolve to the object of survivor
+     */
+    void unite(const std::uint64_t survivor, const std::uint64_t merged) {
+        auto root = find(survivor);
+        auto other = find(merged);
+        if (root == other) {
+            return;
+        }
+        const auto survivorIndex = index[root];
+        if (size[root] < size[other]) {
+            std::swap(root, other);
+        }
+        parent[other] = root;
+        size[root] += size[other];
+        index[root] = survivorIndex;
+    }
+    std::uint64_t indexOf(const std::uint64_t handle) const {
+        return index[find(handle)];
+    }
+    void setIndex(const std::uint64_t handle, const std::uint64_t objectIndex) {
+        index[find(handle)] = objectIndex;
+    }
+    bool same(const std::uint64_t lhs, const std::uint64_t rhs) const {
+        return find(lhs) == find(rhs);
+    }
+};
+
+#endif//OBJECTUNION_H
@@ -22,8 +22,11 @@
 
 #include "segmentation.h"
 
+#include "editjournal.h"
 #include "file_io.h"
 #include "loader.h"
+#include "mergelist.h"
+#include "profiler.h"
 #include "session.h"
 #include "skeleton/skeletonizer.h"
 #include "stateInfo.h"
@@ -31,15 +34,18 @@
 
 #include <QSignalBlocker>
 #include <QTextStream>
+#include <QTimer>
+#include <QtEndian>
 
 #include <algorithm>
 #include <fstream>
-#include <sstream>
+#include <numeric>
 #include <utility>
 
 uint64_t Segmentation::SubObject::highestId = 0;
 uint64_t Segmentation::Object::highestId = 0;
 uint64_t Segmentation::Object::highestIndex = -1;
+ObjectUnion Segmentation::Object::handles;
 
 Segmentation::Object::Object(std::vector<std::reference_wrapper<SubObject>> initialVolumes, const Coordinate & location, const uint64_t id, const bool & todo, const bool & immutable)
     : id(id), todo(todo), immutable(immutable), location(location) {
@@ -63,11 +69,13 @@ bool Segmentation::Object::operator==(const Segmentation::Object & other) const
 }
 
 void Segmentation::Object::addExistingSubObject(Segmentation::SubObject & sub) {
-    const auto objectPosIt = std::lower_bound(std::begin(sub.objects), std::end(sub.objects), this->index);
-    if (objectPosIt != std::end(sub.objects) && *objectPosIt == this->index) {
+    const auto contained = std::any_of(std::begin(sub.objects), std::end(sub.objects), [this](const uint64_t parent){
+        return handles.same(parent, handle);
+    });
+    if (contained) {
         throw std::runtime_error(tr("object %1 already contains subobject %2").arg(this->id).arg(sub.id).toStdString());
     }
-    sub.objects.emplace(objectPosIt, this->index);//register parent
+    sub.objects.emplace_back(handle);//register parent
     subobjects.emplace_back(sub);//add child
 }
 
@@ -76,9 +84,11 @@ Segmentation::Object & Segmentation::Object::merge(Segmentation::Object & other)
         auto & parentObjs = elem.get().objects;
         elem.get().selectedObjectsCount = 1;
         //don’t insert twice
-        auto posIt = std::lower_bound(std::begin(parentObjs), std::end(parentObjs), this->index);
-        if (posIt == std::end(parentObjs) || *posIt != this->index) {
-            parentObjs.emplace(posIt, this->index);
+        const auto contained = std::any_of(std::begin(parentObjs), std::end(parentObjs), [this](const uint64_t parent){
+            return handles.same(parent, handle);
+        });
+        if (!contained) {
+            parentObjs.emplace_back(handle);
         }
     }
     decltype(subobjects) tmp;
@@ -90,6 +100,23 @@ Segmentation::Object & Segmentation::Object::merge(Segmentation::Object & other)
     return *this;
 }
 
+/**
+ * @brief Object::absorb merges other into this object for good, other has to be dropped afterwards.
+ *      Instead of registering this object in every subobject of other, the handle of other is united with ours.
+ */
+Segmentation::Object & Segmentation::Object::absorb(Segmentation::Object & other) {
+    for (auto & elem : other.subobjects) {
+        elem.get().selectedObjectsCount = 1;
+    }
+    decltype(subobjects) tmp;
+    tmp.reserve(subobjects.size() + other.subobjects.size());
+    std::merge(std::begin(subobjects), std::end(subobjects), std::begin(other.subobjects), std::end(other.subobjects), std::back_inserter(tmp));
+    tmp.erase(std::unique(std::begin(tmp), std::end(tmp)), std::end(tmp));
+    std::swap(subobjects, tmp);
+    handles.unite(handle, other.handle);
+    return *this;
+}
+
 Segmentation & Segmentation::singleton() {
     static Segmentation segmentation;
     return segmentation;
@@ -111,11 +138,15 @@ void Segmentation::clear() {
     objectIdToIndex.clear();
     Object::highestId = 0;
     Object::highestIndex = -1;
+    Object::handles.clear();
+    pendingObjectRefreshes.clear();
     SubObject::highestId = 0;
     subobjects.clear();
+    subobjectTable.clear();
     touched_subobject_id = 0;
     categories = prefixed_categories;
 
+    EditJournal::singleton().clear();
     if (Loader::Controller::singleton().worker != nullptr) {
         //dispatch to loader thread, original cubes are reloaded automatically
         QTimer::singleShot(0, Loader::Controller::singleton().worker.get(), &Loader::Worker::snappyCacheClear);
@@ -133,6 +164,7 @@ std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> Segmentation::subobjectColor(cons
 
 void Segmentation::loadOverlayLutFromFile(const QString & path) {
     overlayColorMap = loadLookupTable(path);
+    rebuildSubobjectTable();
     emit resetData();
 }
 
@@ -155,31 +187,62 @@ Segmentation::Object & Segmentation::createObjectFromSubobjectId(const uint64_t
     return createObject(std::vector<std::reference_wrapper<SubObject>>{subobjectIt->second}, location, objectId, todo, immutable);
 }
 
+/**
+ * @brief Segmentation::createObjectFromSubobjectIds creates an object with all its subobjects at once, they are registered and sorted a single time
+ */
+Segmentation::Object & Segmentation::createObjectFromSubobjectIds(const uint64_t * firstId, const uint64_t * lastId, const Coordinate & location, const uint64_t objectId, const bool todo, const bool immutable) {
+    if (objectIdToIndex.find(objectId) != std::end(objectIdToIndex)) {
+        throw std::runtime_error(tr("object with id %1 already exists").arg(objectId).toStdString());
+    }
+    std::vector<std::reference_wrapper<SubObject>> initialVolumes;
+    initialVolumes.reserve(lastId - firstId);
+    for (auto * subobjectId = firstId; subobjectId != lastId; ++subobjectId) {
+        auto subobjectIt = subobjects.emplace(std::piecewise_construct, std::forward_as_tuple(*subobjectId), std::forward_as_tuple(*subobjectId)).first;
+        initialVolumes.emplace_back(subobjectIt->second);
+    }
+    return createObject(std::move(initialVolumes), location, objectId, todo, immutable);
+}
+
 template<typename... Args>
 Segmentation::Object & Segmentation::createObject(Args &&... args) {
     emit beforeAppendRow();
     objects.emplace_back(std::forward<Args>(args)...);
     objectIdToIndex[objects.back().id] = objects.size() - 1;
+    refreshObject(objects.back());
     emit appendedRow();
     return objects.back();
 }
 
 void Segmentation::removeObject(Object & object) {
     unselectObject(object);
+    std::vector<std::reference_wrapper<SubObject>> remaining;
     for (auto & elem : object.subobjects) {
         auto & subobject = elem.get();
-        subobject.objects.erase(std::remove(std::begin(subobject.objects), std::end(subobject.objects), object.index), std::end(subobject.objects));
+        subobject.objects.erase(std::remove_if(std::begin(subobject.objects), std::end(subobject.objects), [&object](const uint64_t parent){
+            return Object::handles.same(parent, object.handle);
+        }), std::end(subobject.objects));
         if (subobject.objects.empty()) {
+            subobjectTable.erase(subobject.id);
             subobjects.erase(subobject.id);
+        } else {
+            remaining.emplace_back(subobject);
         }
     }
+    Object::handles.setIndex(object.handle, ObjectUnion::removed);
+    dropObject(object);
+    for (const auto & subobject : remaining) {
+        refreshSubobject(subobject);
+    }
+}
+
+/**
+ * @brief Segmentation::dropObject removes the row of object, subobjects must no longer resolve to it
+ */
+void Segmentation::dropObject(Object & object) {
     //swap with last, so no intermediate rows need to be deleted
     if (objects.size() > 1 && object.index != objects.back().index) {
-        //replace object index in subobjects
-        for (auto & elem : objects.back().subobjects) {
-            auto & subobject = elem.get();
-            std::replace(std::begin(subobject.objects), std::end(subobject.objects), objects.back().index, object.index);
-        }
+        //replace object index of the handles
+        Object::handles.setIndex(objects.back().handle, object.index);
         //replace object index in selected objects
         selectedObjectIndices.replace(objects.back().index, object.index);
         std::swap(objects.back().index, object.index);
@@ -209,6 +272,7 @@ void Segmentation::changeCategory(Object & obj, const QString & category) {
 
 void Segmentation::changeColor(Object &obj, const std::tuple<uint8_t, uint8_t, uint8_t> & color) {
     obj.color = color;
+    refreshObject(obj);
     emit changedRow(obj.index);
 }
 
@@ -220,6 +284,27 @@ void Segmentation::changeComment(Object & obj, const QString & comment) {
 void Segmentation::newSubObject(Object & obj, uint64_t subObjID) {
     auto subobjectIt = subobjects.emplace(std::piecewise_construct, std::forward_as_tuple(subObjID), std::forward_as_tuple(subObjID)).first;
     obj.addExistingSubObject(subobjectIt->second);
+    refreshSubobject(subobjectIt->second);
+    // the larger object may now be shown for subobjects it shares, refresh them once per batch of additions
+    if (pendingObjectRefreshes.empty()) {
+        QTimer::singleShot(0, this, &Segmentation::refreshPendingObjects);
+    }
+    pendingObjectRefreshes.emplace(obj.handle);
+}
+
+void Segmentation::refreshPendingObjects() {
+    for (const auto handle : pendingObjectRefreshes) {
+        const auto objectIndex = Object::handles.indexOf(handle);
+        if (objectIndex == ObjectUnion::removed) {
+            continue;
+        }
+        for (const auto & subobject : objects[objectIndex].subobjects) {
+            if (subobject.get().objects.size() > 1) {
+                refreshSubobject(subobject);
+            }
+        }
+    }
+    pendingObjectRefreshes.clear();
 }
 
 void Segmentation::setRenderOnlySelectedObjs(const bool onlySelected) {
@@ -256,31 +341,77 @@ std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> Segmentation::colorOfSelectedObje
     if (subobject.selectedObjectsCount > 1) {
         return std::make_tuple(std::uint8_t{255}, std::uint8_t{0}, std::uint8_t{0}, alpha);//mark overlapping objects in red
     }
-    const auto objectIndex = *std::find_if(std::begin(subobject.objects), std::end(subobject.objects), [this](const uint64_t index){
-        return objects[index].selected;
+    const auto parent = *std::find_if(std::begin(subobject.objects), std::end(subobject.objects), [this](const uint64_t handle){
+        return objects[Object::handles.indexOf(handle)].selected;
     });
-    return colorObjectFromIndex(objectIndex);
+    return colorObjectFromIndex(Object::handles.indexOf(parent));
 }
 
 std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> Segmentation::colorObjectFromSubobjectId(const uint64_t subObjectID) const {
-    if (subObjectID == backgroundId) {
-        return {};
+    return subobjectRenderInfo(subObjectID).color;
+}
+
+/**
+ * @brief Segmentation::subobjectRenderInfo is a single lookup in subobjectTable, safe to call from render and worker threads
+ */
+Segmentation::SubobjectRenderInfo Segmentation::subobjectRenderInfo(const uint64_t subobjectId) const {
+    const auto * entry = subobjectTable.find(subobjectId);
+    if (entry == nullptr) {
+        if (subobjectId == backgroundId || (renderOnlySelectedObjs && !selectedObjectIndices.empty())) {
+            return {{}, false, 0};
+        }
+        return {subobjectColor(subobjectId), false, 0};
     }
-    const auto subobjectIt = subobjects.find(subObjectID);
-    if (subobjectIt == std::end(subobjects)) {
-        if (!renderOnlySelectedObjs || selectedObjectIndices.empty()) {
-            return subobjectColor(subObjectID);
-        } else {
-            return {};
+    if (subobjectId == backgroundId || (!entry->selected && renderOnlySelectedObjs)) {
+        return {{}, entry->selected, entry->objectId};
+    }
+    const auto color = std::make_tuple(static_cast<uint8_t>(entry->rgb >> 16), static_cast<uint8_t>(entry->rgb >> 8), static_cast<uint8_t>(entry->rgb), alpha);
+    return {color, entry->selected, entry->objectId};
+}
+
+void Segmentation::refreshSubobject(const SubObject & subobject) {
+    const auto largest = largestObjectContainingSubobject(subobject);
+    auto shown = largest;
+    if (subobject.selectedObjectsCount == 1) {
+        const auto parent = std::find_if(std::begin(subobject.objects), std::end(subobject.objects), [this](const uint64_t handle){
+            return objects[Object::handles.indexOf(handle)].selected;
+        });
+        if (parent != std::end(subobject.objects)) {
+            shown = Object::handles.indexOf(*parent);
+        }
+    }
+    uint32_t rgb = 0xFF0000;//mark overlapping objects in red
+    if (subobject.selectedObjectsCount <= 1) {
+        const auto color = colorObjectFromIndex(shown);
+        rgb = (uint32_t{std::get<0>(color)} << 16) | (uint32_t{std::get<1>(color)} << 8) | std::get<2>(color);
+    }
+    subobjectTable.emplace(subobject.id, {rgb, subobject.selectedObjectsCount != 0, objects[largest].id});
+}
+
+void Segmentation::refreshObject(const Object & object) {
+    for (const auto & subobject : object.subobjects) {
+        refreshSubobject(subobject);
+    }
+}
+
+void Segmentation::rebuildSubobjectTable() {
+    subobjectTable.clear();
+    subobjectTable.reserve(subobjects.size());
+    for (const auto & pair : subobjects) {
+        if (!pair.second.objects.empty()) {
+            refreshSubobject(pair.second);
         }
     }
-    const auto & subobject = subobjectIt->second;
-    if (subobject.selectedObjectsCount != 0) {
-        return colorOfSelectedObject(subobject);
-    } else if (renderOnlySelectedObjs) {
-        return {};
+}
+
+std::unordered_map<uint64_t, std::tuple<uint8_t, uint8_t, uint8_t, uint8_t>> Segmentation::selectedSubobjectColors() const {
+    std::unordered_map<uint64_t, std::tuple<uint8_t, uint8_t, uint8_t, uint8_t>> colors;
+    for (const auto objectIndex : selectedObjectIndices) {
+        for (const auto & subobject : objects[objectIndex].subobjects) {
+            colors.emplace(subobject.get().id, colorObjectFromSubobjectId(subobject.get().id));
+        }
     }
-    return colorObjectFromIndex(largestObjectContainingSubobject(subobject));
+    return colors;
 }
 
 bool Segmentation::subobjectExists(const uint64_t & subobjectId) const {
@@ -288,6 +419,16 @@ bool Segmentation::subobjectExists(const uint64_t & subobjectId) const {
     return it != std::end(subobjects);
 }
 
+std::vector<uint64_t> Segmentation::subobjectIdsOfObject(const uint64_t objectIndex) const {
+    std::vector<uint64_t> ids;
+    if (objectIndex < objects.size()) {
+        for (const auto & subobject : objects[objectIndex].subobjects) {
+            ids.emplace_back(subobject.get().id);
+        }
+    }
+    return ids;
+}
+
 uint64_t Segmentation::subobjectIdOfFirstSelectedObject(const Coordinate & newLocation) {
     if (selectedObjectsCount() != 0) {
         auto & obj = objects[selectedObjectIndices.front()];
@@ -319,12 +460,39 @@ uint64_t Segmentation::largestObjectContainingSubobjectId(const uint64_t subObje
     return largestObjectContainingSubobject(subobject);
 }
 
+/**
+ * @brief Segmentation::preferredObject returns the index of the containing object which no other one is better(other, current) than.
+ *      Ties go to the lower index.
+ */
+template<typename Better>
+uint64_t Segmentation::preferredObject(const SubObject & subobject, Better better) const {
+    auto objectIndex = Object::handles.indexOf(subobject.objects.front());
+    for (const auto handle : subobject.objects) {
+        const auto index = Object::handles.indexOf(handle);
+        if (better(index, objectIndex) || (!better(objectIndex, index) && index < objectIndex)) {
+            objectIndex = index;
+        }
+    }
+    return objectIndex;
+}
+
+std::vector<uint64_t> Segmentation::objectIndices(const SubObject & subobject) const {
+    std::vector<uint64_t> indices;
+    indices.reserve(subobject.objects.size());
+    for (const auto handle : subobject.objects) {
+        indices.emplace_back(Object::handles.indexOf(handle));
+    }
+    std::sort(std::begin(indices), std::end(indices));
+    indices.erase(std::unique(std::begin(indices), std::end(indices)), std::end(indices));// merged objects resolve to the same index
+    return indices;
+}
+
 uint64_t Segmentation::largestObjectContainingSubobject(const Segmentation::SubObject & subobject) const {
     //same comparator for both functions, it seems to work as it is, so i don’t waste my head now to find out why
     //there may have been some reasoning… (at first glance it seems too restrictive for the largest object)
-    auto comparator = std::bind(&Segmentation::objectOrder, this, std::placeholders::_1, std::placeholders::_2);
-    const auto objectIndex = *std::max_element(std::begin(subobject.objects), std::end(subobject.objects), comparator);
-    return objectIndex;
+    return preferredObject(subobject, [this](const uint64_t lhs, const uint64_t rhs){
+        return objectOrder(rhs, lhs);
+    });
 }
 
 uint64_t Segmentation::tryLargestObjectContainingSubobject(const uint64_t subObjectId) const {
@@ -336,9 +504,55 @@ uint64_t Segmentation::tryLargestObjectContainingSubobject(const uint64_t subObj
 }
 
 uint64_t Segmentation::smallestImmutableObjectContainingSubobject(const Segmentation::SubObject & subobject) const {
-    auto comparitor = std::bind(&Segmentation::objectOrder, this, std::placeholders::_1, std::placeholders::_2);
-    const auto objectIndex = *std::min_element(std::begin(subobject.objects), std::end(subobject.objects), comparitor);
-    return objectIndex;
+    return preferredObject(subobject, [this](const uint64_t lhs, const uint64_t rhs){
+        return objectOrder(lhs, rhs);
+    });
+}
+
+static VoxelStats toMag1(VoxelStats stats, const uint64_t mag) {
+    const auto voxelsPerVoxel = mag * mag * mag;
+    stats.count *= voxelsPerVoxel;
+    for (auto & sum : stats.sum) {
+        sum *= static_cast<int64_t>(voxelsPerVoxel);// keeps the centroid
+    }
+    return stats;
+}
+
+VoxelStats Segmentation::subobjectVoxelStats(const uint64_t subobjectId) const {
+    const auto mag = Dataset::current().magnification;
+    return toMag1(VoxelStatsIndex::singleton().subobject(int_log(mag), subobjectId), mag);
+}
+
+VoxelStats Segmentation::objectVoxelStats(const uint64_t objectIndex) const {
+    VoxelStats stats;
+    if (objectIndex < objects.size()) {
+        const auto mag = Dataset::current().magnification;
+        for (const auto & subobject : objects[objectIndex].subobjects) {
+            stats.merge(VoxelStatsIndex::singleton().subobject(int_log(mag), subobject.get().id));
+        }
+        stats = toMag1(stats, mag);
+    }
+    return stats;
+}
+
+std::vector<uint64_t> Segmentation::objectVoxelCounts() const {
+    std::vector<uint64_t> subobjectIds;
+    for (const auto & object : objects) {
+        for (const auto & subobject : object.subobjects) {
+            subobjectIds.emplace_back(subobject.get().id);
+        }
+    }
+    const auto mag = static_cast<uint64_t>(Dataset::current().magnification);
+    const auto subobjectCounts = VoxelStatsIndex::singleton().counts(int_log(mag), subobjectIds);// one lock for all of them
+    std::vector<uint64_t> counts;
+    counts.reserve(objects.size());
+    auto countIt = std::begin(subobjectCounts);
+    for (const auto & object : objects) {
+        const auto next = std::next(countIt, object.subobjects.size());
+        counts.emplace_back(mag * mag * mag * std::accumulate(countIt, next, uint64_t{0}));
+        countIt = next;
+    }
+    return counts;
 }
 
 void Segmentation::hoverSubObject(const uint64_t subobject_id) {
@@ -346,7 +560,7 @@ void Segmentation::hoverSubObject(const uint64_t subobject_id) {
         const auto & iter = Segmentation::singleton().subobjects.find(subobject_id);
         std::vector<uint64_t> overlappingObjIndices;
         if (iter != std::end(Segmentation::singleton().subobjects)) {
-            overlappingObjIndices = iter->second.objects;
+            overlappingObjIndices = objectIndices(iter->second);
         }
         emit hoveredSubObjectChanged(hovered_subobject_id = subobject_id, overlappingObjIndices);
     }
@@ -366,7 +580,7 @@ std::vector<std::reference_wrapper<Segmentation::Object>> Segmentation::touchedO
     auto it = subobjects.find(touched_subobject_id);
     std::vector<std::reference_wrapper<Segmentation::Object>> vec;
     if (it != std::end(subobjects)) {
-        for (const auto & index : it->second.objects) {
+        for (const auto & index : objectIndices(it->second)) {
             vec.emplace_back(objects[index]);
         }
     }
@@ -382,8 +596,8 @@ bool Segmentation::isSelected(const uint64_t & objectIndex) const {
 }
 
 bool Segmentation::isSubObjectIdSelected(const uint64_t & subobjectId) const {
-    auto it = subobjects.find(subobjectId);
-    return it != std::end(subobjects) ? isSelected(it->second) : false;
+    const auto * entry = subobjectTable.find(subobjectId);
+    return entry != nullptr && entry->selected;
 }
 
 void Segmentation::clearObjectSelection() {
@@ -404,6 +618,7 @@ void Segmentation::selectObject(Object & object) {
     for (auto & subobj : object.subobjects) {
         ++subobj.get().selectedObjectsCount;
     }
+    refreshObject(object);
     selectedObjectIndices.emplace_back(object.index);
     emit changedRowSelection(object.index);
 }
@@ -422,6 +637,7 @@ void Segmentation::unselectObject(Object & object) {
     for (auto & subobj : object.subobjects) {
         --subobj.get().selectedObjectsCount;
     }
+    refreshObject(object);
     selectedObjectIndices.erase(object.index);
     emit changedRowSelection(object.index);
 }
@@ -498,9 +714,12 @@ void Segmentation::unmergeObject(Segmentation::Object & object, Segmentation::Ob
             unselectObject(object);
             for (auto & elem : other.subobjects) {
                 auto & parentObjs = elem.get().objects;
-                parentObjs.erase(std::remove(std::begin(parentObjs), std::end(parentObjs), object.index), std::end(parentObjs));//remove parent
+                parentObjs.erase(std::remove_if(std::begin(parentObjs), std::end(parentObjs), [&object](const uint64_t parent){
+                    return Object::handles.same(parent, object.handle);
+                }), std::end(parentObjs));//remove parent
             }
             std::swap(object.subobjects, tmp);
+            refreshObject(other);
             selectObject(object);
             emit changedRow(object.index);
         }
@@ -509,14 +728,14 @@ void Segmentation::unmergeObject(Segmentation::Object & object, Segmentation::Ob
 
 Segmentation::Object & Segmentation::objectFromSubobject(Segmentation::SubObject & subobject, const Coordinate & position) {
     const auto & other = std::find_if(std::begin(subobject.objects), std::end(subobject.objects)
-    , [&](const uint64_t elemId){
-        const auto & elem = objects[elemId];
+    , [&](const uint64_t handle){
+        const auto & elem = objects[Object::handles.indexOf(handle)];
         return elem.subobjects.size() == 1 && elem.subobjects.front().get().id == subobject.id;
     });
     if (other == std::end(subobject.objects)) {
         return createObject(std::vector<std::reference_wrapper<SubObject>>{subobject}, position);
     } else {
-        return objects[*other];
+        return objects[Object::handles.indexOf(*other)];
     }
 }
 
@@ -560,51 +779,98 @@ void Segmentation::mergelistSave(QIODevice & file) const {
     }
 }
 
+/**
+ * @brief Segmentation::mergelistSaveBinary writes the format described in mergelist.h, it loads without any text parsing
+ */
+void Segmentation::mergelistSaveBinary(QIODevice & file) const {
+    QByteArray buffer;
+    const auto append = [&buffer](auto value){
+        value = qToLittleEndian(value);
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    buffer.append("KMLBIN01", 8);
+    append(static_cast<quint64>(objects.size()));
+    for (const auto & obj : objects) {
+        const auto category = obj.category.toUtf8();
+        const auto comment = obj.comment.toUtf8();
+        append(static_cast<quint64>(obj.id));
+        append(static_cast<quint64>(obj.subobjects.size()));
+        append(static_cast<qint32>(obj.location.x));
+        append(static_cast<qint32>(obj.location.y));
+        append(static_cast<qint32>(obj.location.z));
+        append(static_cast<quint8>(obj.todo | (obj.immutable << 1) | (static_cast<bool>(obj.color) << 2)));
+        const auto color = obj.color ? obj.color.get() : std::tuple<uint8_t, uint8_t, uint8_t>{};
+        append(static_cast<quint8>(std::get<0>(color)));
+        append(static_cast<quint8>(std::get<1>(color)));
+        append(static_cast<quint8>(std::get<2>(color)));
+        append(static_cast<quint32>(category.size()));
+        append(static_cast<quint32>(comment.size()));
+        for (const auto & subObj : obj.subobjects) {
+            append(static_cast<quint64>(subObj.get().id));
+        }
+        buffer.append(category);
+        buffer.append(comment);
+        if (buffer.size() > 1024 * 1024) {
+            if (file.write(buffer) != buffer.size()) {
+                qDebug() << "mergelistSaveBinary fail";
+                return;
+            }
+            buffer.clear();
+        }
+    }
+    if (file.write(buffer) != buffer.size()) {
+        qDebug() << "mergelistSaveBinary fail";
+    }
+}
+
+/**
+ * @brief Segmentation::mergelistLoad reads the whole mergelist into a single buffer and parses it in place,
+ *      then creates every object with all of its subobjects at once.
+ */
 void Segmentation::mergelistLoad(QIODevice & file) {
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::ReadOnly)) {
         throw std::runtime_error("mergelistLoad open failed");
     }
-    QTextStream stream(&file);
-    QString line;
+    static Profiler mergelist_profiler;
+    mergelist_profiler.start(); // ----------------------------------------------------------- profiling
+    const QByteArray content = file.readAll();// archive entries are decompressed into one buffer
+    const char * begin = content.constData();
+    const char * end = begin + content.size();
+    std::vector<MergelistPart> parts;
+    try {
+        parts = isBinaryMergelist(begin, end) ? parseMergelistBinary(begin, end) : parseMergelistText(begin, end);
+    } catch (const std::runtime_error & error) {
+        qWarning() << error.what();
+        Segmentation::clear();
+        throw std::runtime_error("mergelistLoad parsing failed");
+    }
+    std::size_t objectCount = 0;
+    std::size_t subobjectCount = 0;
+    for (const auto & part : parts) {
+        objectCount += part.entries.size();
+        subobjectCount += part.subobjectIds.size();
+    }
+    objects.reserve(objects.size() + objectCount);
+    objectIdToIndex.reserve(objectIdToIndex.size() + objectCount);
+    Object::handles.reserve(objects.size() + objectCount);
+    subobjects.reserve(subobjects.size() + subobjectCount);
+    subobjectTable.reserve(subobjects.size() + subobjectCount);
     {
         QSignalBlocker blocker{this};
-        while (!(line = stream.readLine()).isNull()) {
-            std::istringstream lineStream(line.toStdString());
-            std::istringstream coordColorLineStream(stream.readLine().toStdString());
-
-            uint64_t objId;
-            bool todo;
-            bool immutable;
-            Coordinate location;
-            uint r; uint g; uint b;
-            uint64_t initialVolume;
-            QString category;
-            QString comment;
-
-            bool valid0 = (lineStream >> objId) && (lineStream >> todo) && (lineStream >> immutable) && (lineStream >> initialVolume);
-            bool valid1 = (coordColorLineStream >> location.x) && (coordColorLineStream >> location.y) && (coordColorLineStream >> location.z);
-            bool customColorValid = (coordColorLineStream >> r) && (coordColorLineStream >> g) && (coordColorLineStream >> b);
-            bool valid2 = !(category = stream.readLine()).isNull();
-            bool valid3 = !(comment = stream.readLine()).isNull();
-
-            if (valid0 && valid1 && valid2 && valid3) {
-                auto & obj = createObjectFromSubobjectId(initialVolume, location, objId, todo, immutable);
-                uint64_t subObjId;
-                while (lineStream >> subObjId) {
-                    newSubObject(obj, subObjId);
-                }
-                std::sort(std::begin(obj.subobjects), std::end(obj.subobjects));
-                changeCategory(obj, category);
-                if (customColorValid) {
-                    changeColor(obj, std::make_tuple(r, g, b));
+        for (const auto & part : parts) {
+            for (const auto & entry : part.entries) {
+                const auto * firstId = part.subobjectIds.data() + entry.firstSubobject;
+                auto & obj = createObjectFromSubobjectIds(firstId, firstId + entry.subobjectCount, entry.location, entry.id, entry.todo, entry.immutable);
+                changeCategory(obj, QString::fromUtf8(entry.category, static_cast<int>(entry.categoryLength)));
+                if (entry.color) {
+                    changeColor(obj, entry.color.get());
                 }
-                obj.comment = comment;
-            } else {
-                Segmentation::clear();
-                throw std::runtime_error("mergelistLoad parsing failed");
+                obj.comment = QString::fromUtf8(entry.comment, static_cast<int>(entry.commentLength));
             }
         }
     }// QSignalBlocker
+    mergelist_profiler.end(); // ----------------------------------------------------------- profiling
+    // qDebug() << "mergelist load time: " << mergelist_profiler.average_time()*1000 << "ms for" << objectCount << "objects";
     emit resetData();
 }
 
@@ -673,27 +939,31 @@ void Segmentation::mergeSelectedObjects() {
             uint64_t newIndex = createObject(secondObj, firstObj).index;//create new object from merge result, invalidates firstObj and secondObj references since vector size changed
 
             flat_deselect(objects[firstIndex]);//firstObj got invalidated
+            refreshObject(objects[newIndex]);//the merge result is the only selected parent now
             selectedObjectIndices.emplace_front(newIndex);//move new index to front, so it gets the new merge origin
             emit changedRowSelection(firstIndex);
             emit changedRowSelection(secondIndex);
         } else if (secondObj.immutable) {
             flat_deselect(secondObj);
             firstObj.merge(secondObj);
+            refreshObject(firstObj);
             secondObj.todo = false;
             emit changedRowSelection(secondObj.index);
             emit changedRow(firstObj.index);
         } else if (firstObj.immutable) {
             flat_deselect(firstObj);
             secondObj.merge(firstObj);
+            refreshObject(secondObj);
             firstObj.todo = false;
             emit changedRowSelection(firstObj.index);
             emit changedRow(secondObj.index);
         } else {//if both are mutable the second object is merged into the first
             flat_deselect(secondObj);
-            firstObj.merge(secondObj);
+            firstObj.absorb(secondObj);
+            refreshObject(firstObj);
             secondObj.todo = false;
             emit changedRow(firstObj.index);
-            removeObject(secondObj);
+            dropObject(secondObj);
         }
     }
     emit todosLeftChanged();
@@ -733,6 +1003,7 @@ void Segmentation::restoreDefaultColorForSelectedObjects() {
             auto & colormap = Segmentation::singleton().overlayColorMap;
             auto & obj = objects[index];
             obj.color = colormap[obj.id % colormap.size()];
+            refreshObject(obj);
         }
         emit resetData();
     }
@@ -24,8 +24,11 @@
 #define SEGMENTATION_H
 
 #include "coordinate.h"
+#include "flat_id_map.h"
 #include "hash_list.h"
+#include "objectunion.h"
 #include "segmentationsplit.h"
+#include "voxelstats.h"
 
 #include <QColor>
 #include <QDebug>
@@ -40,6 +43,7 @@
 #include <random>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class Segmentation : public QObject {
@@ -61,7 +65,7 @@ Q_OBJECT
         friend class SegmentationObjectModel;
         friend class Segmentation;
         static uint64_t highestId;
-        std::vector<uint64_t> objects;
+        std::vector<uint64_t> objects;// handles of the containing objects, resolve them through Object::handles
         std::size_t selectedObjectsCount = 0;
     public:
         const uint64_t id;
@@ -93,11 +97,13 @@ Q_OBJECT
 
         static uint64_t highestId;
         static uint64_t highestIndex;
+        static ObjectUnion handles;
     public:
         //see http://coliru.stacked-crooked.com/a/aba85777991b4425
         std::vector<std::reference_wrapper<SubObject>> subobjects;
         uint64_t id;
         uint64_t index = ++highestIndex;
+        uint64_t handle = handles.add(index);
         bool todo;
         bool immutable;
         Coordinate location;
@@ -111,6 +117,7 @@ Q_OBJECT
         bool operator==(const Object & other) const;
         void addExistingSubObject(SubObject & sub);
         Object & merge(Object & other);
+        Object & absorb(Object & other);
     };
 
     std::unordered_map<uint64_t, SubObject> subobjects;
@@ -130,10 +137,26 @@ Q_OBJECT
     // The colors should be "maximally different".
     std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> overlayColorMap;
 
+    struct SubobjectEntry {
+        uint32_t rgb;// packed color of the shown object, alpha is applied on lookup
+        bool selected;
+        uint64_t objectId;// id of the largest containing object
+    };
+    // Kept up to date on the gui thread whenever membership, selection or colors change.
+    // Render and worker threads only read it while the gui thread waits for them, so lookups need no lock.
+    flat_id_map<SubobjectEntry> subobjectTable;
+    void refreshSubobject(const SubObject & subobject);
+    void refreshObject(const Object & object);
+    void rebuildSubobjectTable();
+    std::unordered_set<uint64_t> pendingObjectRefreshes;// handles of objects that grew, see newSubObject
+    void refreshPendingObjects();
+
     Object & createObjectFromSubobjectId(const uint64_t initialSubobjectId, const Coordinate & location, const uint64_t objectId = ++Object::highestId, const bool todo = false, const bool immutable = false);
+    Object & createObjectFromSubobjectIds(const uint64_t * firstId, const uint64_t * lastId, const Coordinate & location, const uint64_t objectId, const bool todo, const bool immutable);
     template<typename... Args>
     Object & createObject(Args && ... args);
     void removeObject(Object &);
+    void dropObject(Object &);
     void changeCategory(Object & obj, const QString & category);
     void changeColor(Object & obj, const std::tuple<uint8_t, uint8_t, uint8_t> & color);
     void changeComment(Object & obj, const QString & comment);
@@ -144,6 +167,9 @@ Q_OBJECT
     void unmergeObject(Object & object, Object & other, const Coordinate & position);
 
     Object & objectFromSubobject(Segmentation::SubObject & subobject, const Coordinate & position);
+    std::vector<uint64_t> objectIndices(const SubObject & subobject) const;
+    template<typename Better>
+    uint64_t preferredObject(const SubObject & subobject, Better better) const;
 public:
     class Job {
     public:
@@ -181,11 +207,21 @@ public:
     std::tuple<uint8_t, uint8_t, uint8_t, uint8_t>  colorOfSelectedObject() const;
     std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> colorOfSelectedObject(const SubObject & subobject) const;
     std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> colorObjectFromSubobjectId(const uint64_t subObjectID) const;
+    struct SubobjectRenderInfo {// what the overlay rendering needs to know about a subobject id
+        std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> color;
+        bool selected;
+        uint64_t objectId;// id of the largest containing object, 0 for unknown subobjects
+    };
+    SubobjectRenderInfo subobjectRenderInfo(const uint64_t subobjectId) const;
+    std::unordered_map<uint64_t, std::tuple<uint8_t, uint8_t, uint8_t, uint8_t>> selectedSubobjectColors() const;
     //volume rendering
     bool volume_render_toggle = false;
     std::atomic_bool volume_update_required{false};
     uint volume_tex_id = 0;
+    uint volume_occupancy_tex_id = 0;
     int volume_tex_len = 128;
+    int volume_occupancy_block = 8;// texels per occupancy grid cell along each axis
+    int volume_ray_steps = 256;
     int volume_mouse_move_x = 0;
     int volume_mouse_move_y = 0;
     float volume_mouse_zoom = 1.0f;
@@ -199,11 +235,16 @@ public:
     void createAndSelectObject(const Coordinate & position);
     SubObject & subobjectFromId(const uint64_t & subobjectId, const Coordinate & location);
     uint64_t subobjectIdOfFirstSelectedObject(const Coordinate & newLocation);
+    std::vector<uint64_t> subobjectIdsOfObject(const uint64_t objectIndex) const;
     bool objectOrder(const uint64_t &lhsIndex, const uint64_t &rhsIndex) const;
     uint64_t largestObjectContainingSubobjectId(const uint64_t subObjectId, const Coordinate & location);
     uint64_t largestObjectContainingSubobject(const SubObject & subobject) const;
     uint64_t tryLargestObjectContainingSubobject(const uint64_t subObjectId) const;
     uint64_t smallestImmutableObjectContainingSubobject(const SubObject & subobject) const;
+    //voxel statistics in mag 1 voxels, gathered from the cubes of the current magnification loaded so far
+    VoxelStats subobjectVoxelStats(const uint64_t subobjectId) const;
+    VoxelStats objectVoxelStats(const uint64_t objectIndex) const;
+    std::vector<uint64_t> objectVoxelCounts() const;// by object index
     //selection query
     bool isSelected(const SubObject & rhs) const;
     bool isSelected(const uint64_t &objectIndex) const;
@@ -227,8 +268,10 @@ public:
     void untouchObjects();
     std::vector<std::reference_wrapper<Object>> touchedObjects();
     //files
+    bool binaryMergelist{false};// save mergelist.bin instead of mergelist.txt
     void mergelistSave(QIODevice & file) const;
-    void mergelistLoad(QIODevice & file);
+    void mergelistSaveBinary(QIODevice & file) const;
+    void mergelistLoad(QIODevice & file);// reads both formats
     void loadOverlayLutFromFile(const QString & filename = ":/resources/color_palette/default.json");
 signals:
     void beforeAppendRow();
@@ -24,91 +24,222 @@
 
 #include "coordinate.h"
 #include "cubeloader.h"
+#include "editjournal.h"
 #include "loader.h"
+#include "profiler.h"
 #include "segmentation.h"
+#include "session.h"
 
+#include <algorithm>
+#include <array>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
-void subobjectBucketFill(const Coordinate & seed, const Coordinate & center, const uint64_t fillsoid, const brush_t & brush, const Coordinate & areaMin, const Coordinate & areaMax) {
-    std::vector<Coordinate> work = {seed};
-    std::unordered_set<Coordinate> visitedVoxels;
+namespace {
+/**
+ * @brief The FillCubes class tracks the visits of a flood fill in a dense bitmap per cube.
+ */
+class FillCubes {
+public:
+    struct Cube {
+        std::uint64_t * data{nullptr};
+        std::vector<bool> visited;
+    };
+    VoxelCursor & cursor;
+    const int cubeEdgeLen{cursor.cubeEdgeLen};
+    const int mag{cursor.mag};
 
-    const auto clickedsoid = readVoxel(seed);
+    explicit FillCubes(VoxelCursor & cursor) : cursor{cursor} {}
+    Cube & cube(const CoordOfCube & cubeCoord) {
+        auto it = cubes.find(cubeCoord);
+        if (it == std::end(cubes)) {
+            Cube cube;
+            cube.data = cursor.cube(cubeCoord);
+            if (cube.data != nullptr) {
+                cube.visited.resize(static_cast<std::size_t>(cubeEdgeLen) * cubeEdgeLen * cubeEdgeLen);
+            }
+            it = cubes.emplace(cubeCoord, std::move(cube)).first;
+        }
+        return it->second;
+    }
+    CoordOfCube cubeOf(const Coordinate & voxel) const {
+        return {voxel.x / cubeEdgeLen, voxel.y / cubeEdgeLen, voxel.z / cubeEdgeLen};
+    }
+    std::size_t indexOf(const Coordinate & voxel) const {
+        return cursor.index({voxel.x % cubeEdgeLen, voxel.y % cubeEdgeLen, voxel.z % cubeEdgeLen});
+    }
+private:
+    std::unordered_map<CoordOfCube, Cube> cubes;
+};
 
-    while (!work.empty()) {
-        const auto pos = work.back();
-        work.pop_back();
+int & component(Coordinate & voxel, const int axis) {
+    return axis == 0 ? voxel.x : axis == 1 ? voxel.y : voxel.z;
+}
 
-        if (readVoxel(pos) == clickedsoid) {
-            const auto walk = [&center, &visitedVoxels, &work](const auto x, const auto y, const auto z){
-                const bool wasntVisitedBefore = visitedVoxels.emplace(x, y, z).second;
-                if (wasntVisitedBefore && currentlyVisibleWrapWrap(center, {x, y, z})) {
-                    work.emplace_back(x, y, z);
-                }
-            };
+int component(const Coordinate & voxel, const int axis) {
+    return axis == 0 ? voxel.x : axis == 1 ? voxel.y : voxel.z;
+}
 
-            const auto posDec = (pos - 1).capped(areaMin, areaMax);
-            const auto posInc = (pos + 1).capped(areaMin, areaMax);
+/**
+ * @brief scanlineFill visits every voxel connected to seed along the enabled axes for which fillable returns true.
+ *      Runs along the first enabled axis are processed at once and end at cube borders.
+ *      The fill is bounded by areaMin and areaMax (global coordinates) and the movement area.
+ * @param fillable(voxel value, global position) is only asked for unvisited voxels of loaded cubes
+ * @param visit(voxel reference, global position) returns whether it changed the voxel, the cube is then marked as changed in the cursor and the voxel written back
+ */
+template<typename Fillable, typename Visit>
+void scanlineFill(VoxelCursor & cursor, const Coordinate & seed, const std::array<bool, 3> & axes, const Coordinate & areaMin, const Coordinate & areaMax, Fillable fillable, Visit visit) {
+    FillCubes cubes{cursor};
+    const auto & session = Session::singleton();
+    const auto voxelMin = areaMin.capped(session.movementAreaMin, session.movementAreaMax) / cubes.mag;
+    const auto voxelMax = areaMax.capped(session.movementAreaMin, session.movementAreaMax) / cubes.mag;
+    const auto inside = [&voxelMin, &voxelMax](const Coordinate & voxel){
+        return voxel.x >= voxelMin.x && voxel.y >= voxelMin.y && voxel.z >= voxelMin.z
+                && voxel.x <= voxelMax.x && voxel.y <= voxelMax.y && voxel.z <= voxelMax.z;
+    };
+    const auto fillableIn = [&cubes, &fillable](const FillCubes::Cube & cube, const Coordinate & voxel){
+        const auto index = cubes.indexOf(voxel);
+        return cube.data != nullptr && !cube.visited[index] && fillable(cube.data[index], voxel * cubes.mag);
+    };
+    const int spanAxis = axes[0] ? 0 : axes[1] ? 1 : 2;
 
-            if (brush.view != brush_t::view_t::zy || brush.mode == brush_t::mode_t::three_dim) {
-                walk(posInc.x, pos.y, pos.z);
-                walk(posDec.x, pos.y, pos.z);
+    std::vector<Coordinate> work{seed / cubes.mag};
+    while (!work.empty()) {
+        auto voxel = work.back();
+        work.pop_back();
+        if (!inside(voxel)) {
+            continue;
+        }
+        const auto cubeCoord = cubes.cubeOf(voxel);
+        auto & cube = cubes.cube(cubeCoord);
+        if (!fillableIn(cube, voxel)) {
+            continue;
+        }
+        // extend the run along the span axis within the cube
+        auto & spanPos = component(voxel, spanAxis);
+        const int cubeFirst = spanPos - spanPos % cubes.cubeEdgeLen;
+        const int cubeLast = cubeFirst + cubes.cubeEdgeLen - 1;
+        const int first = std::max(cubeFirst, component(voxelMin, spanAxis));
+        const int last = std::min(cubeLast, component(voxelMax, spanAxis));
+        const int seedPos = spanPos;
+        int runFirst = seedPos;
+        int runLast = seedPos;
+        if (axes[spanAxis]) {
+            for (spanPos = seedPos - 1; spanPos >= first && fillableIn(cube, voxel); --spanPos) {
+                runFirst = spanPos;
             }
-            if (brush.view != brush_t::view_t::xz || brush.mode == brush_t::mode_t::three_dim) {
-                walk(pos.x, posInc.y, pos.z);
-                walk(pos.x, posDec.y, pos.z);
+            for (spanPos = seedPos + 1; spanPos <= last && fillableIn(cube, voxel); ++spanPos) {
+                runLast = spanPos;
             }
-            if (brush.view != brush_t::view_t::xy || brush.mode == brush_t::mode_t::three_dim) {
-                walk(pos.x, pos.y, posInc.z);
-                walk(pos.x, pos.y, posDec.z);
+        }
+        for (spanPos = runFirst; spanPos <= runLast; ++spanPos) {
+            const auto index = cubes.indexOf(voxel);
+            cube.visited[index] = true;
+            auto value = cube.data[index];
+            if (visit(value, voxel * cubes.mag)) {
+                cursor.markChanged(cubeCoord);// before the write, to journal the cube
+                cube.data[index] = value;
+            }
+        }
+        // the run continues in the neighbouring cubes
+        if (axes[spanAxis] && runFirst == cubeFirst) {
+            spanPos = runFirst - 1;
+            work.emplace_back(voxel);
+        }
+        if (axes[spanAxis] && runLast == cubeLast) {
+            spanPos = runLast + 1;
+            work.emplace_back(voxel);
+        }
+        // one seed for each run in the adjacent rows
+        spanPos = runFirst;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (axis == spanAxis || !axes[axis]) {
+                continue;
+            }
+            for (const int step : {-1, 1}) {
+                auto neighbour = voxel;
+                component(neighbour, axis) += step;
+                if (!inside(neighbour)) {
+                    continue;
+                }
+                const auto & neighbourCube = cubes.cube(cubes.cubeOf(neighbour));
+                bool inRun = false;
+                for (component(neighbour, spanAxis) = runFirst; component(neighbour, spanAxis) <= runLast; ++component(neighbour, spanAxis)) {
+                    const bool neighbourFillable = fillableIn(neighbourCube, neighbour);
+                    if (neighbourFillable && !inRun) {
+                        work.emplace_back(neighbour);
+                    }
+                    inRun = neighbourFillable;
+                }
             }
-        } else {
-            visitedVoxels.erase(pos);
         }
     }
+}
 
-    listFill(center, brush, fillsoid, visitedVoxels);
+/**
+ * @brief objectMembership returns a predicate for subobject ids of the object to split, it caches the answer per id
+ */
+auto objectMembership(const uint64_t objIndexToSplit, const uint64_t newSubObjId, const Coordinate & seed) {
+    return [objIndexToSplit, newSubObjId, seed, cache = std::unordered_map<uint64_t, bool>{}](const uint64_t subobjectId) mutable {
+        if (subobjectId == Segmentation::singleton().getBackgroundId() || subobjectId == newSubObjId) {
+            return false;
+        }
+        auto it = cache.find(subobjectId);
+        if (it == std::end(cache)) {
+            auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, seed);
+            it = cache.emplace(subobjectId, Segmentation::singleton().largestObjectContainingSubobject(subobject) == objIndexToSplit).first;
+        }
+        return it->second;
+    };
+}
 }
 
-std::unordered_set<uint64_t> bucketFill(const Coordinate & seed, const uint64_t objIndexToSplit, const uint64_t newSubObjId, const std::unordered_set<uint64_t> & subObjectsToFill) {
-    std::vector<Coordinate> work = {seed};
-    std::unordered_set<Coordinate> visitedVoxels;
-    std::unordered_set<uint64_t> visitedSubObjects;
-    while (!work.empty()) {
-        auto pos = work.back();
-        work.pop_back();
+void subobjectBucketFill(const Coordinate & seed, const Coordinate & center, const uint64_t fillsoid, const brush_t & brush, const Coordinate & areaMin, const Coordinate & areaMax) {
+    static Profiler fill_profiler;
+    fill_profiler.start(); // ----------------------------------------------------------- profiling
 
-        auto subobjectId = readVoxel(pos);
-        if (subobjectId != Segmentation::singleton().getBackgroundId() && subobjectId != newSubObjId) {
-            auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, seed);
-            auto objIndex = Segmentation::singleton().largestObjectContainingSubobject(subobject);
-            if (objIndex == objIndexToSplit) {
-                if (subObjectsToFill.find(subobjectId) != std::end(subObjectsToFill)) {
-                    //only write to cubes which were hit by the splitting plane
-                    writeVoxel(pos, newSubObjId);//write to cube
-                } else {
-                    visitedSubObjects.emplace(subobject.id);//accumulate visited subobjects
-                }
+    EditJournal::ScopedEdit edit;
+    VoxelCursor cursor;
+    const auto clickedsoid = cursor.read(seed);
+    const auto region = getRegion(center, brush);// only voxels inside the brush region are written
+    const bool threeDim = brush.mode == brush_t::mode_t::three_dim;
+    const std::array<bool, 3> axes{{brush.view != brush_t::view_t::zy || threeDim, brush.view != brush_t::view_t::xz || threeDim, brush.view != brush_t::view_t::xy || threeDim}};
+    scanlineFill(cursor, seed, axes, areaMin, areaMax, [clickedsoid, &center](const uint64_t voxel, const Coordinate & pos){
+        return voxel == clickedsoid && currentlyVisibleWrapWrap(center, pos);
+    }, [fillsoid, &region](uint64_t & voxel, const Coordinate & pos){
+        if (pos.x >= region.first.x && pos.y >= region.first.y && pos.z >= region.first.z
+                && pos.x <= region.second.x && pos.y <= region.second.y && pos.z <= region.second.z) {
+            voxel = fillsoid;
+            return true;
+        }
+        return false;
+    });
 
-                visitedVoxels.emplace(pos.x, pos.y, pos.z);
-                auto walk = [&](const Coordinate & newPos){
-                    if (visitedVoxels.find(newPos) == std::end(visitedVoxels)) {
-                        work.emplace_back(newPos);
-                    }
-                };
-                walk({pos.x + 1, pos.y, pos.z});
-                walk({pos.x - 1, pos.y, pos.z});
-                walk({pos.x, pos.y + 1, pos.z});
-                walk({pos.x, pos.y - 1, pos.z});
-                walk({pos.x, pos.y, pos.z + 1});
-                walk({pos.x, pos.y, pos.z - 1});
-            }
+    fill_profiler.end(); // ----------------------------------------------------------- profiling
+    // qDebug() << "bucket fill avg time: " << fill_profiler.average_time()*1000 << "ms";
+}
+
+std::unordered_set<uint64_t> bucketFill(const Coordinate & seed, const uint64_t objIndexToSplit, const uint64_t newSubObjId, const std::unordered_set<uint64_t> & subObjectsToFill) {
+    std::unordered_set<uint64_t> visitedSubObjects;
+    auto isPartOfSplit = objectMembership(objIndexToSplit, newSubObjId, seed);
+    VoxelCursor cursor;
+    scanlineFill(cursor, seed, {{true, true, true}}, Session::singleton().movementAreaMin, Session::singleton().movementAreaMax, [&isPartOfSplit](const uint64_t voxel, const Coordinate &){
+        return isPartOfSplit(voxel);
+    }, [newSubObjId, &subObjectsToFill, &visitedSubObjects](uint64_t & voxel, const Coordinate &){
+        if (subObjectsToFill.find(voxel) != std::end(subObjectsToFill)) {
+            //only write to cubes which were hit by the splitting plane
+            voxel = newSubObjId;
+            return true;
         }
-    }
+        visitedSubObjects.emplace(voxel);//accumulate visited subobjects
+        return false;
+    });
     return visitedSubObjects;
 }
 
 void connectedComponent(const Coordinate & seed) {
+    EditJournal::ScopedEdit edit;
     auto subobjectId = readVoxel(seed);
     if (subobjectId != Segmentation::singleton().getBackgroundId()) {
         auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, seed);
@@ -136,38 +267,21 @@ void connectedComponent(const Coordinate & seed) {
 }
 
 std::unordered_set<uint64_t> verticalSplittingPlane(const Coordinate & pos, const uint64_t objIndexToSplit, const uint64_t newSubObjId) {
-    std::vector<Coordinate> work = {pos};
-    std::unordered_set<Coordinate> visitedVoxels;
     std::unordered_set<uint64_t> visitedSubObjects;
-    while (!work.empty()) {
-        auto pos = work.back();
-        work.pop_back();
-
-        auto subobjectId = readVoxel(pos);
-        if (subobjectId != Segmentation::singleton().getBackgroundId() && subobjectId != newSubObjId) {
-            auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, pos);
-            auto objIndex = Segmentation::singleton().largestObjectContainingSubobject(subobject);
-            if (objIndex == objIndexToSplit) {
-                writeVoxel(pos, newSubObjId);//write to cube
-                visitedSubObjects.emplace(subobject.id);//accumulate visited subobjects
-
-                visitedVoxels.emplace(pos.x, pos.y, pos.z);
-                auto walk = [&](const Coordinate & newPos){
-                    if (visitedVoxels.find(newPos) == std::end(visitedVoxels)) {
-                        work.emplace_back(newPos);
-                    }
-                };
-                walk({pos.x, pos.y + 1, pos.z});
-                walk({pos.x, pos.y - 1, pos.z});
-                walk({pos.x, pos.y, pos.z + 1});
-                walk({pos.x, pos.y, pos.z - 1});
-            }
-        }
-    }
+    auto isPartOfSplit = objectMembership(objIndexToSplit, newSubObjId, pos);
+    VoxelCursor cursor;
+    scanlineFill(cursor, pos, {{false, true, true}}, Session::singleton().movementAreaMin, Session::singleton().movementAreaMax, [&isPartOfSplit](const uint64_t voxel, const Coordinate &){
+        return isPartOfSplit(voxel);
+    }, [newSubObjId, &visitedSubObjects](uint64_t & voxel, const Coordinate &){
+        visitedSubObjects.emplace(voxel);//accumulate visited subobjects
+        voxel = newSubObjId;
+        return true;
+    });
     return visitedSubObjects;
 }
 
 void verticalSplittingPlane(const Coordinate & seed) {
+    EditJournal::ScopedEdit edit;
     auto subobjectId = readVoxel(seed);
     if (subobjectId != Segmentation::singleton().getBackgroundId()) {
         auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, seed);
@@ -182,12 +296,13 @@ void verticalSplittingPlane(const Coordinate & seed) {
         //add the newly created subobject to all non-splitted objects
         for (auto && id : subObjectsToFill) {
             auto & subobject = Segmentation::singleton().subobjectFromId(id, seed);
-            for (auto && objIndex : subobject.objects) {
+            for (auto && objIndex : Segmentation::singleton().objectIndices(subobject)) {
                 if (objIndex != splitId) {
                     auto && object = Segmentation::singleton().objects[objIndex];
                     auto & newSubobject = Segmentation::singleton().subobjectFromId(newSubObjId, seed);
                     object.addExistingSubObject(newSubobject);
                     std::sort(std::begin(object.subobjects), std::end(object.subobjects));
+                    Segmentation::singleton().refreshObject(object);
                 }
             }
         }
@@ -0,0 +1,286 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#include "voxelstats.h"
+
+#include "cubeloader.h"
+#include "stateInfo.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+void VoxelStats::merge(const VoxelStats & other) {
+    count += other.count;
+    for (std::size_t i = 0; i < sum.size(); ++i) {
+        sum[i] += other.sum[i];
+    }
+    min = {std::min(min.x, other.min.x), std::min(min.y, other.min.y), std::min(min.z, other.min.z)};
+    max = {std::max(max.x, other.max.x), std::max(max.y, other.max.y), std::max(max.z, other.max.z)};
+}
+
+floatCoordinate VoxelStats::centroid() const {
+    if (count == 0) {
+        return {};
+    }
+    return {static_cast<float>(sum[0] / static_cast<double>(count)), static_cast<float>(sum[1] / static_cast<double>(count)), static_cast<float>(sum[2] / static_cast<double>(count))};
+}
+
+VoxelStatsIndex & VoxelStatsIndex::singleton() {
+    static VoxelStatsIndex index;
+    return index;
+}
+
+VoxelStatsIndex::VoxelStatsIndex() {
+    editTimer.setSingleShot(true);
+    editTimer.setInterval(500);// a brush stroke marks its cubes many times
+    QObject::connect(&editTimer, &QTimer::timeout, this, &VoxelStatsIndex::rescanEdits);
+}
+
+/**
+ * @brief VoxelStatsIndex::scan collects the stats of all ids but 0 (background) in one cube,
+ *      runs of equal ids along x are accounted at once.
+ */
+VoxelStatsIndex::CubeStats VoxelStatsIndex::scan(const CoordOfCube & cubeCoord, const int cubeEdgeLen, const int mag, const std::uint64_t * cube) {
+    CubeStats result;
+    flat_id_map<std::size_t> position;// of the id in result
+    const auto origin = cubeCoord.cube2Global(cubeEdgeLen, mag);
+    std::uint64_t lastId = 0;
+    std::size_t last = 0;
+    for (int z = 0; z < cubeEdgeLen; ++z) {
+        const auto globalZ = origin.z + mag * z;
+        for (int y = 0; y < cubeEdgeLen; ++y) {
+            const auto globalY = origin.y + mag * y;
+            const auto * row = cube + (static_cast<std::size_t>(z) * cubeEdgeLen + y) * cubeEdgeLen;
+            for (int x = 0; x < cubeEdgeLen;) {
+                const auto id = row[x];
+                const auto first = x;
+                while (x < cubeEdgeLen && row[x] == id) {
+                    ++x;
+                }
+                if (id == 0) {
+                    continue;
+                }
+                if (id != lastId || result.empty()) {
+                    const auto * found = position.find(id);
+                    if (found == nullptr) {
+                        found = &position.emplace(id, result.size());
+                        result.emplace_back(id, VoxelStats{});
+                    }
+                    last = *found;
+                    lastId = id;
+                }
+                auto & stats = result[last].second;
+                const std::int64_t length = x - first;
+                stats.count += length;
+                stats.sum[0] += length * origin.x + mag * ((first + x - 1) * length / 2);// x positions form an arithmetic series
+                stats.sum[1] += length * globalY;
+                stats.sum[2] += length * globalZ;
+                stats.min = {std::min(stats.min.x, origin.x + mag * first), std::min(stats.min.y, globalY), std::min(stats.min.z, globalZ)};
+                stats.max = {std::max(stats.max.x, origin.x + mag * (x - 1)), std::max(stats.max.y, globalY), std::max(stats.max.z, globalZ)};
+            }
+        }
+    }
+    std::sort(std::begin(result), std::end(result), [](const auto & lhs, const auto & rhs){ return lhs.first < rhs.first; });
+    return result;
+}
+
+void VoxelStatsIndex::publishCube(const CoordOfCube & cubeCoord, const int cubeEdgeLen, const int mag, const std::uint64_t * cube) {
+    auto contribution = scan(cubeCoord, cubeEdgeLen, mag, cube);
+    const auto magIndex = int_log(mag);
+    {
+        QMutexLocker locker(&mutex);
+        if (mags.size() <= magIndex) {
+            mags.resize(magIndex + 1);
+        }
+        auto & magStats = mags[magIndex];
+        if (magStats.collapsedCubes.erase(cubeCoord) != 0) {// reloaded unchanged, it is already counted
+            if (!contribution.empty()) {
+                magStats.cubes.emplace(cubeCoord, std::move(contribution));
+            }
+            return;
+        }
+        auto it = magStats.cubes.find(cubeCoord);
+        if (it != std::end(magStats.cubes)) {
+            for (const auto & pair : it->second) {// withdraw the previous contribution
+                auto * entry = magStats.subobjects.find(pair.first);
+                if (entry == nullptr) {
+                    continue;
+                }
+                auto & stats = entry->stats;
+                stats.count -= pair.second.count;
+                if (stats.count == 0) {
+                    magStats.subobjects.erase(pair.first);
+                    continue;
+                }
+                for (std::size_t i = 0; i < stats.sum.size(); ++i) {
+                    stats.sum[i] -= pair.second.sum[i];
+                }
+                const auto & removed = pair.second;
+                entry->boundsStale = entry->boundsStale || removed.min.x == stats.min.x || removed.min.y == stats.min.y || removed.min.z == stats.min.z
+                        || removed.max.x == stats.max.x || removed.max.y == stats.max.y || removed.max.z == stats.max.z;
+            }
+            magStats.cubes.erase(it);
+        }
+        for (const auto & pair : contribution) {
+            auto * entry = magStats.subobjects.find(pair.first);
+            if (entry == nullptr) {
+                entry = &magStats.subobjects.emplace(pair.first, Entry{});
+            }
+            entry->stats.merge(pair.second);
+        }
+        if (!contribution.empty()) {
+            magStats.cubes.emplace(cubeCoord, std::move(contribution));
+        }
+    }
+    emit changed();
+}
+
+void VoxelStatsIndex::collapseCube(const std::size_t magIndex, const CoordOfCube & cubeCoord) {
+    QMutexLocker locker(&mutex);
+    if (magIndex >= mags.size()) {
+        return;
+    }
+    auto & magStats = mags[magIndex];
+    auto it = magStats.cubes.find(cubeCoord);
+    if (it == std::end(magStats.cubes)) {
+        return;
+    }
+    for (const auto & pair : it->second) {
+        if (auto * entry = magStats.subobjects.find(pair.first)) {
+            auto & collapsed = entry->collapsed;
+            collapsed.min = {std::min(collapsed.min.x, pair.second.min.x), std::min(collapsed.min.y, pair.second.min.y), std::min(collapsed.min.z, pair.second.min.z)};
+            collapsed.max = {std::max(collapsed.max.x, pair.second.max.x), std::max(collapsed.max.y, pair.second.max.y), std::max(collapsed.max.z, pair.second.max.z)};
+        }
+    }
+    magStats.cubes.erase(it);
+    magStats.collapsedCubes.emplace(cubeCoord);
+}
+
+/**
+ * @brief VoxelStatsIndex::uncollapseCube is needed when the content of a collapsed cube is replaced,
+ *      its stale counts cannot be withdrawn, so the totals are rebuilt from the contributions of the loaded cubes.
+ */
+void VoxelStatsIndex::uncollapseCube(const std::size_t magIndex, const CoordOfCube & cubeCoord) {
+    {
+        QMutexLocker locker(&mutex);
+        if (magIndex >= mags.size() || mags[magIndex].collapsedCubes.find(cubeCoord) == std::end(mags[magIndex].collapsedCubes)) {
+            return;
+        }
+        auto & magStats = mags[magIndex];
+        magStats.collapsedCubes.clear();
+        magStats.subobjects.clear();
+        for (const auto & cube : magStats.cubes) {
+            for (const auto & pair : cube.second) {
+                auto * entry = magStats.subobjects.find(pair.first);
+                if (entry == nullptr) {
+                    entry = &magStats.subobjects.emplace(pair.first, Entry{});
+                }
+                entry->stats.merge(pair.second);
+            }
+        }
+    }
+    emit changed();
+}
+
+void VoxelStatsIndex::cubeEdited(const CoordOfCube & cubeCoord, const int mag) {
+    const auto magIndex = int_log(mag);
+    if (!pendingEdits.empty() && magIndex != pendingMagIndex) {
+        rescanEdits();
+    }
+    pendingMagIndex = magIndex;
+    pendingEdits.emplace(cubeCoord);
+    editTimer.start();
+}
+
+void VoxelStatsIndex::rescanEdits() {
+    editTimer.stop();
+    {
+        VoxelCursor cursor;
+        if (cursor.magIndex == pendingMagIndex) {// edits of another magnification are rescanned when their cubes load again
+            for (const auto & cubeCoord : pendingEdits) {
+                if (const auto * cube = cursor.cube(cubeCoord)) {
+                    publishCube(cubeCoord, cursor.cubeEdgeLen, cursor.mag, cube);
+                }
+            }
+        }
+    }
+    pendingEdits.clear();
+}
+
+void VoxelStatsIndex::refreshBounds(const Mag & mag, const std::uint64_t subobjectId, Entry & entry) const {
+    VoxelStats bounds = entry.collapsed;
+    for (const auto & cube : mag.cubes) {
+        const auto it = std::lower_bound(std::begin(cube.second), std::end(cube.second), subobjectId, [](const auto & pair, const std::uint64_t id){ return pair.first < id; });
+        if (it != std::end(cube.second) && it->first == subobjectId) {
+            bounds.merge(it->second);
+        }
+    }
+    entry.stats.min = bounds.min;
+    entry.stats.max = bounds.max;
+    entry.boundsStale = false;
+}
+
+VoxelStats VoxelStatsIndex::subobject(const std::size_t magIndex, const std::uint64_t subobjectId) const {
+    QMutexLocker locker(&mutex);
+    if (magIndex >= mags.size()) {
+        return {};
+    }
+    auto * entry = mags[magIndex].subobjects.find(subobjectId);
+    if (entry == nullptr) {
+        return {};
+    }
+    if (entry->boundsStale) {
+        refreshBounds(mags[magIndex], subobjectId, *entry);
+    }
+    return entry->stats;
+}
+
+std::uint64_t VoxelStatsIndex::count(const std::size_t magIndex, const std::uint64_t subobjectId) const {
+    QMutexLocker locker(&mutex);
+    const auto * entry = magIndex < mags.size() ? mags[magIndex].subobjects.find(subobjectId) : nullptr;
+    return entry != nullptr ? entry->stats.count : 0;
+}
+
+std::vector<std::uint64_t> VoxelStatsIndex::counts(const std::size_t magIndex, const std::vector<std::uint64_t> & subobjectIds) const {
+    std::vector<std::uint64_t> result(subobjectIds.size(), 0);
+    QMutexLocker locker(&mutex);
+    if (magIndex < mags.size()) {
+        const auto & subobjects = mags[magIndex].subobjects;
+        for (std::size_t i = 0; i < subobjectIds.size(); ++i) {
+            if (const auto * entry = subobjects.find(subobjectIds[i])) {
+                result[i] = entry->stats.count;
+            }
+        }
+    }
+    return result;
+}
+
+void VoxelStatsIndex::clear() {
+    editTimer.stop();
+    pendingEdits.clear();
+    {
+        QMutexLocker locker(&mutex);
+        mags.clear();
+    }
+    emit changed();
+}
@@ -0,0 +1,108 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef VOXELSTATS_H
+#define VOXELSTATS_H
+
+#include "coordinate.h"
+#include "flat_id_map.h"
+
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * Voxel count, bounding box and coordinate sum of one id, coordinates are global (mag 1).
+ */
+struct VoxelStats {
+    std::uint64_t count{0};
+    std::array<std::int64_t, 3> sum{{0, 0, 0}};// for the centroid
+    Coordinate min{std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+    Coordinate max{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+
+    bool empty() const {
+        return count == 0;
+    }
+    void merge(const VoxelStats & other);
+    floatCoordinate centroid() const;
+};
+
+/**
+ * @brief The VoxelStatsIndex class keeps VoxelStats for every subobject id found in the overlay cubes.
+ *      Each cube is scanned once when it is published by the loader and again after it was edited,
+ *      its contribution replaces the previous one of the same cube, so the totals cover every cube seen so far
+ *      and are not lowered when cubes are unloaded.
+ *      Counts are per magnification, removing a cube’s contribution may leave a bounding box too large,
+ *      it is recomputed from the remaining contributions when it is queried.
+ *      Contributions (about 64 B per id and cube) are only kept for loaded and modified cubes.
+ *      Unmodified cubes are collapsed on unload, they load with the same content again,
+ *      so only their coordinate is remembered and their bounds are folded into collapsed bounds per id, which never shrink.
+ */
+class VoxelStatsIndex : public QObject {
+    Q_OBJECT
+    using CubeStats = std::vector<std::pair<std::uint64_t, VoxelStats>>;// sorted by id
+    struct Entry {
+        VoxelStats stats;
+        VoxelStats collapsed;// only the bounds of collapsed cubes
+        bool boundsStale{false};
+    };
+    struct Mag {
+        std::unordered_map<CoordOfCube, CubeStats> cubes;
+        std::unordered_set<CoordOfCube> collapsedCubes;// counted in the totals without a contribution
+        flat_id_map<Entry> subobjects;
+    };
+    mutable QMutex mutex;
+    mutable std::vector<Mag> mags;// by mag index
+    std::unordered_set<CoordOfCube> pendingEdits;
+    std::size_t pendingMagIndex{0};
+    QTimer editTimer;
+
+    static CubeStats scan(const CoordOfCube & cubeCoord, const int cubeEdgeLen, const int mag, const std::uint64_t * cube);
+    void refreshBounds(const Mag & mag, const std::uint64_t subobjectId, Entry & entry) const;
+    void rescanEdits();
+public:
+    static VoxelStatsIndex & singleton();
+
+    VoxelStatsIndex();
+    void publishCube(const CoordOfCube & cubeCoord, const int cubeEdgeLen, const int mag, const std::uint64_t * cube);// any thread, cube must not be written meanwhile
+    void cubeEdited(const CoordOfCube & cubeCoord, const int mag);// gui thread, edits are rescanned once they settle
+    void collapseCube(const std::size_t magIndex, const CoordOfCube & cubeCoord);// any thread, for unmodified cubes being unloaded
+    void uncollapseCube(const std::size_t magIndex, const CoordOfCube & cubeCoord);// any thread, before the content of an unloaded cube is replaced
+    VoxelStats subobject(const std::size_t magIndex, const std::uint64_t subobjectId) const;
+    std::uint64_t count(const std::size_t magIndex, const std::uint64_t subobjectId) const;
+    std::vector<std::uint64_t> counts(const std::size_t magIndex, const std::vector<std::uint64_t> & subobjectIds) const;// under one lock
+signals:
+    void changed();
+public slots:
+    void clear();
+};
+
+#endif//VOXELSTATS_H
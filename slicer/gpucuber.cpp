@@ -23,9 +23,20 @@
 #include "gpucuber.h"
 
 #include "segmentation/segmentation.h"
+#include "stateInfo.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLPixelTransferOptions>
 
 #include <boost/multi_array.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <tuple>
+
 gpu_raw_cube::gpu_raw_cube(const int gpucubeedge, const bool index) {
     cube.setAutoMipMapGenerationEnabled(false);
     cube.setSize(gpucubeedge, gpucubeedge, gpucubeedge);
@@ -37,71 +48,133 @@ gpu_raw_cube::gpu_raw_cube(const int gpucubeedge, const bool index) {
     cube.allocateStorage();
 }
 
-std::vector<char> gpu_raw_cube::prepare(boost::multi_array_ref<uint8_t, 3>::const_array_view<3>::type view) {
-    std::vector<char> data;
-    for (const auto & d2 : view)
-    for (const auto & d1 : d2)
-    for (const auto & elem : d1) {
-        data.emplace_back(elem);
+void gpu_raw_cube::upload(const std::uint8_t * data, const int cpucubeedge, const Coordinate offset) {
+    // the gpu cube is read in place from the cpu cube, the unpack strides skip the rest of it
+    QOpenGLPixelTransferOptions options;
+    options.setAlignment(1);
+    options.setRowLength(cpucubeedge);
+    options.setImageHeight(cpucubeedge);
+    options.setSkipPixels(offset.x);
+    options.setSkipRows(offset.y);
+    options.setSkipImages(offset.z);
+    cube.setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, data, &options);
+}
+
+static std::array<std::uint8_t, 4> lutColor(const std::uint64_t subobjectId) {
+    const auto color = Segmentation::singleton().colorObjectFromSubobjectId(subobjectId);
+    return {{std::get<0>(color), std::get<1>(color), std::get<2>(color), std::get<3>(color)}};
+}
+
+gpu_lut::gpu_lut() {
+    clear();
+}
+
+void gpu_lut::setupTexture() {
+    texture.setAutoMipMapGenerationEnabled(false);
+    texture.setMipLevels(1);
+    texture.setMinificationFilter(QOpenGLTexture::Nearest);
+    texture.setMagnificationFilter(QOpenGLTexture::Nearest);
+    texture.setFormat(QOpenGLTexture::RGBA8_UNorm);
+}
+
+void gpu_lut::limitCapacity(const std::size_t maxTextureSize) {
+    QMutexLocker locker(&mutex);
+    capacity = std::min(capacity, maxTextureSize);// many drivers allow only 16384 texels
+}
+
+bool gpu_lut::nearlyFull() {
+    QMutexLocker locker(&mutex);
+    return ids.size() > 3 * (capacity / 4);
+}
+
+gpu_lut::gpu_index gpu_lut::index(const std::uint64_t subobjectId) {
+    const auto it = id_to_lut_index.find(subobjectId);
+    if (it != std::end(id_to_lut_index)) {
+        return it->second;
+    } else if (ids.size() >= capacity) {
+        return 0;
     }
-    return data;
+    const gpu_index index = ids.size();
+    id_to_lut_index.emplace(subobjectId, index);
+    ids.emplace_back(subobjectId);
+    if (colors.size() < ids.size()) {
+        colors.resize(std::min(2 * colors.size(), capacity));
+    }
+    dirty = true;
+    return index;
 }
 
-void gpu_raw_cube::upload(const std::vector<char> & data) {
-    cube.setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, data.data());
+void gpu_lut::recolor() {
+    QMutexLocker locker(&mutex);
+    colored = 1;
+    dirty = true;
 }
 
-void gpu_raw_cube::generate(boost::multi_array_ref<uint8_t, 3>::const_array_view<3>::type view) {
-    upload(prepare(view));
+void gpu_lut::recolor(const std::vector<std::uint64_t> & subobjectIds) {
+    QMutexLocker locker(&mutex);
+    for (const auto subobjectId : subobjectIds) {
+        const auto it = id_to_lut_index.find(subobjectId);
+        if (it != std::end(id_to_lut_index) && it->second < colored) {
+            colors[it->second] = lutColor(subobjectId);
+            dirty = true;
+        }
+    }
 }
 
-gpu_lut_cube::gpu_lut_cube(const int gpucubeedge) : gpu_raw_cube(gpucubeedge, true) {
-    lut.setAutoMipMapGenerationEnabled(false);
-    lut.setMipLevels(1);
-    lut.setMinificationFilter(QOpenGLTexture::Nearest);
-    lut.setMagnificationFilter(QOpenGLTexture::Nearest);
-    lut.setFormat(QOpenGLTexture::RGBA8_UNorm);
+void gpu_lut::clear() {
+    QMutexLocker locker(&mutex);
+    id_to_lut_index.clear();
+    ids = {0};// placeholder for the transparent overflow index
+    colors = decltype(colors)(256);
+    colored = 1;
+    dirty = true;
+    ++generation;
 }
 
+void gpu_lut::upload() {
+    QMutexLocker locker(&mutex);
+    for (; colored < ids.size(); ++colored) {// Segmentation is only accessed from the gui thread
+        colors[colored] = lutColor(ids[colored]);
+    }
+    if (!dirty) {
+        return;
+    }
+    if (!texture.isStorageAllocated() || texture.width() != static_cast<int>(colors.size())) {
+        texture.destroy();// allocated storage cannot be resized
+        setupTexture();
+        texture.setSize(colors.size());
+        texture.allocateStorage();
+    }
+    texture.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt32_RGBA8_Rev, colors.data());
+    dirty = false;
+}
+
+gpu_lut_cube::gpu_lut_cube(const int gpucubeedge, gpu_lut & lut) : gpu_raw_cube(gpucubeedge, true), lut(lut) {}
+
 std::vector<gpu_lut_cube::gpu_index> gpu_lut_cube::prepare(boost::multi_array_ref<uint64_t, 3>::const_array_view<3>::type view) {
     bool lastValid{false};
     uint64_t lastElem{0};
-    uint64_t lastIndex{0};
-    std::array<std::uint8_t, 4> lastColor{{}};
+    gpu_index lastIndex{0};
 
+    QMutexLocker locker(&lut.mutex);
+    lutGeneration = lut.generation;
     std::vector<gpu_index> data;
+    data.reserve(view.num_elements());
     for (const auto & d2 : view)
     for (const auto & d1 : d2)
     for (const auto & elem : d1) {
-        if (lastValid && elem == lastElem) {
-            data.emplace_back(lastIndex);
-        } else {
-            const auto it = id_to_lut_index.find(elem);
-            const auto existing = it != std::end(id_to_lut_index);
-            const auto index = existing ? it->second : (id_to_lut_index[elem] = highest_index++);//increment after assignment
-            data.emplace_back(index);
-            if (!existing) {
-                const auto color = Segmentation::singleton().colorObjectFromSubobjectId(elem);
-                lastColor = {{std::get<0>(color), std::get<1>(color), std::get<2>(color), std::get<3>(color)}};
-                colors.push_back(lastColor);
-            }
+        if (!lastValid || elem != lastElem) {
+            lastIndex = lut.index(elem);
             lastElem = elem;
-            lastIndex = index;
-            lastColor = colors[index];
             lastValid = true;
         }
+        data.emplace_back(lastIndex);
     }
-    const auto lutSize = std::pow(2, std::ceil(std::log2(colors.size())));
-    colors.resize(lutSize);
     return data;
 }
 
 void gpu_lut_cube::upload(const std::vector<gpu_index> & data) {
-    lut.setSize(colors.size());
-    lut.allocateStorage();
-
     cube.setData(QOpenGLTexture::Red, QOpenGLTexture::UInt16, data.data());
-    lut.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt32_RGBA8_Rev, colors.data());
 }
 
 void gpu_lut_cube::generate(boost::multi_array_ref<uint64_t, 3>::const_array_view<3>::type view) {
@@ -115,44 +188,200 @@ TextureLayer::TextureLayer(QOpenGLContext & sharectx) {
     ctx.create();
 }
 TextureLayer::~TextureLayer() {
+    {
+        QMutexLocker locker(&streamMutex);
+        quitStreaming = true;
+        streamCondition.wakeOne();
+    }
+    streamer.wait();
     ctx.makeCurrent(&surface);//QOpenGLTexture dtor needs a current ctx
 }
 
-template<typename cube_type, typename elem_type>
-void TextureLayer::createBogusCube(const int cpucubeedge, const int gpucubeedge) {
-    ctx.makeCurrent(&surface);
-    std::vector<char> data;
-    data.resize(std::pow(cpucubeedge, 3) * sizeof(elem_type));
-    std::fill(std::begin(data), std::end(data), 0);
-    bogusCube.reset(new cube_type(gpucubeedge));
-    boost::multi_array_ref<elem_type, 3> cube(reinterpret_cast<elem_type*>(data.data()), boost::extents[cpucubeedge][cpucubeedge][cpucubeedge]);
-    using range = boost::multi_array_types::index_range;
-    static_cast<cube_type*>(bogusCube.get())->generate(cube[boost::indices[range(0,gpucubeedge)][range(cpucubeedge-gpucubeedge,cpucubeedge-0)][range(0,gpucubeedge)]]);
+void GpuCubeStreamer::run() {
+    layer.stream();
 }
 
-void TextureLayer::createBogusCube(const int cpucubeedge, const int gpucubeedge) {
-    if (isOverlayData) {
-        createBogusCube<gpu_lut_cube, std::uint64_t>(cpucubeedge, gpucubeedge);
+std::unique_ptr<gpu_raw_cube> TextureLayer::pooledCube() {
+    QMutexLocker locker(&streamMutex);
+    if (texturePool.empty()) {
+        return isOverlayData ? std::unique_ptr<gpu_raw_cube>(new gpu_lut_cube(gpucubeedge, lut)) : std::unique_ptr<gpu_raw_cube>(new gpu_raw_cube(gpucubeedge));
+    }
+    auto texture = std::move(texturePool.back());
+    texturePool.pop_back();
+    texture->reset();
+    return texture;
+}
+
+void TextureLayer::upload(gpu_raw_cube & texture, const void * data, const Coordinate offset) {
+    if (isOverlayData) {// ids are translated into lut indices
+        boost::const_multi_array_ref<std::uint64_t, 3> cube(reinterpret_cast<const std::uint64_t *>(data), boost::extents[cpucubeedge][cpucubeedge][cpucubeedge]);
+        using range = boost::multi_array_types::index_range;
+        const auto view = cube[boost::indices[range(0+offset.z,gpucubeedge+offset.z)][range(0+offset.y,gpucubeedge+offset.y)][range(0+offset.x,gpucubeedge+offset.x)]];
+        static_cast<gpu_lut_cube &>(texture).generate(view);
     } else {
-        createBogusCube<gpu_raw_cube, std::uint8_t>(cpucubeedge, gpucubeedge);
+        texture.upload(reinterpret_cast<const std::uint8_t *>(data), cpucubeedge, offset);
     }
 }
 
-template<typename cube_type, typename elem_type>
-void TextureLayer::cubeSubArray(const boost::const_multi_array_ref<elem_type, 3> cube, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset) {
+void TextureLayer::createBogusCube(const int cpucubeedge, const int gpucubeedge) {
+    this->cpucubeedge = cpucubeedge;
+    this->gpucubeedge = gpucubeedge;
     ctx.makeCurrent(&surface);
-    using range = boost::multi_array_types::index_range;
-    const auto view = cube[boost::indices[range(0+offset.z,gpucubeedge+offset.z)][range(0+offset.y,gpucubeedge+offset.y)][range(0+offset.x,gpucubeedge+offset.x)]];
-    textures[gpuCoord].reset(new cube_type(gpucubeedge));
-    static_cast<cube_type*>(textures[gpuCoord].get())->generate(view);
+    GLint maxTextureSize = 0;
+    ctx.functions()->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (maxTextureSize > 0) {
+        lut.limitCapacity(maxTextureSize);
+    }
+    const std::vector<std::uint64_t> data(std::pow(cpucubeedge, 3), 0);// large enough for either layer type
+    bogusCube = pooledCube();
+    upload(*bogusCube, data.data(), {0, cpucubeedge - gpucubeedge, 0});
 }
 
-void TextureLayer::cubeSubArray(const void * data, const int cpucubeedge, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset) {
-    if (isOverlayData) {
-        boost::const_multi_array_ref<std::uint64_t, 3> cube(reinterpret_cast<const std::uint64_t *>(data), boost::extents[cpucubeedge][cpucubeedge][cpucubeedge]);
-        cubeSubArray<gpu_lut_cube>(cube, gpucubeedge, gpuCoord, offset);
-    } else {
-        boost::const_multi_array_ref<std::uint8_t, 3> cube(reinterpret_cast<const std::uint8_t *>(data), boost::extents[cpucubeedge][cpucubeedge][cpucubeedge]);
-        cubeSubArray<gpu_raw_cube>(cube, gpucubeedge, gpuCoord, offset);
+void TextureLayer::preallocate(const std::size_t count) {
+    ctx.makeCurrent(&surface);
+    QMutexLocker locker(&streamMutex);
+    while (textures.size() + texturePool.size() < count) {
+        texturePool.emplace_back(isOverlayData ? static_cast<gpu_raw_cube *>(new gpu_lut_cube(gpucubeedge, lut)) : new gpu_raw_cube(gpucubeedge));
+    }
+}
+
+void TextureLayer::adopt(const CoordOfGPUCube & gpuCoord, std::unique_ptr<gpu_raw_cube> texture) {
+    textures[gpuCoord] = std::move(texture);
+    ++texturesRevision;
+}
+
+void TextureLayer::recycle(const CoordOfGPUCube & gpuCoord) {
+    auto it = textures.find(gpuCoord);
+    if (it != std::end(textures)) {
+        recycle(std::move(it->second));
+        textures.erase(it);
+        ++texturesRevision;
+    }
+}
+
+void TextureLayer::recycle(std::unique_ptr<gpu_raw_cube> texture) {
+    QMutexLocker locker(&streamMutex);
+    texturePool.emplace_back(std::move(texture));
+}
+
+/**
+ * @brief TextureLayer::startStreaming hands the context over to the streaming thread,
+ * no context of this layer is current in the calling thread afterwards.
+ */
+void TextureLayer::startStreaming() {
+    ctx.doneCurrent();
+    ctx.moveToThread(&streamer);
+    streamer.setObjectName(isOverlayData ? "GPU overlay streaming" : "GPU raw streaming");
+    streamer.start();
+}
+
+static bool streamedLater(const TextureLayer::CubeRequest & lhs, const TextureLayer::CubeRequest & rhs) {
+    return std::make_tuple(!lhs.onPlane, lhs.distance) > std::make_tuple(!rhs.onPlane, rhs.distance);
+}
+
+/**
+ * @brief TextureLayer::request replaces the cubes that are still waiting to be streamed.
+ */
+void TextureLayer::request(std::vector<CubeRequest> cubes) {
+    QMutexLocker locker(&streamMutex);
+    cubes.erase(std::remove_if(std::begin(cubes), std::end(cubes), [this](const CubeRequest & request){
+        return streamingCubes.count(request.gpuCoord) != 0 || missingCubes.count(request.gpuCoord) != 0;
+    }), std::end(cubes));
+    requestedCubes = std::move(cubes);
+    std::make_heap(std::begin(requestedCubes), std::end(requestedCubes), streamedLater);
+    streamCondition.wakeOne();
+}
+
+void TextureLayer::cancelRequests(const std::function<bool(const CubeRequest &)> & obsolete) {
+    QMutexLocker locker(&streamMutex);
+    requestedCubes.erase(std::remove_if(std::begin(requestedCubes), std::end(requestedCubes), obsolete), std::end(requestedCubes));
+    std::make_heap(std::begin(requestedCubes), std::end(requestedCubes), streamedLater);
+}
+
+/**
+ * @brief TextureLayer::retryMissingCubes lets cubes whose cpu cube was missing be requested again once cpu cubes have arrived,
+ *      so cubes at dataset borders or without data don’t keep the streaming busy.
+ */
+void TextureLayer::retryMissingCubes(const std::size_t cpuCubeArrivals) {
+    QMutexLocker locker(&streamMutex);
+    if (cpuCubeArrivals != retriedArrivals) {
+        retriedArrivals = cpuCubeArrivals;
+        missingCubes.clear();
+    }
+}
+
+/**
+ * @brief TextureLayer::takeStreamedCubes returns the cubes whose upload has completed since the last call.
+ */
+std::vector<TextureLayer::StreamedCube> TextureLayer::takeStreamedCubes() {
+    QMutexLocker locker(&streamMutex);
+    for (const auto & cube : streamedCubes) {
+        streamingCubes.erase(cube.first);
+    }
+    auto cubes = std::move(streamedCubes);
+    streamedCubes.clear();
+    return cubes;
+}
+
+bool TextureLayer::isStreaming() {
+    QMutexLocker locker(&streamMutex);
+    return !requestedCubes.empty() || !streamingCubes.empty();
+}
+
+void TextureLayer::stream() {
+    ctx.makeCurrent(&surface);
+    auto & gl = *ctx.extraFunctions();
+    const bool syncSupported = ctx.format().version() >= qMakePair(3, 2) || ctx.hasExtension("GL_ARB_sync");
+    const std::size_t batchSize = 8;// cubes per fence
+
+    QMutexLocker locker(&streamMutex);
+    while (!quitStreaming) {
+        if (requestedCubes.empty()) {
+            streamCondition.wait(&streamMutex);
+            continue;
+        }
+        std::vector<CubeRequest> batch;
+        const auto batchArrivals = retriedArrivals;
+        while (!requestedCubes.empty() && batch.size() < batchSize) {
+            std::pop_heap(std::begin(requestedCubes), std::end(requestedCubes), streamedLater);
+            batch.emplace_back(requestedCubes.back());
+            requestedCubes.pop_back();
+            streamingCubes.emplace(batch.back().gpuCoord);
+        }
+        locker.unlock();
+
+        std::vector<StreamedCube> uploaded;
+        for (const auto & request : batch) {
+            state->protectCube2Pointer.lock();
+            const auto * ptr = Coordinate2BytePtr_hash_get_or_fail((isOverlayData ? state->Oc2Pointer : state->Dc2Pointer)[request.magIndex], request.cubeCoord);
+            state->protectCube2Pointer.unlock();
+            if (ptr != nullptr) {
+                auto texture = pooledCube();
+                upload(*texture, ptr, request.offset);
+                uploaded.emplace_back(request.gpuCoord, std::move(texture));
+            }
+        }
+        // only hand over textures the gpu has finished uploading
+        if (syncSupported) {
+            const auto fence = gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            while (gl.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000 * 1000) == GL_TIMEOUT_EXPIRED);
+            gl.glDeleteSync(fence);
+        } else {
+            gl.glFinish();
+        }
+
+        locker.relock();
+        for (const auto & request : batch) {// missing cpu cubes wait for the next arrival, unless one happened meanwhile
+            if (std::find_if(std::begin(uploaded), std::end(uploaded), [&request](const StreamedCube & cube){ return cube.first == request.gpuCoord; }) == std::end(uploaded)) {
+                streamingCubes.erase(request.gpuCoord);
+                if (retriedArrivals == batchArrivals) {
+                    missingCubes.emplace(request.gpuCoord);
+                }
+            }
+        }
+        std::move(std::begin(uploaded), std::end(uploaded), std::back_inserter(streamedCubes));
     }
+    locker.unlock();
+    ctx.doneCurrent();
+    ctx.moveToThread(QCoreApplication::instance()->thread());// for the textures’ destruction
 }
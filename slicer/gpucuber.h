@@ -25,18 +25,25 @@
 
 #include "coordinate.h"
 
+#include <QMutex>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
 #include <QOpenGLTexture>
+#include <QThread>
 #include <QVector3D>
+#include <QWaitCondition>
 
 #include <boost/functional/hash.hpp>
 #include <boost/multi_array/multi_array_ref.hpp>
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace std {
@@ -54,32 +61,97 @@ public:
     std::vector<floatCoordinate> vertices;
     gpu_raw_cube(const int gpucubeedge, const bool index = false);
     virtual ~gpu_raw_cube() {}
-    std::vector<char> prepare(boost::multi_array_ref<std::uint8_t, 3>::const_array_view<3>::type view);
-    void upload(const std::vector<char> & data);
-    void generate(boost::multi_array_ref<std::uint8_t, 3>::const_array_view<3>::type view);
+    virtual void reset() { vertices.clear(); }
+    void upload(const std::uint8_t * data, const int cpucubeedge, const Coordinate offset);
 };
 
-class gpu_lut_cube : public gpu_raw_cube {
+/**
+ * @brief The gpu_lut class maps subobject ids to the indices stored in the overlay gpu cubes
+ * and holds the colors of all indices in one texture shared by all cubes of the layer.
+ * Color changes only update the table, the index textures of the cubes stay valid.
+ * Index 0 is transparent and used for ids which do not fit anymore until the table is cleared.
+ * Indices are added by the streaming thread, colors are assigned in the gui thread on upload.
+ */
+class gpu_lut {
 public:
     using gpu_index = std::uint16_t;
 private:
     std::unordered_map<std::uint64_t, gpu_index> id_to_lut_index;
-    gpu_index highest_index = 0;
-    std::vector<std::array<std::uint8_t, 4>> colors;
+    std::vector<std::uint64_t> ids;// lut index → subobject id
+    std::vector<std::array<std::uint8_t, 4>> colors;// padded to the texture size
+    std::size_t colored{1};// indices below have their current color
+    std::size_t capacity{std::size_t{std::numeric_limits<gpu_index>::max()} + 1};// texels, at most GL_MAX_TEXTURE_SIZE
+    bool dirty{true};
+    void setupTexture();
 public:
-    QOpenGLTexture lut{QOpenGLTexture::Target1D};
-    gpu_lut_cube(const int gpucubeedge);
+    QMutex mutex;
+    std::atomic<std::size_t> generation{0};// incremented by clear, cubes of older generations are invalid
+    QOpenGLTexture texture{QOpenGLTexture::Target1D};
+    gpu_lut();
+    void limitCapacity(const std::size_t maxTextureSize);
+    bool nearlyFull();
+    gpu_index index(const std::uint64_t subobjectId);// mutex has to be held
+    void recolor();
+    void recolor(const std::vector<std::uint64_t> & subobjectIds);
+    void clear();
+    void upload();
+};
+
+class gpu_lut_cube : public gpu_raw_cube {
+    gpu_lut & lut;
+public:
+    using gpu_index = gpu_lut::gpu_index;
+    std::size_t lutGeneration{0};
+    gpu_lut_cube(const int gpucubeedge, gpu_lut & lut);
     std::vector<gpu_index> prepare(boost::multi_array_ref<uint64_t, 3>::const_array_view<3>::type view);
     void upload(const std::vector<gpu_index> & data);
     void generate(boost::multi_array_ref<std::uint64_t, 3>::const_array_view<3>::type view);
 };
 
+class TextureLayer;
+/**
+ * @brief The GpuCubeStreamer thread prepares and uploads the requested cubes of a layer in the layer’s context.
+ */
+class GpuCubeStreamer : public QThread {
+    TextureLayer & layer;
+public:
+    explicit GpuCubeStreamer(TextureLayer & layer) : layer(layer) {}
+    void run() override;
+};
+
 class TextureLayer {
+    friend class GpuCubeStreamer;
+public:
+    struct CubeRequest {
+        CoordOfGPUCube gpuCoord;
+        CoordOfCube cubeCoord;
+        Coordinate offset;
+        std::size_t magIndex;
+        bool onPlane;// intersects a visible slice plane
+        float distance;// squared, from the current position to the cube center
+    };
+    using StreamedCube = std::pair<CoordOfGPUCube, std::unique_ptr<gpu_raw_cube>>;
+private:
+    int cpucubeedge{0};
+    int gpucubeedge{0};
+    GpuCubeStreamer streamer{*this};
+    QMutex streamMutex;// guards the members below and the texture pool
+    QWaitCondition streamCondition;
+    bool quitStreaming{false};
+    std::vector<CubeRequest> requestedCubes;// heap, cubes on a visible plane and close to the current position first
+    std::unordered_set<CoordOfGPUCube> streamingCubes;// being uploaded or uploaded but not yet taken
+    std::unordered_set<CoordOfGPUCube> missingCubes;// their cpu cube was not loaded, they are not requested until retryMissingCubes
+    std::size_t retriedArrivals{0};
+    std::vector<StreamedCube> streamedCubes;
+    void stream();
 public:
     QOffscreenSurface surface;
-    QOpenGLContext ctx;//ctx has to live past textures
+    QOpenGLContext ctx;//ctx has to live past textures, owned by the streaming thread once started
+    gpu_lut lut;// shared by the cubes of an overlay layer
     std::unordered_map<CoordOfGPUCube, std::unique_ptr<gpu_raw_cube>> textures;
+    std::size_t texturesRevision{0};// changes with the textures or their arb vertices
     std::unique_ptr<gpu_raw_cube> bogusCube;
+    std::vector<std::unique_ptr<gpu_raw_cube>> texturePool;// allocated textures of cubes that left the visible area
     float opacity = 1.0f;
     bool enabled = true;
     bool isOverlayData = false;
@@ -87,12 +159,19 @@ public:
     std::vector<std::pair<CoordOfGPUCube, Coordinate>> pendingArbCubes;
     TextureLayer(QOpenGLContext & sharectx);
     ~TextureLayer();
-    template<typename cube_type, typename elem_type>
-    void createBogusCube(const int cpucubeedge, const int gpucubeedge);
+    std::unique_ptr<gpu_raw_cube> pooledCube();
+    void upload(gpu_raw_cube & texture, const void * data, const Coordinate offset);
     void createBogusCube(const int cpucubeedge, const int gpucubeedge);
-    template<typename cube_type, typename elem_type>
-    void cubeSubArray(const boost::const_multi_array_ref<elem_type, 3> cube, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset);
-    void cubeSubArray(const void * data, const int cpucubeedge, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset);
+    void preallocate(const std::size_t count);
+    void adopt(const CoordOfGPUCube & gpuCoord, std::unique_ptr<gpu_raw_cube> texture);
+    void recycle(const CoordOfGPUCube & gpuCoord);
+    void recycle(std::unique_ptr<gpu_raw_cube> texture);
+    void startStreaming();
+    void request(std::vector<CubeRequest> cubes);
+    void cancelRequests(const std::function<bool(const CubeRequest &)> & obsolete);
+    void retryMissingCubes(const std::size_t cpuCubeArrivals);
+    std::vector<StreamedCube> takeStreamedCubes();
+    bool isStreaming();
 };
 
 #endif//GPUCUBER_H
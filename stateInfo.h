@@ -31,6 +31,8 @@
 #include <QString>
 #include <QWaitCondition>
 
+#include <unordered_map>
+
 class stateInfo;
 extern stateInfo * state;
 
@@ -97,6 +99,11 @@ public:
     // this structure.
     coord2bytep_map_t Dc2Pointer[int_log(NUM_MAG_DATASETS)+1];
     coord2bytep_map_t Oc2Pointer[int_log(NUM_MAG_DATASETS)+1];
+    // Optional transposed copies of raw cubes from Dc2Pointer for cache friendly zy and xz slicing,
+    // each holds the zy layout followed by the xz layout (see transposeRawCube).
+    coord2bytep_map_t DcTransposed2Pointer[int_log(NUM_MAG_DATASETS)+1];
+    // Pin counts of overlay cubes in use by a VoxelCursor or an open edit of the EditJournal, the loader keeps them while they are pinned.
+    std::unordered_map<CoordOfCube, int> OcPinned[int_log(NUM_MAG_DATASETS)+1];
 
     struct ViewerState * viewerState;
     class MainWindow * mainWindow{nullptr};
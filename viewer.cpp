@@ -25,6 +25,7 @@
 #include "file_io.h"
 #include "functions.h"
 #include "loader.h"
+#include "profiler.h"
 #include "segmentation/segmentation.h"
 #include "session.h"
 #include "skeleton/skeletonizer.h"
@@ -36,10 +37,19 @@
 #include <QApplication>
 #include <QDebug>
 #include <QDesktopWidget>
+#include <QMutexLocker>
+#include <QScreen>
+#include <QThread>
 #include <QVector3D>
+#include <QWindow>
+#include <QtConcurrentMap>
 
-#include <fstream>
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <fstream>
+#include <numeric>
+#include <unordered_set>
 
 ViewerState::ViewerState() {
     state->viewerState = this;
@@ -54,7 +64,9 @@ Viewer::Viewer() : evilHack{[this](){ state->viewer = this; return true; }()} {
 
     rewire();
 
-    QObject::connect(&timer, &QTimer::timeout, this, &Viewer::run);// timer is started in main
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, this, &Viewer::run);// first frame is requested in main
+    qApp->installEventFilter(this);// input anywhere may change what is displayed
 
     QObject::connect(&Segmentation::singleton(), &Segmentation::appendedRow, this, &Viewer::oc_reslice_notify_visible);
     QObject::connect(&Segmentation::singleton(), &Segmentation::changedRow, this, &Viewer::oc_reslice_notify_visible);
@@ -63,13 +75,118 @@ Viewer::Viewer() : evilHack{[this](){ state->viewer = this; return true; }()} {
     QObject::connect(&Segmentation::singleton(), &Segmentation::resetData, this, &Viewer::oc_reslice_notify_visible);
     QObject::connect(&Segmentation::singleton(), &Segmentation::resetSelection, this, &Viewer::oc_reslice_notify_visible);
     QObject::connect(&Segmentation::singleton(), &Segmentation::renderOnlySelectedObjsChanged, this, &Viewer::oc_reslice_notify_visible);
+    // the gpu overlay cubes keep their indices, only the colors in the shared lut are updated
+    const auto recolorGpuLut = [this]() {
+        for (auto & layer : layers) {
+            if (layer.isOverlayData) {
+                layer.lut.recolor();
+            }
+        }
+    };
+    const auto recolorGpuLutObject = [this, recolorGpuLut](const int index) {
+        if (Segmentation::singleton().renderOnlySelectedObjs) {
+            recolorGpuLut();// (de)selection may change the visibility of all subobjects
+            return;
+        }
+        const auto subobjectIds = Segmentation::singleton().subobjectIdsOfObject(index);
+        for (auto & layer : layers) {
+            if (layer.isOverlayData) {
+                layer.lut.recolor(subobjectIds);
+            }
+        }
+    };
+    QObject::connect(&Segmentation::singleton(), &Segmentation::appendedRow, this, recolorGpuLut);
+    QObject::connect(&Segmentation::singleton(), &Segmentation::changedRow, this, recolorGpuLutObject);
+    QObject::connect(&Segmentation::singleton(), &Segmentation::changedRowSelection, this, recolorGpuLutObject);
+    QObject::connect(&Segmentation::singleton(), &Segmentation::removedRow, this, recolorGpuLut);
+    QObject::connect(&Segmentation::singleton(), &Segmentation::resetData, this, recolorGpuLut);
+    QObject::connect(&Segmentation::singleton(), &Segmentation::resetSelection, this, recolorGpuLut);
+    QObject::connect(&Segmentation::singleton(), &Segmentation::renderOnlySelectedObjsChanged, this, recolorGpuLut);
+    QObject::connect(&Segmentation::singleton(), &Segmentation::backgroundIdChanged, this, recolorGpuLut);
 
     QObject::connect(&Session::singleton(), &Session::movementAreaChanged, this, &Viewer::updateCurrentPosition);
     QObject::connect(&Session::singleton(), &Session::movementAreaChanged, this, &Viewer::dc_reslice_notify_visible);
     QObject::connect(&Session::singleton(), &Session::movementAreaChanged, this, &Viewer::oc_reslice_notify_visible);
     QObject::connect(this, &Viewer::movementAreaFactorChangedSignal, this, &Viewer::dc_reslice_notify_visible);
 
+    QObject::connect(this, &Viewer::coordinateChangedSignal, this, &Viewer::requestFrame);
+    QObject::connect(this, &Viewer::coordinateChangedSignal, [this]() { movedSinceLastFrame = true; });
+    QObject::connect(this, &Viewer::zoomChanged, [this]() { movedSinceLastFrame = true; });
+    QObject::connect(this, &Viewer::zoomChanged, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::nodeAddedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::nodeChangedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::nodeRemovedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::treeAddedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::treeChangedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::treeRemovedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::nodeSelectionChangedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::treeSelectionChangedSignal, this, &Viewer::requestFrame);
+    QObject::connect(skeletonizer, &Skeletonizer::resetData, this, &Viewer::requestFrame);
+
     keyRepeatTimer.start();
+    frameTimer.start();
+}
+
+bool Viewer::eventFilter(QObject * watched, QEvent * event) {
+    switch (event->type()) {
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseMove:
+    case QEvent::TabletMove:
+    case QEvent::TabletPress:
+    case QEvent::TabletRelease:
+    case QEvent::Wheel:
+    case QEvent::Resize:
+    case QEvent::Show:
+    case QEvent::WindowActivate:
+    case QEvent::WindowDeactivate:
+        requestFrame();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+/**
+ * @brief Viewer::frameDelay time until the next frame may be rendered.
+ * Frames are paced to the refresh rate of the screen the main window is on, or to once per second if K isn’t the active application.
+ */
+int Viewer::frameDelay() const {
+    int interval = 0;
+    if (QApplication::activeWindow() == nullptr) {
+        interval = 1000;
+    } else if (viewerState.framePacing) {
+        const auto * handle = mainWindow.windowHandle();
+        const auto * screen = handle != nullptr ? handle->screen() : QGuiApplication::primaryScreen();
+        const auto refreshRate = screen != nullptr && screen->refreshRate() > 0 ? screen->refreshRate() : 60;
+        interval = std::floor(1000 / refreshRate);
+    }
+    return std::max(0, interval - static_cast<int>(frameTimer.elapsed()));
+}
+
+/**
+ * @brief Viewer::requestFrame schedules one run() of the render loop, requests arriving until then are merged into it.
+ * Nothing is rendered while nobody requests frames. May be called from any thread.
+ */
+void Viewer::requestFrame() {
+    if (QThread::currentThread() != thread()) {// the timer can only be started from the gui thread
+        if (!frameRequestQueued.exchange(true)) {
+            QMetaObject::invokeMethod(this, "requestFrame", Qt::QueuedConnection);
+        }
+        return;
+    }
+    frameRequestQueued = false;
+    if (suspended || state->quitSignal) {
+        return;
+    }
+    const auto delay = frameDelay();
+    if (!timer.isActive() || timer.remainingTime() > delay) {
+        timer.start(delay);
+    }
 }
 
 void Viewer::saveSettings() {
@@ -185,116 +302,251 @@ void Viewer::setMagnificationLock(const bool locked) {
     emit magnificationLockChanged(locked);
 }
 
-void Viewer::dcSliceExtract(std::uint8_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, ViewportOrtho & vp, bool useCustomLUT) {
-    const auto & session = Session::singleton();
-    const Coordinate areaMinCoord = {session.movementAreaMin.x,
-                                     session.movementAreaMin.y,
-                                     session.movementAreaMin.z};
-    const Coordinate areaMaxCoord = {session.movementAreaMax.x,
-                                     session.movementAreaMax.y,
-                                     session.movementAreaMax.z};
-    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
-    const auto partlyInMovementArea =
-       areaMinCoord.x > cubePosInAbsPx.x || areaMaxCoord.x < cubePosInAbsPx.x + cubeEdgeLen * Dataset::current().magnification ||
-       areaMinCoord.y > cubePosInAbsPx.y || areaMaxCoord.y < cubePosInAbsPx.y + cubeEdgeLen * Dataset::current().magnification ||
-       areaMinCoord.z > cubePosInAbsPx.z || areaMaxCoord.z < cubePosInAbsPx.z + cubeEdgeLen * Dataset::current().magnification;
+/**
+ * @brief insideMovementArea range of texels along one axis of a cube slice which lie inside [areaMin, areaMax]
+ * @return first and last texel index, the range is empty if first > last
+ */
+static std::pair<int, int> insideMovementArea(const int cubePos, const int areaMin, const int areaMax, const int mag, const int cubeEdgeLen) {
+    const int first = std::ceil(static_cast<double>(areaMin - cubePos) / mag);
+    const int last = std::floor(static_cast<double>(areaMax - cubePos) / mag);
+    return {std::max(0, first), std::min(cubeEdgeLen - 1, last)};
+}
 
-    const std::size_t voxelIncrement = vp.viewportType == VIEWPORT_ZY ? cubeEdgeLen : 1;
-    const std::size_t sliceIncrement = vp.viewportType == VIEWPORT_XY ? cubeEdgeLen : state->cubeSliceArea;
-    const std::size_t sliceSubLineIncrement = vp.viewportType == VIEWPORT_ZY ? 0 : sliceIncrement - cubeEdgeLen;
-    const std::size_t texNextLine = vp.viewportType == VIEWPORT_ZY ? cubeEdgeLen * 3 : 3;// RGB per pixel
-    const std::size_t texRevertToFirstLine = vp.viewportType == VIEWPORT_ZY ? (state->cubeSliceArea - 1) * 3 : 0;
+/**
+ * Row kernels for the raw data slicing, each converts one row of gray values into RGB texels.
+ * The contiguous variants are used for xy and xz rows, the strided ones gather a zy row (y stays, z advances by one slice).
+ */
+static void grayRow(const std::uint8_t * src, std::uint8_t * dst, const int len) {
+    for (int i = 0; i < len; ++i) {
+        const auto value = src[i];
+        dst[3 * i + 0] = value;
+        dst[3 * i + 1] = value;
+        dst[3 * i + 2] = value;
+    }
+}
 
-    int offsetX = 0, offsetY = 0;
-    const int coordsPerLine = cubeEdgeLen * Dataset::current().magnification;
-    for (auto y = cubeEdgeLen; y != 0; --y) {
-        for (auto x = cubeEdgeLen; x != 0; --x) {// x and y’s values are not used
-            uint8_t r, g, b;
-            if(useCustomLUT) {
-                //extract data as unsigned number from the datacube
-                const uint8_t adjustIndex = datacube[0];
-                r = std::get<0>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-                g = std::get<1>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-                b = std::get<2>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
+static void grayRowStrided(const std::uint8_t * src, const std::size_t stride, std::uint8_t * dst, const int len) {
+    for (int i = 0; i < len; ++i) {
+        const auto value = src[i * stride];
+        dst[3 * i + 0] = value;
+        dst[3 * i + 1] = value;
+        dst[3 * i + 2] = value;
+    }
+}
+
+static void lutRow(const std::uint8_t * src, std::uint8_t * dst, const int len, const std::uint8_t * lut) {
+    for (int i = 0; i < len; ++i) {
+        const auto * rgb = lut + 3 * src[i];
+        dst[3 * i + 0] = rgb[0];
+        dst[3 * i + 1] = rgb[1];
+        dst[3 * i + 2] = rgb[2];
+    }
+}
+
+static void lutRowStrided(const std::uint8_t * src, const std::size_t stride, std::uint8_t * dst, const int len, const std::uint8_t * lut) {
+    for (int i = 0; i < len; ++i) {
+        const auto * rgb = lut + 3 * src[i * stride];
+        dst[3 * i + 0] = rgb[0];
+        dst[3 * i + 1] = rgb[1];
+        dst[3 * i + 2] = rgb[2];
+    }
+}
+
+static void darkenRun(std::uint8_t * texel, const int count, const std::array<std::uint8_t, 256> & darkening) {
+    for (int i = 0; i < 3 * count; ++i) {
+        texel[i] = darkening[texel[i]];
+    }
+}
+
+/**
+ * @brief Viewer::dcSliceExtract extracts one slice of a raw data cube into a cubeEdgeLen² RGB tile (row-major,
+ *      consecutive tile rows are texRowLen bytes apart).
+ *
+ * Texture rows correspond to y for xy, to z for xz and to y for zy, texture columns to x, x and z respectively.
+ * The values are copied row by row with the kernels above, the movement area is applied afterwards
+ * by darkening only the bands of the tile which lie outside of it.
+ * If datacube points into a transposed copy (see transposeRawCube) the rows of xz and zy slices are contiguous as well.
+ */
+void Viewer::dcSliceExtract(std::uint8_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, const std::size_t texRowLen, ViewportOrtho & vp, bool useCustomLUT, const bool transposed) {
+    // slices are extracted concurrently, so every worker keeps its own timings
+    static thread_local Profiler xyProfiler;
+    static thread_local Profiler xzProfiler;
+    static thread_local Profiler zyProfiler;
+    static thread_local Profiler xzTransposedProfiler;
+    static thread_local Profiler zyTransposedProfiler;
+    static thread_local Profiler maskProfiler;
+
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const auto mag = Dataset::current().magnification;
+    const auto * lut = state->viewerState->datasetAdjustmentRgb.data();
+
+    auto & profiler = vp.viewportType == VIEWPORT_XY ? xyProfiler
+                    : vp.viewportType == VIEWPORT_XZ ? (transposed ? xzTransposedProfiler : xzProfiler)
+                    : (transposed ? zyTransposedProfiler : zyProfiler);
+    profiler.start(); // ----------------------------------------------------------- profiling
+    if (vp.viewportType == VIEWPORT_ZY && !transposed) {// texture row: y, gather along z
+        for (int row = 0; row < cubeEdgeLen; ++row) {
+            const auto * src = datacube + row * cubeEdgeLen;
+            if (useCustomLUT) {
+                lutRowStrided(src, state->cubeSliceArea, slice + row * texRowLen, cubeEdgeLen, lut);
             } else {
-                r = g = b = datacube[0];
+                grayRowStrided(src, state->cubeSliceArea, slice + row * texRowLen, cubeEdgeLen);
             }
-            if(partlyInMovementArea) {
-                bool factor = false;
-                if((vp.viewportType == VIEWPORT_XY && (cubePosInAbsPx.y + offsetY < areaMinCoord.y || cubePosInAbsPx.y + offsetY > areaMaxCoord.y)) ||
-                    ((vp.viewportType == VIEWPORT_XZ || vp.viewportType == VIEWPORT_ZY) && (cubePosInAbsPx.z + offsetY < areaMinCoord.z || cubePosInAbsPx.z + offsetY > areaMaxCoord.z))) {
-                    // vertically out of movement area
-                    factor = true;
-                }
-                else if(((vp.viewportType == VIEWPORT_XY || vp.viewportType == VIEWPORT_XZ) && (cubePosInAbsPx.x + offsetX < areaMinCoord.x || cubePosInAbsPx.x + offsetX > areaMaxCoord.x)) ||
-                        (vp.viewportType == VIEWPORT_ZY && (cubePosInAbsPx.y + offsetX < areaMinCoord.y || cubePosInAbsPx.y + offsetX > areaMaxCoord.y))) {
-                    // horizontally out of movement area
-                    factor = true;
-                }
-                if (factor) {
-                    float d = state->viewerState->outsideMovementAreaFactor * 1.0 / 100;
-                    r *= d; g *= d; b *= d;
-                }
+        }
+    } else {// texture row: y (xy) or z (xz), contiguous along x (or z for transposed zy)
+        const std::size_t srcRowStride = vp.viewportType == VIEWPORT_XY || transposed ? cubeEdgeLen : state->cubeSliceArea;
+        for (int row = 0; row < cubeEdgeLen; ++row) {
+            const auto * src = datacube + row * srcRowStride;
+            if (useCustomLUT) {
+                lutRow(src, slice + row * texRowLen, cubeEdgeLen, lut);
+            } else {
+                grayRow(src, slice + row * texRowLen, cubeEdgeLen);
             }
-            slice[0] = r;
-            slice[1] = g;
-            slice[2] = b;
-
-            datacube += voxelIncrement;
-            slice += texNextLine;
-            offsetX = (offsetX + Dataset::current().magnification) % coordsPerLine;
-            offsetY += (offsetX == 0)? Dataset::current().magnification : 0; // at end of line increment to next line
         }
-        datacube += sliceSubLineIncrement;
-        slice -= texRevertToFirstLine;
     }
+    profiler.end(); // ----------------------------------------------------------- profiling
+
+    // only the texture column and row axes are tested against the movement area
+    const auto & areaMin = Session::singleton().movementAreaMin;
+    const auto & areaMax = Session::singleton().movementAreaMax;
+    const auto rangeInside = [&](const int cubePos, const int min, const int max) { return insideMovementArea(cubePos, min, max, mag, cubeEdgeLen); };
+    const auto cols = vp.viewportType == VIEWPORT_ZY ? rangeInside(cubePosInAbsPx.z, areaMin.z, areaMax.z) : rangeInside(cubePosInAbsPx.x, areaMin.x, areaMax.x);
+    const auto rows = vp.viewportType == VIEWPORT_XZ ? rangeInside(cubePosInAbsPx.z, areaMin.z, areaMax.z) : rangeInside(cubePosInAbsPx.y, areaMin.y, areaMax.y);
+    if (cols.first > 0 || cols.second < cubeEdgeLen - 1 || rows.first > 0 || rows.second < cubeEdgeLen - 1) {
+        maskProfiler.start(); // ----------------------------------------------------------- profiling
+        const float d = state->viewerState->outsideMovementAreaFactor * 1.0 / 100;
+        std::array<std::uint8_t, 256> darkening;
+        for (std::size_t i = 0; i < darkening.size(); ++i) {
+            darkening[i] = static_cast<std::uint8_t>(i * d);
+        }
+        const bool anyColInside = cols.first <= cols.second;
+        for (int row = 0; row < cubeEdgeLen; ++row) {
+            auto * texRow = slice + row * texRowLen;
+            if (!anyColInside || row < rows.first || row > rows.second) {
+                darkenRun(texRow, cubeEdgeLen, darkening);
+            } else {
+                darkenRun(texRow, cols.first, darkening);
+                darkenRun(texRow + 3 * (cols.second + 1), cubeEdgeLen - 1 - cols.second, darkening);
+            }
+        }
+        maskProfiler.end(); // ----------------------------------------------------------- profiling
+    }
+
+    // --------------------- display some profiling information ------------------------
+    // qDebug() << "dc slice xy avg time: " << xyProfiler.average_time()*1000 << "ms";
+    // qDebug() << "         xz         : " << xzProfiler.average_time()*1000 << "ms";
+    // qDebug() << "         zy         : " << zyProfiler.average_time()*1000 << "ms";
+    // qDebug() << "         xz transp. : " << xzTransposedProfiler.average_time()*1000 << "ms";
+    // qDebug() << "         zy transp. : " << zyTransposedProfiler.average_time()*1000 << "ms";
+    // qDebug() << "         mask       : " << maskProfiler.average_time()*1000 << "ms";
 }
 
-void Viewer::dcSliceExtract(std::uint8_t * datacube, floatCoordinate *currentPxInDc_float, std::uint8_t * slice, int s, int *t, ViewportArb &vp, bool useCustomLUT) {
-    Coordinate currentPxInDc = {roundFloat(currentPxInDc_float->x), roundFloat(currentPxInDc_float->y), roundFloat(currentPxInDc_float->z)};
-    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
-    if((currentPxInDc.x < 0) || (currentPxInDc.y < 0) || (currentPxInDc.z < 0) ||
-       (currentPxInDc.x >= cubeEdgeLen) || (currentPxInDc.y >= cubeEdgeLen) || (currentPxInDc.z >= cubeEdgeLen)) {
-        const int sliceIndex = 3 * ( s + *t  *  cubeEdgeLen * state->M);
-        slice[sliceIndex] = slice[sliceIndex + 1] = slice[sliceIndex + 2] = 0;
-        (*t)++;
-        if(*t < vp.texture.usedSizeInCubePixels) {
-            // Actually, although currentPxInDc_float is passed by reference and updated here,
-            // it is totally ignored (i.e. not read, then overwritten) by the calling function.
-            // But to keep the functionality here compatible after this bugfix, we also replicate
-            // this update here - from the originial below
-            *currentPxInDc_float -= vp.v2;
-        }
-        return;
+static constexpr int arbFixedShift = 16;// fraction bits of the fixed point positions in arb slicing
+
+static std::int64_t toArbFixed(const float value) {
+    return std::llround(value * (std::int64_t{1} << arbFixedShift));
+}
+
+static std::int64_t floorDiv(const std::int64_t value, const std::int64_t divisor) {// divisor > 0
+    return value >= 0 ? value / divisor : -((divisor - 1 - value) / divisor);
+}
+
+static std::uint8_t arbVoxel(const coord2bytep_map_t & cubes, const std::int64_t x, const std::int64_t y, const std::int64_t z) {
+    const std::int64_t cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const CoordOfCube cubeCoord(floorDiv(x, cubeEdgeLen), floorDiv(y, cubeEdgeLen), floorDiv(z, cubeEdgeLen));
+    const auto * datacube = reinterpret_cast<const std::uint8_t *>(Coordinate2BytePtr_hash_get_or_fail(cubes, cubeCoord));
+    if (datacube == nullptr) {
+        return 0;
     }
+    return datacube[(x - cubeCoord.x * cubeEdgeLen) + (y - cubeCoord.y * cubeEdgeLen) * cubeEdgeLen + (z - cubeCoord.z * cubeEdgeLen) * state->cubeSliceArea];
+}
 
-    while((0 <= currentPxInDc.x && currentPxInDc.x < cubeEdgeLen)
-          && (0 <= currentPxInDc.y && currentPxInDc.y < cubeEdgeLen)
-          && (0 <= currentPxInDc.z && currentPxInDc.z < cubeEdgeLen)) {
+static std::uint8_t lerp8(const std::uint32_t a, const std::uint32_t b, const std::uint32_t weight) {// weight in [0, 256]
+    return (a * (256 - weight) + b * weight + 128) >> 8;
+}
 
-        const int sliceIndex = 3 * ( s + *t  *  cubeEdgeLen * state->M);
-        const int dcIndex = currentPxInDc.x + currentPxInDc.y * cubeEdgeLen + currentPxInDc.z * state->cubeSliceArea;
-        if(datacube == NULL) {
-            slice[sliceIndex] = slice[sliceIndex + 1] = slice[sliceIndex + 2] = 0;
+/**
+ * @brief Viewer::dcSliceExtract resamples one texture row of the arbitrary viewport, starting at rowStartPx and stepping along v1.
+ * Positions are advanced in fixed point and the row is clipped analytically into spans which stay inside one cube
+ * (the cube of the sample, or of the lower corner for trilinear interpolation), so each cube is looked up once per span.
+ * Trilinear samples whose upper neighbours lie in the adjacent cubes fall back to per voxel lookups.
+ */
+void Viewer::dcSliceExtract(const coord2bytep_map_t & cubes, const floatCoordinate rowStartPx, std::uint8_t * row, ViewportArb & vp, bool useCustomLUT) {
+    static thread_local Profiler nearestProfiler;
+    static thread_local Profiler trilinearProfiler;
+
+    const std::int64_t cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const std::int64_t cubeEdgeFixed = cubeEdgeLen << arbFixedShift;
+    const std::int64_t fractionMask = (std::int64_t{1} << arbFixedShift) - 1;
+    const bool trilinear = state->viewerState->arbTrilinearFiltering;
+    const auto * lut = state->viewerState->datasetAdjustmentRgb.data();
+    // nearest neighbour takes the voxel which contains the position, i.e. floor(position + 0.5)
+    const float sampleOffset = trilinear ? 0.f : 0.5f;
+    std::array<std::int64_t, 3> pos{{toArbFixed(rowStartPx.x + sampleOffset), toArbFixed(rowStartPx.y + sampleOffset), toArbFixed(rowStartPx.z + sampleOffset)}};
+    const std::array<std::int64_t, 3> step{{toArbFixed(vp.v1.x), toArbFixed(vp.v1.y), toArbFixed(vp.v1.z)}};
+    const auto store = [lut, useCustomLUT](std::uint8_t * texel, const std::uint8_t value) {
+        if (useCustomLUT) {
+            texel[0] = lut[3 * value + 0];
+            texel[1] = lut[3 * value + 1];
+            texel[2] = lut[3 * value + 2];
         } else {
-            if(useCustomLUT) {
-                //extract data as unsigned number from the datacube
-                const unsigned char adjustIndex = datacube[dcIndex];
-                slice[sliceIndex + 0] = std::get<0>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-                slice[sliceIndex + 1] = std::get<1>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-                slice[sliceIndex + 2] = std::get<2>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-            }
-            else {
-                slice[sliceIndex] = slice[sliceIndex + 1] = slice[sliceIndex + 2] = datacube[dcIndex];
+            texel[0] = texel[1] = texel[2] = value;
+        }
+    };
+
+    auto & profiler = trilinear ? trilinearProfiler : nearestProfiler;
+    profiler.start(); // ----------------------------------------------------------- profiling
+    const std::int64_t len = vp.texture.usedSizeInCubePixels;
+    for (std::int64_t i = 0; i < len;) {
+        std::array<std::int64_t, 3> cube;
+        std::int64_t span = len - i;
+        for (std::size_t axis = 0; axis < 3; ++axis) {// number of steps until the position leaves the current cube
+            cube[axis] = floorDiv(pos[axis], cubeEdgeFixed);
+            if (step[axis] > 0) {
+                span = std::min(span, ((cube[axis] + 1) * cubeEdgeFixed - pos[axis] + step[axis] - 1) / step[axis]);
+            } else if (step[axis] < 0) {
+                span = std::min(span, (pos[axis] - cube[axis] * cubeEdgeFixed) / -step[axis] + 1);
             }
         }
-        (*t)++;
-        if(*t >= vp.texture.usedSizeInCubePixels) {
-            break;
+        const auto * datacube = reinterpret_cast<const std::uint8_t *>(Coordinate2BytePtr_hash_get_or_fail(cubes, CoordOfCube(cube[0], cube[1], cube[2])));
+        const std::array<std::int64_t, 3> origin{{cube[0] * cubeEdgeFixed, cube[1] * cubeEdgeFixed, cube[2] * cubeEdgeFixed}};
+        auto * texel = row + 3 * i;
+        for (std::int64_t n = 0; n < span; ++n, texel += 3) {
+            const auto x = (pos[0] - origin[0]) >> arbFixedShift;
+            const auto y = (pos[1] - origin[1]) >> arbFixedShift;
+            const auto z = (pos[2] - origin[2]) >> arbFixedShift;
+            if (!trilinear) {
+                store(texel, datacube == nullptr ? 0 : datacube[x + y * cubeEdgeLen + z * state->cubeSliceArea]);
+            } else {
+                const std::uint32_t wx = ((pos[0] & fractionMask) + 128) >> (arbFixedShift - 8);
+                const std::uint32_t wy = ((pos[1] & fractionMask) + 128) >> (arbFixedShift - 8);
+                const std::uint32_t wz = ((pos[2] & fractionMask) + 128) >> (arbFixedShift - 8);
+                std::array<std::uint8_t, 8> corners;
+                if (datacube != nullptr && x + 1 < cubeEdgeLen && y + 1 < cubeEdgeLen && z + 1 < cubeEdgeLen) {
+                    const auto * voxel = datacube + x + y * cubeEdgeLen + z * state->cubeSliceArea;
+                    corners = {{voxel[0], voxel[1], voxel[cubeEdgeLen], voxel[cubeEdgeLen + 1]
+                              , voxel[state->cubeSliceArea], voxel[state->cubeSliceArea + 1], voxel[state->cubeSliceArea + cubeEdgeLen], voxel[state->cubeSliceArea + cubeEdgeLen + 1]}};
+                } else {// neighbours in other cubes
+                    const auto gx = cube[0] * cubeEdgeLen + x, gy = cube[1] * cubeEdgeLen + y, gz = cube[2] * cubeEdgeLen + z;
+                    for (std::size_t corner = 0; corner < corners.size(); ++corner) {
+                        corners[corner] = arbVoxel(cubes, gx + (corner & 1), gy + ((corner >> 1) & 1), gz + ((corner >> 2) & 1));
+                    }
+                }
+                const auto front = lerp8(lerp8(corners[0], corners[1], wx), lerp8(corners[2], corners[3], wx), wy);
+                const auto back = lerp8(lerp8(corners[4], corners[5], wx), lerp8(corners[6], corners[7], wx), wy);
+                store(texel, lerp8(front, back, wz));
+            }
+            pos[0] += step[0];
+            pos[1] += step[1];
+            pos[2] += step[2];
         }
-        *currentPxInDc_float -= vp.v2;
-        currentPxInDc = {roundFloat(currentPxInDc_float->x), roundFloat(currentPxInDc_float->y), roundFloat(currentPxInDc_float->z)};
+        i += span;
     }
+    profiler.end(); // ----------------------------------------------------------- profiling
+
+    // --------------------- display some profiling information ------------------------
+    // qDebug() << "arb row nearest avg time  : " << nearestProfiler.average_time()*1000 << "ms";
+    // qDebug() << "arb row trilinear avg time: " << trilinearProfiler.average_time()*1000 << "ms";
 }
 
 /**
@@ -303,6 +555,7 @@ void Viewer::dcSliceExtract(std::uint8_t * datacube, floatCoordinate *currentPxI
  * @param datacube pointer to the datacube for data extraction
  * @param cubePosInAbsPx smallest coordinates inside the datacube in dataset pixels
  * @param slice pointer to a slice in which to draw the overlay
+ * @param texRowLen distance in bytes between two rows of the slice
  *
  * In the first pass all pixels are filled with the color corresponding the subObject-ID.
  * In the second pass the datacube is traversed again to find edge voxels, i.e. all voxels
@@ -313,7 +566,7 @@ void Viewer::dcSliceExtract(std::uint8_t * datacube, floatCoordinate *currentPxI
  * each pixel is tested for its position and is omitted if outside of the area.
  *
  */
-void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, ViewportOrtho & vp) {
+void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, const std::size_t texRowLen, ViewportOrtho & vp) {
     const auto & session = Session::singleton();
     const Coordinate areaMinCoord = {session.movementAreaMin.x,
                                      session.movementAreaMin.y,
@@ -330,14 +583,14 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
     const std::size_t voxelIncrement = vp.viewportType == VIEWPORT_ZY ? cubeEdgeLen : 1;
     const std::size_t sliceIncrement = vp.viewportType == VIEWPORT_XY ? cubeEdgeLen : state->cubeSliceArea;
     const std::size_t sliceSubLineIncrement = vp.viewportType == VIEWPORT_ZY ? 0 : sliceIncrement - cubeEdgeLen;
-    const std::size_t texNextLine = vp.viewportType == VIEWPORT_ZY ? cubeEdgeLen * 4 : 4;// RGBA per pixel
-    const std::size_t textRevertToFirstLine = vp.viewportType == VIEWPORT_ZY ? (state->cubeSliceArea - 1) * 4 : 0;
+    const std::ptrdiff_t texNextLine = vp.viewportType == VIEWPORT_ZY ? texRowLen : 4;// RGBA per pixel
+    const std::ptrdiff_t texNextRow = vp.viewportType == VIEWPORT_ZY ? 4 - static_cast<std::ptrdiff_t>(texRowLen * cubeEdgeLen) : texRowLen - 4 * cubeEdgeLen;
 
     auto & seg = Segmentation::singleton();
     //cache
-    uint64_t subobjectIdCache = Segmentation::singleton().getBackgroundId();
-    bool selectedCache = seg.isSubObjectIdSelected(subobjectIdCache);
-    std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> colorCache = seg.colorObjectFromSubobjectId(subobjectIdCache);
+    bool infoCacheValid = false;
+    uint64_t subobjectIdCache = 0;
+    Segmentation::SubobjectRenderInfo info{};
     //first and last row boundaries
     const std::size_t min = cubeEdgeLen;
     const std::size_t max = cubeEdgeLen * (cubeEdgeLen - 1);
@@ -364,14 +617,17 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
 
             if(hide == false) {
                 const uint64_t subobjectId = datacube[0];
+                if (!infoCacheValid || subobjectIdCache != subobjectId) {
+                    info = seg.subobjectRenderInfo(subobjectId);
+                    subobjectIdCache = subobjectId;
+                    infoCacheValid = true;
+                }
 
-                const auto color = (subobjectIdCache == subobjectId) ? colorCache : seg.colorObjectFromSubobjectId(subobjectId);
-                slice[0] = std::get<0>(color);
-                slice[1] = std::get<1>(color);
-                slice[2] = std::get<2>(color);
-                slice[3] = std::get<3>(color);
+                slice[0] = std::get<0>(info.color);
+                slice[1] = std::get<1>(info.color);
+                slice[2] = std::get<2>(info.color);
+                slice[3] = std::get<3>(info.color);
 
-                const bool selected = (subobjectIdCache == subobjectId) ? selectedCache : seg.isSubObjectIdSelected(subobjectId);
                 const bool isPastFirstRow = counter >= min;
                 const bool isBeforeLastRow = counter < max;
                 const bool isNotFirstColumn = counter % cubeEdgeLen != 0;
@@ -380,13 +636,13 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
                 // highlight edges where needed
                 if(seg.highlightBorder) {
                     if(seg.hoverVersion) {
-                        uint64_t objectId = seg.tryLargestObjectContainingSubobject(subobjectId);
-                        if (selected && seg.mouseFocusedObjectId == objectId) {
+                        const uint64_t objectId = info.objectId;
+                        if (info.selected && seg.mouseFocusedObjectId == objectId) {
                             if(isPastFirstRow && isBeforeLastRow && isNotFirstColumn && isNotLastColumn) {
-                                const uint64_t left   = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube - voxelIncrement));
-                                const uint64_t right  = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube + voxelIncrement));
-                                const uint64_t top    = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube - sliceIncrement));
-                                const uint64_t bottom = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube + sliceIncrement));
+                                const uint64_t left   = seg.subobjectRenderInfo(*(datacube - voxelIncrement)).objectId;
+                                const uint64_t right  = seg.subobjectRenderInfo(*(datacube + voxelIncrement)).objectId;
+                                const uint64_t top    = seg.subobjectRenderInfo(*(datacube - sliceIncrement)).objectId;
+                                const uint64_t bottom = seg.subobjectRenderInfo(*(datacube + sliceIncrement)).objectId;
                                 //enhance alpha of this voxel if any of the surrounding voxels belong to another object
                                 if (objectId != left || objectId != right || objectId != top || objectId != bottom) {
                                     slice[3] = std::min(255, slice[3]*4);
@@ -394,22 +650,17 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
                             }
                         }
                     }
-                    else if (selected && isPastFirstRow && isBeforeLastRow && isNotFirstColumn && isNotLastColumn) {
-                        const uint64_t left   = datacube[-voxelIncrement];
-                        const uint64_t right  = datacube[+voxelIncrement];
-                        const uint64_t top    = datacube[-sliceIncrement];
-                        const uint64_t bottom = datacube[+sliceIncrement];
+                    else if (info.selected && isPastFirstRow && isBeforeLastRow && isNotFirstColumn && isNotLastColumn) {
+                        const uint64_t left   = *(datacube - voxelIncrement);
+                        const uint64_t right  = *(datacube + voxelIncrement);
+                        const uint64_t top    = *(datacube - sliceIncrement);
+                        const uint64_t bottom = *(datacube + sliceIncrement);
                         //enhance alpha of this voxel if any of the surrounding voxels belong to another subobject
                         if (subobjectId != left || subobjectId != right || subobjectId != top || subobjectId != bottom) {
                             slice[3] = std::min(255, slice[3]*4);
                         }
                     }
                 }
-
-                //fill cache
-                subobjectIdCache = subobjectId;
-                colorCache = color;
-                selectedCache = selected;
             }
             ++counter;
             datacube += voxelIncrement;
@@ -418,18 +669,43 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
             offsetY += (offsetX == 0)? Dataset::current().magnification : 0; // at end of line increment to next line
         }
         datacube += sliceSubLineIncrement;
-        slice -= textRevertToFirstLine;
+        slice += texNextRow;
     }
 }
 
-static int texIndex(uint x, uint y, uint colorMultiplicationFactor, viewportTexture *texture) {
-    uint index = 0;
+/**
+ * @brief uploadSlices copies the slices of one layer into the lower left stagingEdge² square of the texture.
+ *      pixels is an offset into the bound pixel unpack buffer if there is one.
+ */
+static void uploadSlices(const uint texHandle, const GLenum format, const std::uint8_t * pixels, const int stagingEdge) {
+    glBindTexture(GL_TEXTURE_2D, texHandle);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stagingEdge, stagingEdge, format, GL_UNSIGNED_BYTE, pixels);
+}
 
-    index = x * state->cubeSliceArea + y
-            * (texture->size * Dataset::current().cubeEdgeLength)
-            * colorMultiplicationFactor;
+/**
+ * @brief uploadSlices copies the staging buffer of one layer into the texture.
+ *      If available, the transfer goes through a pixel buffer so glTexSubImage2D does not have to wait for it.
+ */
+static void uploadSlices(const uint texHandle, const GLenum format, QOpenGLBuffer & uploadBuffer, const std::vector<std::uint8_t> & staging, const int stagingEdge) {
+    if (uploadBuffer.isCreated()) {
+        uploadBuffer.bind();
+        uploadBuffer.allocate(staging.data(), staging.size());// reallocation orphans the storage of the previous upload
+        uploadSlices(texHandle, format, nullptr, stagingEdge);
+        uploadBuffer.release();
+    } else {
+        uploadSlices(texHandle, format, staging.data(), stagingEdge);
+    }
+}
 
-    return index;
+/**
+ * @brief uploadTile copies a single cube tile of the slices into the texture.
+ */
+static void uploadTile(const uint texHandle, const GLenum format, const std::size_t bytesPerTexel, const std::uint8_t * pixels, const int stagingEdge, const int x_px, const int y_px) {
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    glBindTexture(GL_TEXTURE_2D, texHandle);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stagingEdge);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x_px, y_px, cubeEdgeLen, cubeEdgeLen, format, GL_UNSIGNED_BYTE, pixels + bytesPerTexel * (y_px * stagingEdge + x_px));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
 
 bool Viewer::vpGenerateTexture(ViewportOrtho & vp) {
@@ -439,11 +715,31 @@ bool Viewer::vpGenerateTexture(ViewportOrtho & vp) {
         vpGenerateTexture(static_cast<ViewportArb&>(vp));
         return true;
     }
-    const bool dc_reslice = vp.dcResliceNecessary;
-    const bool oc_reslice = vp.ocResliceNecessary;
-    vp.dcResliceNecessary = vp.ocResliceNecessary = false;
     const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
-    const CoordInCube currentPosition_dc = state->viewerState->currentPosition.insideCube(cubeEdgeLen, Dataset::current().magnification);
+    const auto mag = Dataset::current().magnification;
+    // The slices of all M² cubes are placed into one staging buffer per layer
+    // with the same layout as the lower left M·cubeEdgeLen square of the texture.
+    // If supported this is a slot of the persistently mapped upload ring, else a buffer in client memory.
+    const int stagingEdge = state->M * cubeEdgeLen;
+    const std::size_t dcRowLen = 3 * stagingEdge;// RGB
+    const std::size_t ocRowLen = 4 * stagingEdge;// RGBA
+    const auto stagingSize = [](UploadRing & ring, std::vector<std::uint8_t> & staging) {
+        return ring.isCreated() ? ring.size() : staging.size();
+    };
+    // everything has to be resliced after movement or setting changes, otherwise only the tiles of changed cubes
+    const bool dc_reslice = vp.dcResliceNecessary.exchange(false) || stagingSize(vp.dcUploadRing, vp.dcStaging) != dcRowLen * stagingEdge;
+    const bool oc_reslice = Dataset::current().overlay && (vp.ocResliceNecessary.exchange(false) || stagingSize(vp.ocUploadRing, vp.ocStaging) != ocRowLen * stagingEdge);
+    std::unordered_set<CoordOfCube> dcDirtyCubes;
+    std::unordered_set<CoordOfCube> ocDirtyCubes;
+    {
+        QMutexLocker locker(&vp.dirtyCubesMutex);
+        std::swap(dcDirtyCubes, vp.dcDirtyCubes);
+        std::swap(ocDirtyCubes, vp.ocDirtyCubes);
+    }
+    if (!Dataset::current().overlay) {
+        ocDirtyCubes.clear();
+    }
+    const CoordInCube currentPosition_dc = state->viewerState->currentPosition.insideCube(cubeEdgeLen, mag);
 
     int slicePositionWithinCube;
     switch(vp.viewportType) {
@@ -460,102 +756,138 @@ bool Viewer::vpGenerateTexture(ViewportOrtho & vp) {
         qDebug("No such slice view: %d.", vp.viewportType);
         return false;
     }
+    if (!dc_reslice && !oc_reslice && dcDirtyCubes.empty() && ocDirtyCubes.empty()) {
+        return true;
+    }
 
-    const CoordOfCube upperLeftDc = Coordinate(vp.texture.leftUpperPxInAbsPx).cube(cubeEdgeLen, Dataset::current().magnification);
+    static Profiler slicing_profiler;
+    static Profiler upload_profiler;
 
-    std::vector<std::uint8_t> texData(4 * std::pow(state->viewerState->texEdgeLength, 2));
+    // a ring slot has to be written completely or only its dirty tiles uploaded, as it holds the slices of an earlier frame
+    const auto stagingTarget = [](UploadRing & ring, std::vector<std::uint8_t> & staging, const std::size_t size, const bool reslice, const bool dirty) -> std::uint8_t * {
+        if (!reslice && !dirty) {
+            return nullptr;
+        } else if (ring.isCreated()) {
+            return ring.acquire(size);
+        }
+        staging.resize(size);
+        return staging.data();
+    };
+    auto * const dcStaging = stagingTarget(vp.dcUploadRing, vp.dcStaging, dcRowLen * stagingEdge, dc_reslice, !dcDirtyCubes.empty());
+    auto * const ocStaging = stagingTarget(vp.ocUploadRing, vp.ocStaging, ocRowLen * stagingEdge, oc_reslice, !ocDirtyCubes.empty());
+
+    struct SliceJob {
+        void * cube;
+        Coordinate cubePosInAbsPx;
+        std::uint8_t * tile;
+        int x_px;
+        int y_px;
+        bool overlay;
+        bool transposed;
+    };
+    std::vector<SliceJob> jobs;
+    jobs.reserve(2 * state->M * state->M);
+    const CoordOfCube upperLeftDc = Coordinate(vp.texture.leftUpperPxInAbsPx).cube(cubeEdgeLen, mag);
     // We iterate over the texture with x and y being in a temporary coordinate
     // system local to this texture.
+    state->protectCube2Pointer.lock();
     for(int x_dc = 0; x_dc < state->M; x_dc++) {
         for(int y_dc = 0; y_dc < state->M; y_dc++) {
             const int x_px = x_dc * cubeEdgeLen;
             const int y_px = y_dc * cubeEdgeLen;
 
             CoordOfCube currentDc;
-
-            switch(vp.viewportType) {
             // With an x/y-coordinate system in a viewport, we get the following
             // mapping from viewport (slice) coordinates to global (dc)
             // coordinates:
             // XY-slice: x local is x global, y local is y global
             // XZ-slice: x local is x global, y local is z global
             // ZY-slice: x local is z global, y local is y global.
-            case VIEWPORT_XY:
+            if (vp.viewportType == VIEWPORT_XY) {
                 currentDc = {upperLeftDc.x + x_dc, upperLeftDc.y + y_dc, upperLeftDc.z};
-                break;
-            case VIEWPORT_XZ:
+            } else if (vp.viewportType == VIEWPORT_XZ) {
                 currentDc = {upperLeftDc.x + x_dc, upperLeftDc.y, upperLeftDc.z + y_dc};
-                break;
-            case VIEWPORT_ZY:
+            } else {
                 currentDc = {upperLeftDc.x, upperLeftDc.y + y_dc, upperLeftDc.z + x_dc};
-                break;
-            default:
-                qDebug("No such slice type (%d) in vpGenerateTexture.", vp.viewportType);
             }
-            state->protectCube2Pointer.lock();
-            void * const datacube = Coordinate2BytePtr_hash_get_or_fail(state->Dc2Pointer[int_log(Dataset::current().magnification)], currentDc);
-            void * const overlayCube = Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[int_log(Dataset::current().magnification)], currentDc);
-            state->protectCube2Pointer.unlock();
-
-            // Take care of the data textures.
-
-            Coordinate cubePosInAbsPx = {currentDc.x * Dataset::current().magnification * cubeEdgeLen,
-                                         currentDc.y * Dataset::current().magnification * cubeEdgeLen,
-                                         currentDc.z * Dataset::current().magnification * cubeEdgeLen};
-            if (dc_reslice) {
-                glBindTexture(GL_TEXTURE_2D, vp.texture.texHandle);
-
-                // This is used to index into the texture. overlayData[index] is the first
-                // byte of the datacube slice at position (x_dc, y_dc) in the texture.
-                const int index = texIndex(x_dc, y_dc, 3, &(vp.texture));
-
-                if (datacube != nullptr) {
-                    dcSliceExtract(reinterpret_cast<std::uint8_t *>(datacube) + slicePositionWithinCube,
-                                   cubePosInAbsPx,
-                                   texData.data() + index,
-                                   vp,
-                                   state->viewerState->datasetAdjustmentOn);
-                } else {
-                    std::fill(std::begin(texData), std::end(texData), 0);
+            const Coordinate cubePosInAbsPx = currentDc.cube2Global(cubeEdgeLen, mag);
+            if (dc_reslice || dcDirtyCubes.count(currentDc) != 0) {
+                void * datacube = Coordinate2BytePtr_hash_get_or_fail(state->Dc2Pointer[int_log(mag)], currentDc);
+                void * const transposedCube = vp.viewportType == VIEWPORT_XY ? nullptr : Coordinate2BytePtr_hash_get_or_fail(state->DcTransposed2Pointer[int_log(mag)], currentDc);
+                if (datacube != nullptr && transposedCube != nullptr) {// zy layout comes first, then xz
+                    datacube = reinterpret_cast<std::uint8_t *>(transposedCube) + (vp.viewportType == VIEWPORT_ZY ? 0 : state->cubeBytes);
                 }
-                glTexSubImage2D(GL_TEXTURE_2D,
-                                0,
-                                x_px,
-                                y_px,
-                                cubeEdgeLen,
-                                cubeEdgeLen,
-                                GL_RGB,
-                                GL_UNSIGNED_BYTE,
-                                texData.data() + index);
+                jobs.push_back({datacube, cubePosInAbsPx, dcStaging + y_px * dcRowLen + 3 * x_px, x_px, y_px, false, datacube != nullptr && transposedCube != nullptr});
             }
-            //Take care of the overlay textures.
-            if (Dataset::current().overlay && oc_reslice) {
-                glBindTexture(GL_TEXTURE_2D, vp.texture.overlayHandle);
-                // This is used to index into the texture. texData[index] is the first
-                // byte of the datacube slice at position (x_dc, y_dc) in the texture.
-                const int index = texIndex(x_dc, y_dc, 4, &(vp.texture));
-
-                if (overlayCube != nullptr) {
-                    ocSliceExtract(reinterpret_cast<std::uint64_t *>(overlayCube) + slicePositionWithinCube,
-                                   cubePosInAbsPx,
-                                   texData.data() + index,
-                                   vp);
-                } else {
-                    std::fill(std::begin(texData), std::end(texData), 0);
+            if (oc_reslice || ocDirtyCubes.count(currentDc) != 0) {
+                void * const overlayCube = Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[int_log(mag)], currentDc);
+                jobs.push_back({overlayCube, cubePosInAbsPx, ocStaging + y_px * ocRowLen + 4 * x_px, x_px, y_px, true, false});
+            }
+        }
+    }
+    state->protectCube2Pointer.unlock();
+
+    slicing_profiler.start(); // ----------------------------------------------------------- profiling
+    QtConcurrent::blockingMap(jobs, [this, &vp, slicePositionWithinCube, currentPosition_dc, cubeEdgeLen, dcRowLen, ocRowLen](const SliceJob & job) {
+        const auto rowLen = job.overlay ? ocRowLen : dcRowLen;
+        if (job.cube == nullptr) {// missing cubes are shown black (raw) or transparent (overlay)
+            for (int row = 0; row < cubeEdgeLen; ++row) {
+                std::fill_n(job.tile + row * rowLen, (job.overlay ? 4 : 3) * cubeEdgeLen, 0);
+            }
+        } else if (job.overlay) {
+            ocSliceExtract(reinterpret_cast<std::uint64_t *>(job.cube) + slicePositionWithinCube, job.cubePosInAbsPx, job.tile, rowLen, vp);
+        } else {
+            // in the transposed copies the current slice is the slowest dimension
+            const auto slicePosition = job.transposed ? state->cubeSliceArea * (vp.viewportType == VIEWPORT_ZY ? currentPosition_dc.x : currentPosition_dc.y) : slicePositionWithinCube;
+            dcSliceExtract(reinterpret_cast<std::uint8_t *>(job.cube) + slicePosition, job.cubePosInAbsPx, job.tile, rowLen, vp, state->viewerState->datasetAdjustmentOn, job.transposed);
+        }
+    });
+    slicing_profiler.end(); // ----------------------------------------------------------- profiling
+
+    upload_profiler.start(); // ----------------------------------------------------------- profiling
+    if (vp.uploadTimes.isCreated()) {
+        vp.uploadTimes.reset();
+        vp.uploadTimes.recordSample();
+    }
+    const auto uploadLayer = [&vp, &jobs, stagingEdge](const bool overlay, const bool reslice, const std::uint8_t * staging, UploadRing & ring, QOpenGLBuffer & uploadBuffer, const std::vector<std::uint8_t> & clientStaging) {
+        const auto texHandle = overlay ? vp.texture.overlayHandle : vp.texture.texHandle;
+        const GLenum format = overlay ? GL_RGBA : GL_RGB;
+        if (ring.isCreated()) {// returns immediately, the gpu reads from the slot asynchronously
+            ring.bind();
+            staging = reinterpret_cast<const std::uint8_t *>(ring.offset());
+        }
+        if (reslice && !ring.isCreated()) {
+            uploadSlices(texHandle, format, uploadBuffer, clientStaging, stagingEdge);
+        } else if (reslice) {
+            uploadSlices(texHandle, format, staging, stagingEdge);
+        } else {
+            for (const auto & job : jobs) {// single tiles
+                if (job.overlay == overlay) {
+                    uploadTile(texHandle, format, overlay ? 4 : 3, staging, stagingEdge, job.x_px, job.y_px);
                 }
-                glTexSubImage2D(GL_TEXTURE_2D,
-                                0,
-                                x_px,
-                                y_px,
-                                cubeEdgeLen,
-                                cubeEdgeLen,
-                                GL_RGBA,
-                                GL_UNSIGNED_BYTE,
-                                texData.data() + index);
             }
         }
+        if (ring.isCreated()) {
+            ring.unbind();
+            ring.fence();
+        }
+    };
+    if (dcStaging != nullptr) {
+        uploadLayer(false, dc_reslice, dcStaging, vp.dcUploadRing, vp.dcUploadBuffer, vp.dcStaging);
+    }
+    if (ocStaging != nullptr) {
+        uploadLayer(true, oc_reslice, ocStaging, vp.ocUploadRing, vp.ocUploadBuffer, vp.ocStaging);
     }
     glBindTexture(GL_TEXTURE_2D, 0);
+    if (vp.uploadTimes.isCreated()) {
+        vp.uploadTimes.recordSample();
+    }
+    upload_profiler.end(); // ----------------------------------------------------------- profiling
+
+    // --------------------- display some profiling information ------------------------
+    // qDebug() << "slicing avg time: " << slicing_profiler.average_time()*1000 << "ms";
+    // qDebug() << "upload avg time : " << upload_profiler.average_time()*1000 << "ms";
+    // qDebug() << "upload gpu time : " << vp.uploadTimes.waitForIntervals();
     return true;
 }
 
@@ -574,6 +906,7 @@ void Viewer::arbCubes(ViewportArb & vp) {
         for (auto & pair : layer.textures) {
             pair.second->vertices.clear();
         }
+        ++layer.texturesRevision;
     }
 
     const auto gpusupercube = (state->M - 1) * Dataset::current().cubeEdgeLength / gpucubeedge + 1;//remove cpu overlap and add gpu overlap
@@ -677,64 +1010,41 @@ void Viewer::setDefaultVPSizeAndPos(const bool on) {
 }
 
 void Viewer::vpGenerateTexture(ViewportArb &vp) {
-    if (!vp.dcResliceNecessary) {
+    if (!vp.dcResliceNecessary.exchange(false)) {
         return;
     }
-    vp.dcResliceNecessary = false;
-
-    // Load the texture for a viewport by going through all relevant datacubes and copying slices
-    // from those cubes into the texture.
-    floatCoordinate currentPxInDc_float, rowPx_float, currentPx_float;
-
-    rowPx_float = vp.texture.leftUpperPxInAbsPx / Dataset::current().magnification;
-    currentPx_float = rowPx_float;
-
-    std::vector<std::uint8_t> texData(3 * std::pow(state->viewerState->texEdgeLength, 2));
-
-    glBindTexture(GL_TEXTURE_2D, vp.texture.texHandle);
-
-    int s = 0, t = 0, t_old = 0;
-    while(s < vp.texture.usedSizeInCubePixels) {
-        t = 0;
-        while(t < vp.texture.usedSizeInCubePixels) {
-            Coordinate currentPx = {roundFloat(currentPx_float.x), roundFloat(currentPx_float.y), roundFloat(currentPx_float.z)};
-            Coordinate currentDc = currentPx / Dataset::current().cubeEdgeLength;
-
-            if(currentPx.x < 0) { currentDc.x -= 1; }
-            if(currentPx.y < 0) { currentDc.y -= 1; }
-            if(currentPx.z < 0) { currentDc.z -= 1; }
-
-            state->protectCube2Pointer.lock();
-            void * const datacube = Coordinate2BytePtr_hash_get_or_fail(state->Dc2Pointer[int_log(Dataset::current().magnification)], {currentDc.x, currentDc.y, currentDc.z});
-            state->protectCube2Pointer.unlock();
-
-            currentPxInDc_float = currentPx_float - currentDc * Dataset::current().cubeEdgeLength;
-            t_old = t;
-
-            dcSliceExtract(reinterpret_cast<std::uint8_t *>(datacube),
-                           &currentPxInDc_float,
-                           texData.data(),
-                           s, &t,
-                           vp,
-                           state->viewerState->datasetAdjustmentOn);
-            currentPx_float = currentPx_float - vp.v2 * (t - t_old);
-        }
-        s++;
-        rowPx_float += vp.v1;
-        currentPx_float = rowPx_float;
+    const auto mag = Dataset::current().magnification;
+    const int stagingEdge = state->M * Dataset::current().cubeEdgeLength;
+    const std::size_t rowLen = 3 * stagingEdge;// RGB
+    vp.dcStaging.resize(rowLen * stagingEdge);
+
+    static Profiler slicing_profiler;
+    static Profiler upload_profiler;
+
+    slicing_profiler.start(); // ----------------------------------------------------------- profiling
+    // a snapshot of the loaded cubes, so the rows don’t have to lock for every cube they enter
+    coord2bytep_map_t cubes;
+    {
+        QMutexLocker locker(&state->protectCube2Pointer);
+        cubes = state->Dc2Pointer[int_log(mag)];
     }
+    // texture rows go along v1 and advance by -v2
+    const floatCoordinate leftUpperPx = vp.texture.leftUpperPxInAbsPx / mag;
+    std::vector<int> rows(vp.texture.usedSizeInCubePixels);
+    std::iota(std::begin(rows), std::end(rows), 0);
+    QtConcurrent::blockingMap(rows, [this, &vp, &cubes, &leftUpperPx, rowLen](const int row) {
+        dcSliceExtract(cubes, leftUpperPx - vp.v2 * row, vp.dcStaging.data() + row * rowLen, vp, state->viewerState->datasetAdjustmentOn);
+    });
+    slicing_profiler.end(); // ----------------------------------------------------------- profiling
 
-    glTexSubImage2D(GL_TEXTURE_2D,
-                    0,
-                    0,
-                    0,
-                    state->M*Dataset::current().cubeEdgeLength,
-                    state->M*Dataset::current().cubeEdgeLength,
-                    GL_RGB,
-                    GL_UNSIGNED_BYTE,
-                    texData.data());
-
+    upload_profiler.start(); // ----------------------------------------------------------- profiling
+    uploadSlices(vp.texture.texHandle, GL_RGB, vp.dcUploadBuffer, vp.dcStaging, stagingEdge);
     glBindTexture(GL_TEXTURE_2D, 0);
+    upload_profiler.end(); // ----------------------------------------------------------- profiling
+
+    // --------------------- display some profiling information ------------------------
+    // qDebug() << "arb slicing avg time: " << slicing_profiler.average_time()*1000 << "ms";
+    // qDebug() << "arb upload avg time : " << upload_profiler.average_time()*1000 << "ms";
 }
 
 void Viewer::calcLeftUpperTexAbsPx() {
@@ -858,11 +1168,10 @@ void Viewer::run() {
         return;
     }
 
-    // start the timer before the rendering, else render interval and actual rendering time would accumulate
-    if (timer.isActive()) {
-        timer.stop();
-        timer.start(QApplication::activeWindow() != nullptr ? 10 : 1000);// only update once per second if K isn’t the active application
-    }
+    // measure from the start of the frame, else render interval and actual rendering time would accumulate
+    frameTimer.restart();
+    adaptRenderQuality();
+    bool pendingWork = false;
 
     if (viewerState.keyRepeat) {
         const double interval = 1000.0 / viewerState.movementSpeed;
@@ -880,29 +1189,41 @@ void Viewer::run() {
     // might cancel the current loading process. When all textures
     // have been processed, we go into an idle state, in which we wait for events.
     if (state->gpuSlicer && gpuRendering) {
-        const auto & loadPendingCubes = [&](TextureLayer & layer, std::vector<std::pair<CoordOfGPUCube, Coordinate>> & pendingCubes, QElapsedTimer & timer) {
-            while (!pendingCubes.empty() && !timer.hasExpired(3)) {
-                const auto pair = pendingCubes.back();
-                pendingCubes.pop_back();
-                if (layer.textures.find(pair.first) == std::end(layer.textures)) {
-                    const auto globalCoord = pair.first.cube2Global(gpucubeedge, Dataset::current().magnification);
-                    const auto cubeCoord = globalCoord.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
-                    state->protectCube2Pointer.lock();
-                    const auto * ptr = Coordinate2BytePtr_hash_get_or_fail((layer.isOverlayData ? state->Oc2Pointer : state->Dc2Pointer)[int_log(Dataset::current().magnification)], cubeCoord);
-                    state->protectCube2Pointer.unlock();
-                    if (ptr != nullptr) {
-                        layer.cubeSubArray(ptr, Dataset::current().cubeEdgeLength, gpucubeedge, pair.first, pair.second);
-                    }
+        const auto mag = Dataset::current().magnification;
+        const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+        const auto supercubeedge = state->M * cubeEdgeLen / gpucubeedge - (cubeEdgeLen / gpucubeedge - 1);
+        for (auto & layer : layers) {
+            // cubes are prepared and uploaded by the layer’s streaming thread, finished ones are picked up here
+            for (auto & streamed : layer.takeStreamedCubes()) {
+                const auto globalCoord = streamed.first.cube2Global(gpucubeedge, mag);
+                const bool outdatedLut = layer.isOverlayData && static_cast<gpu_lut_cube &>(*streamed.second).lutGeneration != layer.lut.generation;
+                if (!outdatedLut && layer.textures.count(streamed.first) == 0 && currentlyVisible(globalCoord, viewerState.currentPosition, supercubeedge, gpucubeedge)) {
+                    layer.adopt(streamed.first, std::move(streamed.second));
+                } else {
+                    layer.recycle(std::move(streamed.second));
                 }
             }
-        };
-
-        QElapsedTimer timer;
-        timer.start();
-        for (auto & layer : layers) {
             calculateMissingOrthoGPUCubes(layer);
-            loadPendingCubes(layer, layer.pendingOrthoCubes, timer);
-            loadPendingCubes(layer, layer.pendingArbCubes, timer);
+            auto & arbCubes = layer.pendingArbCubes;
+            arbCubes.erase(std::remove_if(std::begin(arbCubes), std::end(arbCubes), [&layer](const std::pair<CoordOfGPUCube, Coordinate> & pair){
+                return layer.textures.count(pair.first) != 0;
+            }), std::end(arbCubes));
+            std::vector<TextureLayer::CubeRequest> requests;
+            const auto & pos = viewerState.currentPosition;
+            const auto gpuEdge = gpucubeedge * mag;
+            for (const auto * pendingCubes : {&arbCubes, &layer.pendingOrthoCubes}) {
+                for (const auto & pair : *pendingCubes) {
+                    const auto globalCoord = pair.first.cube2Global(gpucubeedge, mag);
+                    const auto onSlice = [gpuEdge](const int cube, const int position){ return cube <= position && position < cube + gpuEdge; };
+                    const bool onPlane = pendingCubes == &arbCubes || onSlice(globalCoord.x, pos.x) || onSlice(globalCoord.y, pos.y) || onSlice(globalCoord.z, pos.z);
+                    const floatCoordinate center{globalCoord.x + 0.5f * gpuEdge - pos.x, globalCoord.y + 0.5f * gpuEdge - pos.y, globalCoord.z + 0.5f * gpuEdge - pos.z};
+                    const auto distance = center.x * center.x + center.y * center.y + center.z * center.z;
+                    requests.push_back({pair.first, globalCoord.cube(cubeEdgeLen, mag), pair.second, int_log(mag), onPlane, distance});
+                }
+            }
+            layer.retryMissingCubes((layer.isOverlayData ? ocCubeArrivals : dcCubeArrivals).load());
+            layer.request(std::move(requests));
+            pendingWork |= layer.isStreaming();
         }
     }
 
@@ -911,6 +1232,40 @@ void Viewer::run() {
     });
     window->viewport3D.get()->update();
     window->updateTitlebar(); //display changes after filename
+
+    // keep going while something is still in motion or waiting to be uploaded
+    pendingWork |= viewerState.keyRepeat;
+    pendingWork |= viewerState.reducedQuality;// restore full quality once motion stops
+    pendingWork |= state->skeletonState->definedSkeletonVpView != SKELVP_CUSTOM || state->skeletonState->rotdx != 0 || state->skeletonState->rotdy != 0;
+    if (pendingWork) {
+        requestFrame();
+    }
+}
+
+/**
+ * @brief Viewer::adaptRenderQuality switches to reduced quality while the position changes, the 3D view rotates or keys repeat
+ * and a frame time target is set. The resolution fraction is adapted to the paint time of the previous reduced frame.
+ * The first frame without motion is rendered at full quality again.
+ */
+void Viewer::adaptRenderQuality() {
+    const bool rotating = state->skeletonState->definedSkeletonVpView != SKELVP_CUSTOM || state->skeletonState->rotdx != 0 || state->skeletonState->rotdy != 0;
+    const bool moving = movedSinceLastFrame || viewerState.keyRepeat || rotating;
+    movedSinceLastFrame = false;
+    if (viewerState.frameTimeTarget > 0 && moving) {
+        if (viewerState.reducedQuality && framePaintTime > 0) {
+            const auto frameTime = framePaintTime / 1e6;// ms
+            if (frameTime > viewerState.frameTimeTarget) {
+                viewerState.renderScale *= 0.8f;
+            } else if (frameTime < 0.6 * viewerState.frameTimeTarget) {
+                viewerState.renderScale *= 1.1f;
+            }
+            viewerState.renderScale = std::max(0.25f, std::min(viewerState.renderScale, 1.f));
+        }
+        viewerState.reducedQuality = true;
+    } else {
+        viewerState.reducedQuality = false;
+    }
+    framePaintTime = 0;
 }
 
 void Viewer::applyTextureFilterSetting(const GLint texFiltering) {
@@ -993,7 +1348,6 @@ void Viewer::userMoveVoxels(const Coordinate & step, UserMoveType userMoveType,
     if (state->gpuSlicer && newPosition_gpudc != lastPosition_gpudc) {
         const auto supercubeedge = state->M * Dataset::current().cubeEdgeLength / gpucubeedge - (Dataset::current().cubeEdgeLength / gpucubeedge - 1);
         for (auto & layer : layers) {
-            layer.ctx.makeCurrent(&layer.surface);
             std::vector<CoordOfGPUCube> obsoleteCubes;
             for (const auto & pair : layer.textures) {
                 const auto pos = pair.first;
@@ -1003,7 +1357,21 @@ void Viewer::userMoveVoxels(const Coordinate & step, UserMoveType userMoveType,
                 }
             }
             for (const auto & pos : obsoleteCubes) {
-                layer.textures.erase(pos);
+                layer.recycle(pos);
+            }
+            // cubes that left the supercube are not streamed anymore
+            const auto outOfSight = [this, supercubeedge](const CoordOfGPUCube & gpuCoord) {
+                return !currentlyVisible(gpuCoord.cube2Global(gpucubeedge, Dataset::current().magnification), viewerState.currentPosition, supercubeedge, gpucubeedge);
+            };
+            layer.cancelRequests([&outOfSight](const TextureLayer::CubeRequest & request){ return outOfSight(request.gpuCoord); });
+            layer.pendingArbCubes.erase(std::remove_if(std::begin(layer.pendingArbCubes), std::end(layer.pendingArbCubes), [&outOfSight](const std::pair<CoordOfGPUCube, Coordinate> & pair){
+                return outOfSight(pair.first);
+            }), std::end(layer.pendingArbCubes));
+            if (layer.isOverlayData && layer.lut.nearlyFull()) {// ids of cubes out of sight are only dropped with all indices
+                while (!layer.textures.empty()) {
+                    layer.recycle(std::begin(layer.textures)->first);
+                }
+                layer.lut.clear();
             }
             calculateMissingOrthoGPUCubes(layer);
         }
@@ -1051,33 +1419,53 @@ void Viewer::calculateMissingOrthoGPUCubes(TextureLayer & layer) {
 }
 
 void Viewer::dc_reslice_notify_all(const Coordinate coord) {
-    if (currentlyVisibleWrapWrap(state->viewerState->currentPosition, coord)) {
-        dc_reslice_notify_visible();
+    ++dcCubeArrivals;
+    if (currentlyVisibleWrapWrap(state->viewerState->currentPosition, coord)) {// only the tile of this cube changed
+        const auto cubeCoord = coord.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
+        for (auto * vp : {viewportXY, viewportXZ, viewportZY}) {
+            QMutexLocker locker(&vp->dirtyCubesMutex);
+            vp->dcDirtyCubes.emplace(cubeCoord);
+        }
     }
     window->viewportArb->dcResliceNecessary = true;//arb visibility is not tested
+    requestFrame();
 }
 
 void Viewer::dc_reslice_notify_visible() {
+    ++dcCubeArrivals;
     window->forEachOrthoVPDo([](ViewportOrtho & vpOrtho) {
         vpOrtho.dcResliceNecessary = true;
     });
+    requestFrame();
 }
 
 void Viewer::oc_reslice_notify_all(const Coordinate coord) {
-    if (currentlyVisibleWrapWrap(state->viewerState->currentPosition, coord)) {
-        oc_reslice_notify_visible();
+    ++ocCubeArrivals;
+    const auto cubeCoord = coord.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
+    if (currentlyVisibleWrapWrap(state->viewerState->currentPosition, coord)) {// only the tile of this cube changed
+        for (auto * vp : {viewportXY, viewportXZ, viewportZY}) {
+            QMutexLocker locker(&vp->dirtyCubesMutex);
+            vp->ocDirtyCubes.emplace(cubeCoord);
+        }
     }
     window->viewportArb->ocResliceNecessary = true;//arb visibility is not tested
+    {// only changed cubes are sampled again for the volume texture
+        QMutexLocker locker(&window->viewport3D->volumeDirtyMutex);
+        window->viewport3D->volumeDirtyCubes.emplace(cubeCoord);
+    }
     // if anything has changed, update the volume texture data
     Segmentation::singleton().volume_update_required = true;
+    requestFrame();
 }
 
 void Viewer::oc_reslice_notify_visible() {
+    ++ocCubeArrivals;
     window->forEachOrthoVPDo([](ViewportOrtho & vpOrtho) {
         vpOrtho.ocResliceNecessary = true;
     });
     // if anything has changed, update the volume texture data
     Segmentation::singleton().volume_update_required = true;
+    requestFrame();
 }
 
 void Viewer::recalcTextureOffsets() {
@@ -1163,6 +1551,11 @@ void Viewer::datasetColorAdjustmentsChanged() {
         }
     }
     state->viewerState->datasetAdjustmentOn = state->viewerState->datasetColortableOn || state->viewerState->luminanceBias > 0 || state->viewerState->luminanceRangeDelta < MAX_COLORVAL;
+    auto & rgb = state->viewerState->datasetAdjustmentRgb;
+    rgb.fill(0);
+    for (std::size_t i = 0; i < std::min<std::size_t>(256, state->viewerState->datasetAdjustmentTable.size()); ++i) {
+        std::tie(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]) = state->viewerState->datasetAdjustmentTable[i];
+    }
 
     dc_reslice_notify_visible();
 }
@@ -24,6 +24,7 @@
 #define VIEWER_H
 
 #include "functions.h"
+#include "hashtable.h"
 #include "remote.h"
 #include "slicer/gpucuber.h"
 #include "usermove.h"
@@ -40,6 +41,8 @@
 #include <QQuaternion>
 #include <QTimer>
 
+#include <array>
+#include <atomic>
 #include <vector>
 
 enum TreeDisplay {
@@ -109,8 +112,10 @@ struct ViewerState {
     bool showOnlyRawData{false};
     std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> datasetColortable;//user LUT
     std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> datasetAdjustmentTable;//final LUT used during slicing
+    std::array<std::uint8_t, 256 * 3> datasetAdjustmentRgb{};//datasetAdjustmentTable as flat rgb triples for the slicing kernels
     bool datasetColortableOn{false};
     bool datasetAdjustmentOn{false};
+    bool arbTrilinearFiltering{false};// interpolate arbitrary viewport slices trilinearly instead of nearest neighbour
     // skeleton rendering options
     float depthCutOff{5.f};
     QFlags<TreeDisplay> skeletonDisplay{TreeDisplay::ShowIn3DVP, TreeDisplay::ShowInOrthoVPs};
@@ -140,6 +145,10 @@ struct ViewerState {
     bool showZYplane{true};
     bool showArbplane{true};
     bool showVpDecorations{true};
+    bool framePacing{true};// render at most once per display refresh
+    int frameTimeTarget{0};// ms, reduce resolution and skeleton detail while moving if frames take longer, 0 disables it
+    bool reducedQuality{false};// current frame is rendered with reduced quality, see Viewer::adaptRenderQuality
+    float renderScale{1.f};// fraction of the viewport resolution used for reduced quality frames
     // temporary vertex buffers that are available for rendering, get cleared every frame
     struct {
         std::vector<floatCoordinate> vertices;
@@ -161,6 +170,7 @@ struct ViewerState {
  */
 class Skeletonizer;
 class ViewportBase;
+
 class Viewer : public QObject {
     const bool evilHack;
     Q_OBJECT
@@ -174,10 +184,19 @@ private:
 
     void vpGenerateTexture(ViewportArb & vp);
 
-    void dcSliceExtract(std::uint8_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, ViewportOrtho & vp, bool useCustomLUT);
-    void dcSliceExtract(std::uint8_t * datacube, floatCoordinate *currentPxInDc_float, std::uint8_t * slice, int s, int *t, ViewportArb &vp, bool useCustomLUT);
+    void dcSliceExtract(std::uint8_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, const std::size_t texRowLen, ViewportOrtho & vp, bool useCustomLUT, const bool transposed = false);
+    void dcSliceExtract(const coord2bytep_map_t & cubes, const floatCoordinate rowStartPx, std::uint8_t * row, ViewportArb & vp, bool useCustomLUT);
+
+    void ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, const std::size_t texRowLen, ViewportOrtho & vp);
 
-    void ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, ViewportOrtho & vp);
+    bool suspended{false};
+    std::atomic_bool frameRequestQueued{false};
+    std::atomic<std::size_t> dcCubeArrivals{0};// counts the reslice notifications, gpu cubes missing their cpu cube are retried after them
+    std::atomic<std::size_t> ocCubeArrivals{0};
+    QElapsedTimer frameTimer;
+    int frameDelay() const;
+    bool movedSinceLastFrame{false};
+    void adaptRenderQuality();
 
     void calcLeftUpperTexAbsPx();
 
@@ -190,8 +209,10 @@ public:
     template<typename F, typename... Args>
     auto suspend(F func, Args... args) {
         timer.stop();
+        suspended = true;
         auto && res = func(args...);
-        timer.start();
+        suspended = false;
+        requestFrame();
         return res;
     }
     void saveSettings();
@@ -208,7 +229,9 @@ public:
     ViewportArb *viewportArb;
     void zoom(const float factor);
     void zoomReset();
-    QTimer timer;
+    QTimer timer;// single shot, started by requestFrame
+    qint64 framePaintTime{0};// ns of CPU time the viewports spent painting the last frame, GPU execution is not included
+    bool eventFilter(QObject * watched, QEvent * event) override;
 
     void arbCubes(ViewportArb & vp);
     void setEnableArbVP(const bool on);
@@ -239,6 +262,7 @@ public slots:
     void calcDisplayedEdgeLength();
     void applyTextureFilterSetting(const GLint texFiltering);
     void run();
+    void requestFrame();
     void loader_notify(const UserMoveType userMoveType = USERMOVE_NEUTRAL, const floatCoordinate & direction = {0, 0, 0});
     void defaultDatasetLUT();
     void loadDatasetLUT(const QString & path);
@@ -96,16 +96,21 @@ const QString SHOW_NODE_COMMENTS = "show_node_comments";
 
 // Preferences Dataset & Segmentation Tab
 const QString BIAS = "bias";
+const QString DATASET_ARB_TRILINEAR_FILTERING = "dataset_arb_trilinear_filtering";
 const QString DATASET_LINEAR_FILTERING = "dataset_linear_filtering";
 const QString DATASET_LUT_FILE = "dataset_lut_file";
 const QString DATASET_LUT_FILE_USED = "dataset_lut_file_used";
+const QString DATASET_TRANSPOSED_CUBES_BUDGET = "dataset_transposed_cubes_budget";
 const QString RANGE_DELTA = "range_delta";
 const QString SEGMENTATION_OVERLAY_ALPHA = "segmentation_overlay_alpha";
 const QString SEGMENTATITION_HIGHLIGHT_BORDER = "segmentation_border_highlighting";
+const QString SEGMENTATION_BINARY_MERGELIST = "segmentation_binary_mergelist";
 
 // Preferences Viewports Tab
 const QString ADD_ARB_VP = "add_arb_vp";
 const QString DRAW_INTERSECTIONS_CROSSHAIRS = "draw_intersections_crosshairs";
+const QString FRAME_PACING = "frame_pacing";
+const QString FRAME_TIME_TARGET = "frame_time_target";
 const QString RENDER_VOLUME = "render_volume";
 const QString ROTATION_CENTER = "rotation_center2";// rotation_center was used with different values in 4.1.2 ini
 const QString SHOW_ARB_PLANE = "show_arb_plane";
@@ -117,6 +122,7 @@ const QString SHOW_XZ_PLANE = "show_xz_plane";
 const QString SHOW_ZY_PLANE = "show_zy_plane";
 const QString VOLUME_ALPHA = "volume_alpha";
 const QString VOLUME_BACKGROUND_COLOR = "volume_background_color";
+const QString VOLUME_RAY_STEPS = "volume_ray_steps";
 const QString VP_TAB_INDEX = "vp_tab_index";
 
 // Mainwindow
@@ -29,6 +29,7 @@
 #include "mainwindow.h"
 #include "network.h"
 #include "scriptengine/scripting.h"
+#include "segmentation/editjournal.h"
 #include "skeleton/node.h"
 #include "skeleton/skeleton_dfs.h"
 #include "skeleton/skeletonizer.h"
@@ -627,6 +628,27 @@ void MainWindow::createMenus() {
     shrinkBrushAction = &addApplicationShortcut(actionMenu, QIcon(), tr("Decrease Brush Size (Shift + Scroll)"), &Segmentation::singleton(),
                                                 []() { Segmentation::singleton().brush.setRadius(Segmentation::singleton().brush.getRadius() - 1); }, Qt::SHIFT + Qt::Key_Minus);
 
+    auto journalStep = [this](bool (EditJournal::*step)(), const QString & failure) {
+        if (!(EditJournal::singleton().*step)()) {
+            activityLabel.setText(failure);
+            activityLabel.setVisible(true);
+            activityAnimation.setDirection(QAbstractAnimation::Forward);
+            activityAnimation.start();
+        }
+    };
+    undoVoxelEditAction = &addApplicationShortcut(actionMenu, QIcon(), tr("Undo Voxel Edit"), this, [journalStep]() {
+        journalStep(&EditJournal::undo, tr("Undo needs the edited area loaded in its magnification"));
+    }, Qt::CTRL + Qt::Key_Z);
+    redoVoxelEditAction = &addApplicationShortcut(actionMenu, QIcon(), tr("Redo Voxel Edit"), this, [journalStep]() {
+        journalStep(&EditJournal::redo, tr("Redo needs the edited area loaded in its magnification"));
+    }, Qt::CTRL + Qt::SHIFT + Qt::Key_Z);
+    auto updateJournalActions = [this]() {
+        undoVoxelEditAction->setEnabled(EditJournal::singleton().canUndo());
+        redoVoxelEditAction->setEnabled(EditJournal::singleton().canRedo());
+    };
+    QObject::connect(&EditJournal::singleton(), &EditJournal::changed, this, updateJournalActions);
+    updateJournalActions();
+
     actionMenu.addSeparator();
     clearMergelistAction = actionMenu.addAction(QIcon(":/resources/icons/menubar/trash.png"), "Clear Merge List", &Segmentation::singleton(), SLOT(clear()));
     //proof reading mode
@@ -990,6 +1012,9 @@ void MainWindow::setWorkMode(AnnotationMode workMode) {
         workMode = AnnotationMode::Mode_Tracing;
     }
     modeCombo.setCurrentIndex(workModeModel.indexOf(workMode));
+    if (viewportXY != nullptr) {
+        forEachOrthoVPDo([](ViewportOrtho & vp) { vp.endBrushStroke(); });
+    }
     auto & mode = Session::singleton().annotationMode;
     mode = workMode;
     const bool trees = mode.testFlag(AnnotationMode::Mode_TracingAdvanced) || mode.testFlag(AnnotationMode::Mode_MergeTracing);
@@ -1012,6 +1037,8 @@ void MainWindow::setWorkMode(AnnotationMode workMode) {
     decreaseOpacityAction->setVisible(segmentation);
     enlargeBrushAction->setVisible(mode.testFlag(AnnotationMode::Brush));
     shrinkBrushAction->setVisible(mode.testFlag(AnnotationMode::Brush));
+    undoVoxelEditAction->setVisible(segmentation);
+    redoVoxelEditAction->setVisible(segmentation);
     clearMergelistAction->setVisible(segmentation && !mode.testFlag(AnnotationMode::Mode_MergeTracing));
 
     if (mode.testFlag(AnnotationMode::Mode_MergeTracing) && state->skeletonState->activeNode != nullptr) {// sync subobject and node selection
@@ -1506,7 +1533,7 @@ void MainWindow::updateCompressionRatioDisplay() {
 
 bool MainWindow::event(QEvent *event) {
     if (event->type() == QEvent::WindowActivate) {
-        state->viewer->run();
+        state->viewer->requestFrame();
     }
     return QMainWindow::event(event);
 }
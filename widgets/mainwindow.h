@@ -129,6 +129,8 @@ class MainWindow : public QMainWindow {
     QAction *increaseOpacityAction;
     QAction *enlargeBrushAction;
     QAction *shrinkBrushAction;
+    QAction *undoVoxelEditAction;
+    QAction *redoVoxelEditAction;
     // convenience mode switch actions for proof reading mode
     QAction *modeSwitchSeparator{nullptr};
     QAction *setMergeModeAction{nullptr};
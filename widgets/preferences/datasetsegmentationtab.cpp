@@ -23,6 +23,7 @@
 #include "datasetsegmentationtab.h"
 
 #include "gui_wrapper.h"
+#include "loader.h"
 #include "segmentation/segmentation.h"
 #include "stateInfo.h"
 #include "viewer.h"
@@ -40,6 +41,12 @@ DatasetAndSegmentationTab::DatasetAndSegmentationTab(QWidget *parent) : QWidget(
     rangeDeltaSlider.setRange(1, 255);
     rangeDeltaSpinBox.setRange(1, 255);
 
+    transposedCubesSpinBox.setRange(0, 1024 * 1024);
+    transposedCubesSpinBox.setSuffix(" MiB");
+    transposedCubesSpinBox.setSpecialValueText("Off");
+    transposedCubesSpinBox.setToolTip("Memory for xz and zy ordered copies of raw cubes, speeds up slicing in the xz and zy viewports.\n"
+                                      "Applies to newly loaded cubes, memory is kept until the dataset is reloaded.");
+
     overlayGroup.setCheckable(true);
     segmentationOverlaySpinBox.setRange(0, 255);
     segmentationOverlaySlider.setRange(0, 255);
@@ -48,15 +55,19 @@ DatasetAndSegmentationTab::DatasetAndSegmentationTab(QWidget *parent) : QWidget(
     volumeColorButton.setStyleSheet("background-color : " + Segmentation::singleton().volume_background_color.name() + ";");
     volumeOpaquenessSpinBox.setRange(0, 255);
     volumeOpaquenessSlider.setRange(0, 255);
+    volumeRayStepsSpinBox.setRange(16, 4096);
+    volumeRayStepsSpinBox.setToolTip("Samples along each ray through the volume, fewer steps render faster but coarser.");
 
     segmentationBorderHighlight.setCheckable(true);
 
     // dataset
     int row = 0;
     datasetLayout.addWidget(&datasetLinearFilteringCheckBox, row++, 0, 1, 2);
+    datasetLayout.addWidget(&arbTrilinearFilteringCheckBox, row++, 0, 1, 2);
     datasetLayout.addWidget(&useOwnDatasetColorsCheckBox, row, 0); datasetLayout.addWidget(&useOwnDatasetColorsButton, row++, 1, Qt::AlignLeft);
     datasetLayout.addWidget(&biasLabel, row, 0); datasetLayout.addWidget(&biasSlider, row, 1); datasetLayout.addWidget(&biasSpinBox, row++, 2);
     datasetLayout.addWidget(&rangeDeltaLabel, row, 0); datasetLayout.addWidget(&rangeDeltaSlider, row, 1); datasetLayout.addWidget(&rangeDeltaSpinBox, row++, 2);
+    datasetLayout.addWidget(&transposedCubesLabel, row, 0); datasetLayout.addWidget(&transposedCubesSpinBox, row++, 2);
     datasetLayout.setAlignment(Qt::AlignTop);
     datasetGroup.setLayout(&datasetLayout);
     // segmentation
@@ -69,10 +80,12 @@ DatasetAndSegmentationTab::DatasetAndSegmentationTab(QWidget *parent) : QWidget(
     row = 0;
     volumeLayout.addWidget(&volumeOpaquenessLabel, row, 0); volumeLayout.addWidget(&volumeOpaquenessSlider, row, 1); volumeLayout.addWidget(&volumeOpaquenessSpinBox, row, 2);
     volumeLayout.addWidget(&volumeColorLabel, ++row, 0); volumeLayout.addWidget(&volumeColorButton, row, 1, Qt::AlignLeft);
+    volumeLayout.addWidget(&volumeRayStepsLabel, ++row, 0); volumeLayout.addWidget(&volumeRayStepsSpinBox, row, 2);
     volumeGroup.setLayout(&volumeLayout);
 
     segmentationLayout.addWidget(&overlayGroup);
     segmentationLayout.addWidget(&volumeGroup);
+    segmentationLayout.addWidget(&binaryMergelistCheckBox);
     segmentationGroup.setLayout(&segmentationLayout);
     mainLayout.addWidget(&datasetGroup);
     mainLayout.addWidget(&segmentationGroup);
@@ -85,6 +98,10 @@ DatasetAndSegmentationTab::DatasetAndSegmentationTab(QWidget *parent) : QWidget(
             state->viewer->applyTextureFilterSetting(GL_NEAREST);
         }
     });
+    QObject::connect(&arbTrilinearFilteringCheckBox, &QCheckBox::clicked, [](const bool checked) {
+        state->viewerState->arbTrilinearFiltering = checked;
+        state->viewer->dc_reslice_notify_visible();
+    });
     QObject::connect(&useOwnDatasetColorsCheckBox, &QCheckBox::clicked, [this](const bool checked) {
         if (checked) {//load file if none is cached
             useOwnDatasetColorsButtonClicked(lutFilePath);
@@ -113,6 +130,9 @@ DatasetAndSegmentationTab::DatasetAndSegmentationTab(QWidget *parent) : QWidget(
         rangeDeltaSlider.setValue(value);
         state->viewer->datasetColorAdjustmentsChanged();
     });
+    QObject::connect(&transposedCubesSpinBox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged), [](const int value) {
+        Loader::Controller::singleton().setTransposedCubesBudget(value * 1024ull * 1024);
+    });
 
     QObject::connect(state->viewer, &Viewer::layerVisibilityChanged, [this](const int index) {
         if (index == 1) {
@@ -134,6 +154,9 @@ DatasetAndSegmentationTab::DatasetAndSegmentationTab(QWidget *parent) : QWidget(
         Segmentation::singleton().highlightBorder = checked;
         state->viewer->oc_reslice_notify_visible();
     });
+    QObject::connect(&binaryMergelistCheckBox, &QCheckBox::clicked, [](const bool checked) {
+        Segmentation::singleton().binaryMergelist = checked;
+    });
     QObject::connect(&volumeGroup, &QGroupBox::clicked, [this](bool checked){
         Segmentation::singleton().volume_render_toggle = checked;
         emit volumeRenderToggled();
@@ -157,6 +180,10 @@ DatasetAndSegmentationTab::DatasetAndSegmentationTab(QWidget *parent) : QWidget(
         Segmentation::singleton().volume_opacity = value;
         Segmentation::singleton().volume_update_required = true;
     });
+    QObject::connect(&volumeRayStepsSpinBox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged), [](const int value){
+        Segmentation::singleton().volume_ray_steps = value;
+        state->viewer->requestFrame();
+    });
 
     QObject::connect(&state->viewer->mainWindow, &MainWindow::overlayOpacityChanged, [this]() { segmentationOverlaySlider.setValue(Segmentation::singleton().alpha); });
 }
@@ -183,15 +210,19 @@ void DatasetAndSegmentationTab::saveSettings() const {
     QSettings settings;
     settings.beginGroup(PREFERENCES_WIDGET);
     settings.setValue(DATASET_LINEAR_FILTERING, datasetLinearFilteringCheckBox.isChecked());
+    settings.setValue(DATASET_ARB_TRILINEAR_FILTERING, arbTrilinearFilteringCheckBox.isChecked());
     settings.setValue(BIAS, biasSpinBox.value());
     settings.setValue(RANGE_DELTA, rangeDeltaSpinBox.value());
+    settings.setValue(DATASET_TRANSPOSED_CUBES_BUDGET, transposedCubesSpinBox.value());
     settings.setValue(SEGMENTATION_OVERLAY_ALPHA, segmentationOverlaySlider.value());
     settings.setValue(SEGMENTATITION_HIGHLIGHT_BORDER, segmentationBorderHighlight.isChecked());
+    settings.setValue(SEGMENTATION_BINARY_MERGELIST, binaryMergelistCheckBox.isChecked());
     settings.setValue(DATASET_LUT_FILE, lutFilePath);
     settings.setValue(DATASET_LUT_FILE_USED, useOwnDatasetColorsCheckBox.isChecked());
     settings.setValue(RENDER_VOLUME, volumeGroup.isChecked());
     settings.setValue(VOLUME_ALPHA, volumeOpaquenessSpinBox.value());
     settings.setValue(VOLUME_BACKGROUND_COLOR, Segmentation::singleton().volume_background_color);
+    settings.setValue(VOLUME_RAY_STEPS, volumeRayStepsSpinBox.value());
 }
 
 void DatasetAndSegmentationTab::loadSettings() {
@@ -199,6 +230,8 @@ void DatasetAndSegmentationTab::loadSettings() {
     settings.beginGroup(PREFERENCES_WIDGET);
     datasetLinearFilteringCheckBox.setChecked(settings.value(DATASET_LINEAR_FILTERING, true).toBool());
     datasetLinearFilteringCheckBox.clicked(datasetLinearFilteringCheckBox.isChecked());
+    arbTrilinearFilteringCheckBox.setChecked(settings.value(DATASET_ARB_TRILINEAR_FILTERING, false).toBool());
+    arbTrilinearFilteringCheckBox.clicked(arbTrilinearFilteringCheckBox.isChecked());
     lutFilePath = settings.value(DATASET_LUT_FILE, "").toString();
     // again, load the path-string first, before populating the checkbox
     useOwnDatasetColorsCheckBox.setChecked(settings.value(DATASET_LUT_FILE_USED, false).toBool());
@@ -207,14 +240,20 @@ void DatasetAndSegmentationTab::loadSettings() {
     biasSpinBox.valueChanged(biasSpinBox.value());
     rangeDeltaSpinBox.setValue(settings.value(RANGE_DELTA, 255).toInt());
     rangeDeltaSpinBox.valueChanged(rangeDeltaSpinBox.value());
+    transposedCubesSpinBox.setValue(settings.value(DATASET_TRANSPOSED_CUBES_BUDGET, 0).toInt());
+    transposedCubesSpinBox.valueChanged(transposedCubesSpinBox.value());
     segmentationOverlaySlider.setValue(settings.value(SEGMENTATION_OVERLAY_ALPHA, 37).toInt());
     segmentationOverlaySlider.valueChanged(segmentationOverlaySlider.value());
     segmentationBorderHighlight.setChecked(settings.value(SEGMENTATITION_HIGHLIGHT_BORDER, true).toBool());
     segmentationBorderHighlight.clicked(segmentationBorderHighlight.isChecked());
+    binaryMergelistCheckBox.setChecked(settings.value(SEGMENTATION_BINARY_MERGELIST, false).toBool());
+    binaryMergelistCheckBox.clicked(binaryMergelistCheckBox.isChecked());
     volumeGroup.setChecked(settings.value(RENDER_VOLUME, false).toBool());
     volumeGroup.clicked(volumeGroup.isChecked());
     volumeOpaquenessSpinBox.setValue(settings.value(VOLUME_ALPHA, 37).toInt());
     volumeOpaquenessSpinBox.valueChanged(volumeOpaquenessSpinBox.value());
     Segmentation::singleton().volume_background_color = settings.value(VOLUME_BACKGROUND_COLOR, QColor(Qt::darkGray)).value<QColor>();
     volumeColorButton.setStyleSheet("background-color: " + Segmentation::singleton().volume_background_color.name() + ";");
+    volumeRayStepsSpinBox.setValue(settings.value(VOLUME_RAY_STEPS, 256).toInt());
+    volumeRayStepsSpinBox.valueChanged(volumeRayStepsSpinBox.value());
 }
@@ -45,12 +45,15 @@ class DatasetAndSegmentationTab : public QWidget
     QGroupBox datasetGroup{tr("Dataset")};
     QGridLayout datasetLayout;
     QCheckBox datasetLinearFilteringCheckBox{"Enable linear filtering"};
+    QCheckBox arbTrilinearFilteringCheckBox{"Trilinear interpolation in arbitrary viewports"};
     QCheckBox useOwnDatasetColorsCheckBox{"Use own dataset colors"};
     QPushButton useOwnDatasetColorsButton{"Load …"};
     QString lutFilePath;
     QLabel datasetDynamicRangeLabel{"Dataset dynamic range"}, biasLabel{"Bias"}, rangeDeltaLabel{"Range delta"};
     QSpinBox biasSpinBox, rangeDeltaSpinBox;
     QSlider biasSlider{Qt::Horizontal}, rangeDeltaSlider{Qt::Horizontal};
+    QLabel transposedCubesLabel{"Transposed cube copies"};
+    QSpinBox transposedCubesSpinBox;
     // segmentation overlay
     QGroupBox segmentationGroup{tr("Segmentation")};
     QVBoxLayout segmentationLayout;
@@ -60,6 +63,7 @@ class DatasetAndSegmentationTab : public QWidget
     QSpinBox segmentationOverlaySpinBox;
     QSlider segmentationOverlaySlider{Qt::Horizontal};
     QCheckBox segmentationBorderHighlight{"Highlight borders"};
+    QCheckBox binaryMergelistCheckBox{"Save mergelist in binary format (faster to load, needs a recent KNOSSOS)"};
     // segmentation volume
     QGroupBox volumeGroup{"Show volume in 3D viewport"};
     QGridLayout volumeLayout;
@@ -68,6 +72,8 @@ class DatasetAndSegmentationTab : public QWidget
     QSlider volumeOpaquenessSlider{Qt::Horizontal};
     QLabel volumeColorLabel{"Volume background color"};
     QPushButton volumeColorButton;
+    QLabel volumeRayStepsLabel{"Ray steps"};
+    QSpinBox volumeRayStepsSpinBox;
 
     void useOwnDatasetColorsButtonClicked(QString path = "");
     void saveSettings() const;
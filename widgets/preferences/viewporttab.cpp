@@ -38,6 +38,15 @@ ViewportTab::ViewportTab(QWidget *parent) : QWidget(parent) {
     generalLayout.addWidget(&showVPDecorationCheckBox);
     generalLayout.addWidget(&drawIntersectionsCrossHairCheckBox);
     generalLayout.addWidget(&addArbVPCheckBox);
+    generalLayout.addWidget(&framePacingCheckBox);
+    frameTimeTargetSpinBox.setRange(0, 1000);
+    frameTimeTargetSpinBox.setSuffix(" ms");
+    frameTimeTargetSpinBox.setSpecialValueText("Off");
+    frameTimeTargetSpinBox.setToolTip("Frame time target: while moving, viewports are rendered at reduced resolution and skeleton detail if painting takes longer.\n"
+                                      "Only the CPU time spent submitting a frame is measured, not the time the GPU needs to draw it.");
+    frameTimeTargetLayout.addWidget(&frameTimeTargetLabel);
+    frameTimeTargetLayout.addWidget(&frameTimeTargetSpinBox);
+    generalLayout.addLayout(&frameTimeTargetLayout);
     generalBox.setLayout(&generalLayout);
 
     planesLayout.addWidget(&showXYPlaneCheckBox);
@@ -72,6 +81,8 @@ ViewportTab::ViewportTab(QWidget *parent) : QWidget(parent) {
         state->viewerState->enableArbVP = on;
         state->viewer->viewportArb->setVisible(on);
     });
+    QObject::connect(&framePacingCheckBox, &QCheckBox::clicked, [](const bool on) { state->viewerState->framePacing = on; });
+    QObject::connect(&frameTimeTargetSpinBox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged), [](const int value) { state->viewerState->frameTimeTarget = value; });
     QObject::connect(state->viewer, &Viewer::enabledArbVP, [this] (const bool on) {
         addArbVPCheckBox.setChecked(on);
         addArbVPCheckBox.clicked(on);
@@ -97,6 +108,8 @@ void ViewportTab::saveSettings(QSettings & settings) const {
     settings.setValue(SHOW_VP_DECORATION, showVPDecorationCheckBox.isChecked());
     settings.setValue(DRAW_INTERSECTIONS_CROSSHAIRS, drawIntersectionsCrossHairCheckBox.isChecked());
     settings.setValue(ADD_ARB_VP, addArbVPCheckBox.isChecked());
+    settings.setValue(FRAME_PACING, framePacingCheckBox.isChecked());
+    settings.setValue(FRAME_TIME_TARGET, frameTimeTargetSpinBox.value());
     settings.setValue(SHOW_XY_PLANE, showXYPlaneCheckBox.isChecked());
     settings.setValue(SHOW_XZ_PLANE, showXZPlaneCheckBox.isChecked());
     settings.setValue(SHOW_ZY_PLANE, showZYPlaneCheckBox.isChecked());
@@ -114,6 +127,10 @@ void ViewportTab::loadSettings(const QSettings & settings) {
     drawIntersectionsCrossHairCheckBox.clicked(drawIntersectionsCrossHairCheckBox.isChecked());
     addArbVPCheckBox.setChecked(settings.value(ADD_ARB_VP, false).toBool());
     addArbVPCheckBox.clicked(addArbVPCheckBox.isChecked());
+    framePacingCheckBox.setChecked(settings.value(FRAME_PACING, true).toBool());
+    framePacingCheckBox.clicked(framePacingCheckBox.isChecked());
+    frameTimeTargetSpinBox.setValue(settings.value(FRAME_TIME_TARGET, 0).toInt());
+    frameTimeTargetSpinBox.valueChanged(frameTimeTargetSpinBox.value());
     showXYPlaneCheckBox.setChecked(settings.value(SHOW_XY_PLANE, true).toBool());
     showXYPlaneCheckBox.clicked(showXYPlaneCheckBox.isChecked());
     showXZPlaneCheckBox.setChecked(settings.value(SHOW_XZ_PLANE, true).toBool());
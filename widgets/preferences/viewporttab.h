@@ -31,6 +31,7 @@
 #include <QPushButton>
 #include <QRadioButton>
 #include <QSettings>
+#include <QSpinBox>
 #include <QVBoxLayout>
 #include <QWidget>
 
@@ -47,6 +48,10 @@ class ViewportTab : public QWidget {
     QCheckBox showVPDecorationCheckBox{"Show viewport decorations"};
     QCheckBox drawIntersectionsCrossHairCheckBox{"Draw intersection crosshairs"};
     QCheckBox addArbVPCheckBox{"Add viewport with arbitrary view"};
+    QCheckBox framePacingCheckBox{"Limit frame rate to display refresh rate"};
+    QHBoxLayout frameTimeTargetLayout;
+    QLabel frameTimeTargetLabel{"Reduce quality while moving above CPU paint time"};
+    QSpinBox frameTimeTargetSpinBox;
     // 3D viewport
     QGroupBox viewport3DBox{tr("3D viewport")};
     QVBoxLayout viewport3DLayout;
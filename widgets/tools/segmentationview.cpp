@@ -75,6 +75,7 @@ bool TouchedObjectModel::setData(const QModelIndex & index, const QVariant & val
 void TouchedObjectModel::recreate() {
     beginResetModel();
     objectCache = Segmentation::singleton().touchedObjects();
+    voxelCountsValid = false;
     endResetModel();
 }
 
@@ -109,7 +110,8 @@ QVariant SegmentationObjectModel::objectGet(const Segmentation::Object &obj, con
         case 3: return obj.category;
         case 4: return obj.comment;
         case 5: return static_cast<quint64>(obj.subobjects.size());
-        case 6: {
+        case 6: return voxelCount(obj);
+        case 7: {
             QString output;
             const auto limit = role != Qt::UserRole && obj.subobjects.size() > MAX_SHOWN_SUBOBJECTS;
             const auto elemCount = limit ? MAX_SHOWN_SUBOBJECTS : obj.subobjects.size();
@@ -129,6 +131,14 @@ QVariant SegmentationObjectModel::objectGet(const Segmentation::Object &obj, con
     return QVariant();//return invalid QVariant
 }
 
+quint64 SegmentationObjectModel::voxelCount(const Segmentation::Object & obj) const {
+    if (!voxelCountsValid) {
+        voxelCountCache = Segmentation::singleton().objectVoxelCounts();
+        voxelCountsValid = true;
+    }
+    return obj.index < voxelCountCache.size() ? voxelCountCache[obj.index] : 0;
+}
+
 QVariant SegmentationObjectModel::data(const QModelIndex & index, int role) const {
     if (index.isValid()) {
         const auto & obj = Segmentation::singleton().objects[index.row()];
@@ -140,6 +150,7 @@ QVariant SegmentationObjectModel::data(const QModelIndex & index, int role) cons
 bool SegmentationObjectModel::objectSet(Segmentation::Object & obj, const QModelIndex & index, const QVariant & value, int role) {
     if (index.column() == 2 && role == Qt::CheckStateRole) {
         obj.immutable = value.toBool();
+        Segmentation::singleton().refreshObject(obj);// immutability decides which object is shown
     } else if (role == Qt::DisplayRole || role == Qt::EditRole) {
         switch (index.column()) {
         case 3: Segmentation::singleton().changeCategory(obj, value.toString()); break;
@@ -173,6 +184,7 @@ Qt::ItemFlags SegmentationObjectModel::flags(const QModelIndex & index) const {
 
 void SegmentationObjectModel::recreate() {
     beginResetModel();
+    voxelCountsValid = false;
     endResetModel();
 }
 
@@ -185,17 +197,27 @@ void SegmentationObjectModel::popRowBegin() {
 }
 
 void SegmentationObjectModel::appendRow() {
+    voxelCountsValid = false;
     endInsertRows();
 }
 
 void SegmentationObjectModel::popRow() {
+    voxelCountsValid = false;
     endRemoveRows();
 }
 
 void SegmentationObjectModel::changeRow(int idx) {
+    voxelCountsValid = false;// subobjects may have changed
     emit dataChanged(index(idx, 0), index(idx, columnCount()-1));
 }
 
+void SegmentationObjectModel::voxelCountsChanged() {
+    voxelCountsValid = false;
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 6), index(rowCount() - 1, 6));
+    }
+}
+
 void CategoryModel::recreate() {
     beginResetModel();
     categoriesCache.clear();
@@ -330,6 +352,17 @@ SegmentationView::SegmentationView(QWidget * const parent) : QWidget(parent), ca
         objectsTable.resizeColumnToContents(index);
     }
 
+    voxelCountTimer.setSingleShot(true);
+    voxelCountTimer.setInterval(1000);// cubes are published one by one while loading
+    QObject::connect(&VoxelStatsIndex::singleton(), &VoxelStatsIndex::changed, this, [this](){
+        if (!voxelCountTimer.isActive()) {
+            voxelCountTimer.start();
+        }
+    });
+    QObject::connect(&voxelCountTimer, &QTimer::timeout, [this](){
+        objectModel.voxelCountsChanged();
+        touchedObjectModel.voxelCountsChanged();
+    });
     QObject::connect(&Segmentation::singleton(), &Segmentation::beforeAppendRow, &objectModel, &SegmentationObjectModel::appendRowBegin);
     QObject::connect(&Segmentation::singleton(), &Segmentation::beforeRemoveRow, [this](){
         objectSelectionProtection = true;
@@ -38,6 +38,7 @@
 #include <QSpinBox>
 #include <QSortFilterProxyModel>
 #include <QStyledItemDelegate>
+#include <QTimer>
 #include <QTreeView>
 #include <QVBoxLayout>
 #include <QWidget>
@@ -56,8 +57,11 @@ class SegmentationObjectModel : public QAbstractListModel {
 Q_OBJECT
     friend class SegmentationView;//selection
 protected:
-    const std::vector<QString> header{""/*color*/, "Object ID", "Lock", "Category", "Comment", "#", "Subobject IDs"};
+    const std::vector<QString> header{""/*color*/, "Object ID", "Lock", "Category", "Comment", "#", "Voxels", "Subobject IDs"};
     const std::size_t MAX_SHOWN_SUBOBJECTS = 10;
+    mutable std::vector<uint64_t> voxelCountCache;// by object index, refilled at once so sorting by size doesn’t rescan
+    mutable bool voxelCountsValid{false};
+    quint64 voxelCount(const Segmentation::Object & obj) const;
 public:
     virtual int rowCount(const QModelIndex & parent = QModelIndex()) const override;
     virtual int columnCount(const QModelIndex & parent = QModelIndex()) const override;
@@ -73,6 +77,7 @@ public:
     void appendRow();
     void popRow();
     void changeRow(int idx);
+    void voxelCountsChanged();
 };
 
 class TouchedObjectModel : public SegmentationObjectModel {
@@ -133,6 +138,7 @@ Q_OBJECT
     QLabel subobjectHoveredLabel;
 
     QColorDialog colorDialog{this};
+    QTimer voxelCountTimer;
 
     bool objectSelectionProtection = false;
     bool touchedObjectSelectionProtection = false;
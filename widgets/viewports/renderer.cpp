@@ -36,6 +36,7 @@
 #include "stateInfo.h"
 #include "viewer.h"
 
+#include <QElapsedTimer>
 #include <QMatrix4x4>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLPaintDevice>
@@ -52,6 +53,7 @@
 
 #include <boost/math/constants/constants.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 
@@ -416,6 +418,67 @@ void ViewportBase::renderViewportFrontFace() {
     }
 }
 
+/**
+ * @brief ViewportBase::renderAdaptive executes render either directly or, while the viewer reduces quality during motion,
+ * into an offscreen target with a fraction of the viewport resolution which is then stretched over the viewport.
+ * The CPU time spent is reported to the viewer which adapts the fraction to the frame time target.
+ */
+void ViewportBase::renderAdaptive(const std::function<void()> & render) {
+    QElapsedTimer paintTime;
+    paintTime.start();
+    const auto scale = state->viewerState->reducedQuality ? state->viewerState->renderScale : 1.f;
+    const QSize fullSize = size() * devicePixelRatio();
+    const QSize reducedSize(std::max(1, static_cast<int>(fullSize.width() * scale)), std::max(1, static_cast<int>(fullSize.height() * scale)));
+    if (scale >= 1.f || reducedSize == fullSize) {
+        render();
+    } else {
+        if (!reducedFbo || reducedFbo->size() != reducedSize) {
+            reducedFbo = std::make_shared<QOpenGLFramebufferObject>(reducedSize, QOpenGLFramebufferObject::CombinedDepthStencil);
+        }
+        offscreenFbo = reducedFbo;
+        reducedScale = scale;
+        glPushAttrib(GL_VIEWPORT_BIT);
+        glViewport(0, 0, reducedSize.width(), reducedSize.height());
+        reducedFbo->bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        render();
+        QOpenGLFramebufferObject::bindDefault();
+        glPopAttrib();
+        offscreenFbo.reset();
+        reducedScale = 1.f;
+
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0, 1, 0, 1, -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        glPushAttrib(GL_ENABLE_BIT);
+        glDisable(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_LIGHTING);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, reducedFbo->texture());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glColor4f(1, 1, 1, 1);
+        glBegin(GL_QUADS);
+            glTexCoord2f(0, 0); glVertex2f(0, 0);
+            glTexCoord2f(1, 0); glVertex2f(1, 0);
+            glTexCoord2f(1, 1); glVertex2f(1, 1);
+            glTexCoord2f(0, 1); glVertex2f(0, 1);
+        glEnd();
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPopAttrib();
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+    }
+    state->viewer->framePaintTime += paintTime.nsecsElapsed();
+}
+
 void ViewportOrtho::renderViewportFrontFace() {
     ViewportBase::renderViewportFrontFace();
     switch(viewportType) {
@@ -523,6 +586,73 @@ void ViewportBase::renderScaleBar() {
     renderText(Coordinate(min.x + scalebarLenPx / 2, min.y, min.z), sizeLabel, true, true);
 }
 
+/**
+ * @brief ViewportOrtho::gpuDrawList returns the cubes of the layer that intersect the slice with their model matrices.
+ *      It is only rebuilt when the position crosses a gpu cube boundary, the orientation or the layer’s textures change.
+ */
+const std::vector<ViewportOrtho::GpuCubeDraw> & ViewportOrtho::gpuDrawList(TextureLayer & layer, const floatCoordinate & cpos, const float scale) {
+    const bool xy = viewportType == VIEWPORT_XY;
+    const bool xz = viewportType == VIEWPORT_XZ;
+    const bool zy = viewportType == VIEWPORT_ZY;
+    const bool arb = viewportType == VIEWPORT_ARBITRARY;
+    const float gpucubeedge = state->viewer->gpucubeedge;
+    const auto fov = (state->M - 1) * Dataset::current().cubeEdgeLength / (arb ? std::sqrt(2) : 1);//remove cpu overlap
+    const auto gpusupercube = fov / gpucubeedge + 1;//add gpu overlap
+    const float halfsc = fov * 0.5f / gpucubeedge;
+    const float offsetx = cpos.x / gpucubeedge - halfsc * !zy;
+    const float offsety = cpos.y / gpucubeedge - halfsc * !xz;
+    const float offsetz = cpos.z / gpucubeedge - halfsc * !xy;
+    const floatCoordinate origin{std::floor(offsetx), std::floor(offsety), std::floor(offsetz)};
+
+    auto & list = gpuDrawLists[&layer];
+    if (list.valid && list.texturesRevision == layer.texturesRevision && list.v1 == v1 && list.v2 == v2 && list.n == n && (arb || list.origin == origin)) {
+        return list.draws;
+    }
+    list.valid = true;
+    list.texturesRevision = layer.texturesRevision;
+    list.v1 = v1;
+    list.v2 = v2;
+    list.n = n;
+    list.origin = origin;
+    list.draws.clear();
+    if (!arb) {
+        const float endx = zy ? 1 : gpusupercube;
+        const float endy = xz ? 1 : gpusupercube;
+        const float endz = xy ? 1 : gpusupercube;
+        for (float z = 0; z < endz; ++z)
+        for (float y = 0; y < endy; ++y)
+        for (float x = 0; x < endx; ++x) {
+            const auto pos = CoordOfGPUCube(offsetx + x, offsety + y, offsetz + z);
+            auto it = layer.textures.find(pos);
+            auto * cube = it != std::end(layer.textures) ? it->second.get() : layer.bogusCube.get();
+
+            QMatrix4x4 modelMatrix;
+            modelMatrix.translate(pos.x * gpucubeedge, pos.y * gpucubeedge, pos.z * gpucubeedge);
+            modelMatrix.scale(1, 1 - 2*(zy + xy), 1 - 2*xz);// HACK still don’t know
+            modelMatrix.rotate(QQuaternion::fromAxes(v1, v2, n));
+            list.draws.push_back({cube, modelMatrix, {}, {}});
+        }
+    } else {
+        for (auto & pair : layer.textures) {
+            auto & pos = pair.first;
+            auto & cube = *pair.second;
+            if (!cube.vertices.empty()) {
+                GpuCubeDraw draw{&cube, {}, {}, {}};
+                for (const auto & vertex : cube.vertices) {
+                    draw.triangleVertices.push_back({{vertex.x, vertex.y, vertex.z * scale}});
+                    const auto depthOffset = static_cast<float>(vertex.z - pos.z * gpucubeedge);
+                    const auto texR = (0.5f + depthOffset) / gpucubeedge;
+                    draw.textureVertices.push_back({{static_cast<float>(vertex.x - pos.x * gpucubeedge) / gpucubeedge
+                                                     , static_cast<float>(vertex.y - pos.y * gpucubeedge) / gpucubeedge
+                                                     , texR}});
+                }
+                list.draws.emplace_back(std::move(draw));
+            }
+        }
+    }
+    return list.draws;
+}
+
 void ViewportOrtho::renderViewportFast() {
     if (state->viewer->layers.empty()) {
         return;
@@ -542,7 +672,6 @@ void ViewportOrtho::renderViewportFast() {
     const bool arb = viewportType == VIEWPORT_ARBITRARY;
     const float gpucubeedge = state->viewer->gpucubeedge;
     const auto fov = (state->M - 1) * Dataset::current().cubeEdgeLength / (arb ? std::sqrt(2) : 1);//remove cpu overlap
-    const auto gpusupercube = fov / gpucubeedge + 1;//add gpu overlap
     floatCoordinate cpos = state->viewerState->currentPosition;
     const auto scale = Dataset::current().scale.z / Dataset::current().scale.x;
     if (arb) {
@@ -557,9 +686,7 @@ void ViewportOrtho::renderViewportFast() {
     triangleVertices.push_back({{0.0f, gpucubeedge, 0.0f}});
     std::vector<std::array<GLfloat, 3>> textureVertices;
     textureVertices.reserve(6);
-    for (float z = 0.0f; z < (xy ? 1 : gpusupercube); ++z)
-    for (float y = 0.0f; y < (xz ? 1 : gpusupercube); ++y)
-    for (float x = 0.0f; x < (zy ? 1 : gpusupercube); ++x) {
+    {// the same slice of every ortho cube is drawn
         const float frame = std::fmod(xy ? cpos.z : xz ? cpos.y : cpos.x, state->viewer->gpucubeedge);
         const auto texR = (0.5f + frame) / gpucubeedge;
 
@@ -626,67 +753,27 @@ void ViewportOrtho::renderViewportFast() {
             if (layer.isOverlayData) {
                 overlay_data_shader.bind();
                 overlay_data_shader.setUniformValue("textureOpacity", Segmentation::singleton().alpha / 256.0f);
+                layer.lut.upload();
+                layer.lut.texture.bind(1);
+                overlay_data_shader.setUniformValue("lutSize", static_cast<float>(layer.lut.texture.width()));
             } else {
                 raw_data_shader.bind();
                 raw_data_shader.setUniformValue("textureOpacity", layer.opacity);
             }
 
-            auto render = [&](auto & cube, const QMatrix4x4 modelMatrix = {}){
-                if (layer.isOverlayData) {
-                    auto & punned = static_cast<gpu_lut_cube&>(cube);
-                    punned.cube.bind(0);
-                    punned.lut.bind(1);
-                    overlay_data_shader.setUniformValue("model_matrix", modelMatrix);
-                    overlay_data_shader.setUniformValue("lutSize", static_cast<float>(punned.lut.width() * punned.lut.height() * punned.lut.depth()));
-                } else {
-                    raw_data_shader.setUniformValue("model_matrix", modelMatrix);
-                    cube.cube.bind(0);
-                }
-                glDrawArrays(GL_TRIANGLE_FAN, 0, static_cast<int>(triangleVertices.size()));
-            };
-            if (!arb) {
-                const float halfsc = fov * 0.5f / gpucubeedge;
-                const float offsetx = cpos.x / gpucubeedge - halfsc * !zy;
-                const float offsety = cpos.y / gpucubeedge - halfsc * !xz;
-                const float offsetz = cpos.z / gpucubeedge - halfsc * !xy;
-                const float startx = 0 * cpos.x / gpucubeedge;
-                const float starty = 0 * cpos.y / gpucubeedge;
-                const float startz = 0 * cpos.z / gpucubeedge;
-                const float endx = startx + (zy ? 1 : gpusupercube);
-                const float endy = starty + (xz ? 1 : gpusupercube);
-                const float endz = startz + (xy ? 1 : gpusupercube);
-                for (float z = startz; z < endz; ++z)
-                for (float y = starty; y < endy; ++y)
-                for (float x = startx; x < endx; ++x) {
-                    const auto pos = CoordOfGPUCube(offsetx + x, offsety + y, offsetz + z);
-                    auto it = layer.textures.find(pos);
-                    auto & ptr = it != std::end(layer.textures) ? *it->second : *layer.bogusCube;
-
-                    QMatrix4x4 modelMatrix;
-                    modelMatrix.translate(pos.x * gpucubeedge, pos.y * gpucubeedge, pos.z * gpucubeedge);
-                    modelMatrix.scale(1, 1 - 2*(zy + xy), 1 - 2*xz);// HACK still don’t know
-                    modelMatrix.rotate(QQuaternion::fromAxes(v1, v2, n));
-
-                    render(ptr, modelMatrix);
-                }
-            } else {
-                for (auto & pair : layer.textures) {
-                    auto & pos = pair.first;
-                    auto & cube = *pair.second;
-                    if (!cube.vertices.empty()) {
-                        triangleVertices.clear();
-                        textureVertices.clear();
-                        for (const auto & vertex : cube.vertices) {
-                            triangleVertices.push_back({{vertex.x, vertex.y, vertex.z * scale}});
-                            const auto depthOffset = static_cast<float>(vertex.z - pos.z * gpucubeedge);
-                            const auto texR = (0.5f + depthOffset) / gpucubeedge;
-                            textureVertices.push_back({{static_cast<float>(vertex.x - pos.x * gpucubeedge) / gpucubeedge
-                                                        , static_cast<float>(vertex.y - pos.y * gpucubeedge) / gpucubeedge
-                                                        , texR}});
-                        }
-                        render(cube);
-                    }
+            auto & shader = layer.isOverlayData ? overlay_data_shader : raw_data_shader;
+            const auto vertexAttribute = layer.isOverlayData ? overtexLocation : vertexLocation;
+            const auto texAttribute = layer.isOverlayData ? otexLocation : texLocation;
+            for (const auto & draw : gpuDrawList(layer, cpos, scale)) {
+                auto vertexCount = static_cast<int>(triangleVertices.size());
+                if (arb) {
+                    shader.setAttributeArray(vertexAttribute, draw.triangleVertices.data()->data(), 3);
+                    shader.setAttributeArray(texAttribute, draw.textureVertices.data()->data(), 3);
+                    vertexCount = static_cast<int>(draw.triangleVertices.size());
                 }
+                draw.cube->cube.bind(0);
+                shader.setUniformValue("model_matrix", draw.modelMatrix);
+                glDrawArrays(GL_TRIANGLE_FAN, 0, vertexCount);
             }
         }
     }
@@ -851,8 +938,8 @@ void ViewportOrtho::renderViewport(const RenderOptions &options) {
         glMatrixMode(GL_PROJECTION);
         glPopMatrix();
         glMatrixMode(GL_MODELVIEW);
-        if (auto snapshotFboPtr = snapshotFbo.lock()) {
-            snapshotFboPtr->bind();
+        if (auto offscreenFboPtr = offscreenFbo.lock()) {
+            offscreenFboPtr->bind();
         } else {
             QOpenGLFramebufferObject::bindDefault();
         }
@@ -900,16 +987,11 @@ void Viewport3D::renderVolumeVP() {
         static float translationSpeedAdjust = 1.0 / 500.0f;
         auto cubeLen = Dataset::current().cubeEdgeLength;
         int texLen = seg.volume_tex_len;
-        GLuint volTexId = seg.volume_tex_id;
 
         static Profiler render_profiler;
 
         render_profiler.start(); // ----------------------------------------------------------- profiling
 
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        glOrtho(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f);
-
         // volume viewport rotation
         static QMatrix4x4 volRotMatrix;
         float rotdx = state->skeletonState->rotdx;
@@ -939,75 +1021,48 @@ void Viewport3D::renderVolumeVP() {
 
         // dataset scaling adjustment
         auto datascale = Dataset::current().scale;
-        float biggestScale = 0.0f;
-        if(datascale.x > datascale.y) {
-            biggestScale = datascale.x;
-        } else {
-            biggestScale = datascale.y;
-        }
-        if(datascale.z > biggestScale) {
-            biggestScale = datascale.z;
-        }
-
-        float smallestScale = 0.0f;
-        if(datascale.x < datascale.y) {
-            smallestScale = datascale.x;
-        } else {
-            smallestScale = datascale.y;
-        }
-        if(datascale.z < smallestScale) {
-            smallestScale = datascale.z;
-        }
-        float maxScaleRatio = biggestScale / smallestScale;
+        const float biggestScale = std::max({datascale.x, datascale.y, datascale.z});
         float scalex = 1.0f / (datascale.x / biggestScale);
         float scaley = 1.0f / (datascale.y / biggestScale);
         float scalez = 1.0f / (datascale.z / biggestScale);
 
-        glMatrixMode(GL_TEXTURE);
-        glLoadIdentity();
-
+        // maps the screen slab (s, t, depth) to volume texture coordinates, depth 1 is in front
+        QMatrix4x4 textureMatrix;
         // dataset translation adjustment
-        glTranslatef((static_cast<float>(state->viewerState->currentPosition.x % cubeLen) / cubeLen - 0.5f) / state->M,
-                     (static_cast<float>(state->viewerState->currentPosition.y % cubeLen) / cubeLen - 0.5f) / state->M,
-                     (static_cast<float>(state->viewerState->currentPosition.z % cubeLen) / cubeLen - 0.5f) / state->M);
-
-        glTranslatef(0.5f, 0.5f, 0.5f);
-        glScalef(volumeClippingAdjust, volumeClippingAdjust, volumeClippingAdjust); // scale to remove cube corner clipping
-        glScalef(scalex, scaley, scalez); // dataset scaling adjustment
-        glMultMatrixf(volRotMatrix.data()); // volume viewport rotation
-        glScalef(1.0f/zoom, 1.0f/zoom, 1.0f/zoom*2.0f); // volume viewport zoom
-        glTranslatef(-0.5f, -0.5f, -0.5f);
-        glTranslatef(transx, transy, 0.0f); // volume viewport translation
-
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_TEXTURE_3D);
-
-        glBindTexture(GL_TEXTURE_3D, volTexId);
-        float volume_opacity = seg.volume_opacity / 255.0f;
-        for(int i = 0; i < texLen * volumeClippingAdjust * maxScaleRatio; ++i) {
-            float depth = i/(texLen * volumeClippingAdjust * maxScaleRatio);
-            glColor4f(depth, depth, depth, volume_opacity);
-            glBegin(GL_QUADS);
-                glTexCoord3f(0.0f, 1.0f, depth);
-                glVertex3f(-1.0f, -1.0f,  1.0f-depth*2.0f);
-                glTexCoord3f(1.0f, 1.0f, depth);
-                glVertex3f( 1.0f, -1.0f,  1.0f-depth*2.0f);
-                glTexCoord3f(1.0f, 0.0f, depth);
-                glVertex3f( 1.0f,  1.0f,  1.0f-depth*2.0f);
-                glTexCoord3f(0.0f, 0.0f, depth);
-                glVertex3f(-1.0f,  1.0f,  1.0f-depth*2.0f);
-            glEnd();
-        }
-
-        glMatrixMode(GL_TEXTURE);
-        glLoadIdentity();
-        glMatrixMode(GL_MODELVIEW);
+        textureMatrix.translate((static_cast<float>(state->viewerState->currentPosition.x % cubeLen) / cubeLen - 0.5f) / state->M,
+                                (static_cast<float>(state->viewerState->currentPosition.y % cubeLen) / cubeLen - 0.5f) / state->M,
+                                (static_cast<float>(state->viewerState->currentPosition.z % cubeLen) / cubeLen - 0.5f) / state->M);
+        textureMatrix.translate(0.5f, 0.5f, 0.5f);
+        textureMatrix.scale(volumeClippingAdjust); // scale to remove cube corner clipping
+        textureMatrix.scale(scalex, scaley, scalez); // dataset scaling adjustment
+        textureMatrix *= volRotMatrix; // volume viewport rotation
+        textureMatrix.scale(1.0f/zoom, 1.0f/zoom, 1.0f/zoom*2.0f); // volume viewport zoom
+        textureMatrix.translate(-0.5f, -0.5f, -0.5f);
+        textureMatrix.translate(transx, transy, 0.0f); // volume viewport translation
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_3D, seg.volume_occupancy_tex_id);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_3D, seg.volume_tex_id);
+
+        // one screen filling quad, every fragment marches its own ray
+        const std::array<std::array<GLfloat, 2>, 4> quadVertices{{{{-1.0f, -1.0f}}, {{1.0f, -1.0f}}, {{-1.0f, 1.0f}}, {{1.0f, 1.0f}}}};
+        volumeShader.bind();
+        const int vertexLocation = volumeShader.attributeLocation("vertex");
+        volumeShader.enableAttributeArray(vertexLocation);
+        volumeShader.setAttributeArray(vertexLocation, quadVertices.data()->data(), 2);
+        volumeShader.setUniformValue("volumeTexture", 0);
+        volumeShader.setUniformValue("occupancyTexture", 1);
+        volumeShader.setUniformValue("texture_matrix", textureMatrix);
+        volumeShader.setUniformValue("stepCount", seg.volume_ray_steps);
+        volumeShader.setUniformValue("referenceSteps", texLen * volumeClippingAdjust);
+        volumeShader.setUniformValue("occupancyBlocks", static_cast<float>(texLen / seg.volume_occupancy_block));
+        volumeShader.setUniformValue("opacity", seg.volume_opacity / 255.0f);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        volumeShader.disableAttributeArray(vertexLocation);
+        volumeShader.release();
 
         // Reset previously changed OGL parameters
-        glDisable(GL_TEXTURE_3D);
         glEnable(GL_TEXTURE_2D);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         glDisable(GL_LIGHTING);
@@ -1016,14 +1071,7 @@ void Viewport3D::renderVolumeVP() {
         render_profiler.end(); // ----------------------------------------------------------- profiling
 
         // --------------------- display some profiling information ------------------------
-        // static auto timer = std::chrono::steady_clock::now();
-        // std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timer;
-        // if(duration.count() > 1.0) {
-        //     qDebug() << "render  avg time: " <<  render_profiler.average_time()*1000 << "ms";
-        //     qDebug() << "---------------------------------------------";
-
-        //     timer = std::chrono::steady_clock::now();
-        // }
+        // qDebug() << "volume render avg time: " << render_profiler.average_time()*1000 << "ms";
     }
 }
 
@@ -1031,10 +1079,7 @@ void Viewport3D::renderViewport(const RenderOptions &options) {
     auto& seg = Segmentation::singleton();
     if (seg.volume_render_toggle) {
         if (!options.nodePicking) {
-            if(seg.volume_update_required) {
-                seg.volume_update_required = false;
-                updateVolumeTexture();
-            }
+            updateVolumeTexture();
             renderVolumeVP();
         }
     } else {
@@ -1406,7 +1451,7 @@ void Viewport3D::renderSkeletonVP(const RenderOptions &options) {
 
     std::array<GLint, 4> vp;
     glGetIntegerv(GL_VIEWPORT, vp.data());
-    edgeLength = vp[2]/devicePixelRatio(); // retrieve adjusted size for snapshot
+    edgeLength = vp[2]/devicePixelRatio()/reducedScale; // retrieve adjusted size for snapshot
     displayedlengthInNmX = 2.0 * zoomedHalfBoundary;
     screenPxXPerDataPx = edgeLength / displayedlengthInNmX;
     const auto left = state->skeletonState->translateX - zoomedHalfBoundary;
@@ -1928,6 +1973,8 @@ void ViewportBase::renderSkeleton(const RenderOptions &options) {
 
     glPushMatrix();
 
+    // while moving with reduced quality more nodes are culled (lines and points mode is still decided by the setting alone)
+    const auto cumDistRenderThres = state->viewerState->cumDistRenderThres * (state->viewerState->reducedQuality ? 4 : 1);
     const auto * activeTree = state->skeletonState->activeTree;
     const auto * activeNode = state->skeletonState->activeNode;
     const auto * activeSynapse = (activeNode && activeNode->isSynapticNode) ? activeNode->correspondingSynapse :
@@ -1990,7 +2037,7 @@ void ViewportBase::renderSkeleton(const RenderOptions &options) {
                         //Node is a candidate for LOD culling
                         //Do we really skip this node? Test cum dist. to last rendered node!
                         cumDistToLastRenderedNode += currentSegment.length * screenPxXPerDataPx;
-                        if ((cumDistToLastRenderedNode <= state->viewerState->cumDistRenderThres) && options.enableLoddingAndLinesAndPoints) {
+                        if ((cumDistToLastRenderedNode <= cumDistRenderThres) && options.enableLoddingAndLinesAndPoints) {
                             nodeVisible = false;
                         }
                         break;
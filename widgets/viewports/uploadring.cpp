@@ -0,0 +1,94 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#include "uploadring.h"
+
+#include <QDebug>
+
+bool UploadRing::initialize(QOpenGLContext & context) {
+    const bool supported = context.format().version() >= qMakePair(4, 4)
+            || (context.hasExtension("GL_ARB_buffer_storage") && context.hasExtension("GL_ARB_sync") && context.format().version() >= qMakePair(3, 0));
+    if (!supported) {
+        return false;
+    }
+    bufferStorage = reinterpret_cast<BufferStorage>(context.getProcAddress("glBufferStorage"));
+    mapBufferRange = reinterpret_cast<MapBufferRange>(context.getProcAddress("glMapBufferRange"));
+    fenceSync = reinterpret_cast<FenceSync>(context.getProcAddress("glFenceSync"));
+    clientWaitSync = reinterpret_cast<ClientWaitSync>(context.getProcAddress("glClientWaitSync"));
+    deleteSync = reinterpret_cast<DeleteSync>(context.getProcAddress("glDeleteSync"));
+    if (bufferStorage == nullptr || mapBufferRange == nullptr || fenceSync == nullptr || clientWaitSync == nullptr || deleteSync == nullptr) {
+        bufferStorage = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void UploadRing::waitFor(const std::size_t slot) {
+    if (fences[slot] != nullptr) {
+        const auto result = clientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000 * 1000);// 1 s
+        if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) {
+            qWarning() << "upload ring: waiting for slot" << slot << "failed";
+        }
+        deleteSync(fences[slot]);
+        fences[slot] = nullptr;
+    }
+}
+
+/**
+ * @brief UploadRing::acquire advances to the next slot and returns its mapped memory once the gpu is done reading from it.
+ * The storage is recreated if the slots are not of the requested size. Has to be followed by fence().
+ */
+std::uint8_t * UploadRing::acquire(const std::size_t bytes) {
+    if (slotSize != bytes) {
+        destroy();
+        slotSize = bytes;
+        buffer.create();
+        buffer.bind();
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(GL_PIXEL_UNPACK_BUFFER, slotCount * slotSize, nullptr, flags);
+        mapped = reinterpret_cast<std::uint8_t *>(mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slotCount * slotSize, flags));
+        buffer.release();
+        current = slotCount - 1;
+    }
+    current = (current + 1) % slotCount;
+    waitFor(current);
+    return mapped + offset();
+}
+
+/**
+ * @brief UploadRing::fence places the fence behind all uploads issued from the current slot.
+ */
+void UploadRing::fence() {
+    fences[current] = fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UploadRing::destroy() {
+    if (!buffer.isCreated()) {
+        return;
+    }
+    for (std::size_t slot = 0; slot < slotCount; ++slot) {
+        waitFor(slot);
+    }
+    buffer.destroy();// also unmaps
+    mapped = nullptr;
+    slotSize = 0;
+}
@@ -0,0 +1,70 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2016
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef UPLOADRING_H
+#define UPLOADRING_H
+
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief The UploadRing class is a pixel unpack buffer split into slots which stay persistently mapped.
+ * Slices are written directly into the current slot, uploads from it return without waiting for the transfer
+ * and a slot is handed out again only after the fence placed behind its last uploads has been signaled.
+ * Requires GL_ARB_buffer_storage and GL_ARB_sync (or GL 4.4), isCreated() is false otherwise.
+ */
+class UploadRing {
+    using BufferStorage = void (QOPENGLF_APIENTRYP)(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags);
+    using MapBufferRange = void * (QOPENGLF_APIENTRYP)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    using FenceSync = GLsync (QOPENGLF_APIENTRYP)(GLenum condition, GLbitfield flags);
+    using ClientWaitSync = GLenum (QOPENGLF_APIENTRYP)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+    using DeleteSync = void (QOPENGLF_APIENTRYP)(GLsync sync);
+    BufferStorage bufferStorage{nullptr};
+    MapBufferRange mapBufferRange{nullptr};
+    FenceSync fenceSync{nullptr};
+    ClientWaitSync clientWaitSync{nullptr};
+    DeleteSync deleteSync{nullptr};
+
+    QOpenGLBuffer buffer{QOpenGLBuffer::PixelUnpackBuffer};
+    std::uint8_t * mapped{nullptr};
+    std::size_t slotSize{0};
+    std::size_t current{0};
+    static constexpr std::size_t slotCount = 3;
+    std::array<GLsync, slotCount> fences{};
+
+    void waitFor(const std::size_t slot);
+public:
+    bool initialize(QOpenGLContext & context);
+    bool isCreated() const { return bufferStorage != nullptr; }
+    std::size_t size() const { return slotSize; }
+    std::uint8_t * acquire(const std::size_t bytes);
+    std::size_t offset() const { return current * slotSize; }
+    void bind() { buffer.bind(); }
+    void unbind() { buffer.release(); }
+    void fence();
+    void destroy();
+};
+
+#endif// UPLOADRING_H
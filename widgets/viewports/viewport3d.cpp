@@ -23,11 +23,21 @@
 #include "viewport3d.h"
 
 #include "dataset.h"
+#include "flat_id_map.h"
 #include "profiler.h"
 #include "skeleton/skeletonizer.h"
 #include "stateInfo.h"
 #include "viewer.h"
 
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
 bool Viewport3D::showBoundariesInUm = false;
 
 Viewport3D::Viewport3D(QWidget *parent, ViewportType viewportType) : ViewportBase(parent, viewportType) {
@@ -100,182 +110,275 @@ Viewport3D::Viewport3D(QWidget *parent, ViewportType viewportType) : ViewportBas
         if (wiggle == -2 || wiggle == 2) {
             wiggleDirection = !wiggleDirection;
         }
+        state->viewer->requestFrame();
     });
 }
 
 Viewport3D::~Viewport3D() {
+    volumeBuild.waitForFinished();
     makeCurrent();
     if (Segmentation::singleton().volume_tex_id != 0) {
         glDeleteTextures(1, &Segmentation::singleton().volume_tex_id);
+        glDeleteTextures(1, &Segmentation::singleton().volume_occupancy_tex_id);
     }
     Segmentation::singleton().volume_tex_id = 0;
+    Segmentation::singleton().volume_occupancy_tex_id = 0;
+}
+
+void Viewport3D::initializeGL() {
+    ViewportBase::initializeGL();
+    volumeShader.addShaderFromSourceFile(QOpenGLShader::Vertex, ":/resources/shaders/volume/volumeshader.vert");
+    volumeShader.addShaderFromSourceFile(QOpenGLShader::Fragment, ":/resources/shaders/volume/volumeshader.frag");
+    volumeShader.link();
+    if (!volumeShader.log().isEmpty()) {
+        qDebug() << volumeShader.log();
+    }
 }
 
 void Viewport3D::paintGL() {
     glClear(GL_DEPTH_BUFFER_BIT);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    renderViewport();
+    renderAdaptive([this]() { renderViewport(); });
     renderViewportFrontFace();
 }
 
+/**
+ * @brief Viewport3D::updateVolumeTexture uploads the last finished volume build and starts a new one if required.
+ *      Builds run in the thread pool, so toggling or updating the volume view does not block the gui.
+ */
 void Viewport3D::updateVolumeTexture() {
     auto& seg = Segmentation::singleton();
-    int texLen = seg.volume_tex_len;
-    if(seg.volume_tex_id == 0) {
-        glGenTextures(1, &seg.volume_tex_id);
+    const int texLen = seg.volume_tex_len;
+    const int blocks = texLen / seg.volume_occupancy_block;
+    if (seg.volume_tex_id == 0 || volumeTexLen != texLen) {
+        if (seg.volume_tex_id == 0) {
+            glGenTextures(1, &seg.volume_tex_id);
+            glGenTextures(1, &seg.volume_occupancy_tex_id);
+        }
+        for (const auto texId : {seg.volume_tex_id, seg.volume_occupancy_tex_id}) {
+            glBindTexture(GL_TEXTURE_3D, texId);
+
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        }
         glBindTexture(GL_TEXTURE_3D, seg.volume_tex_id);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, texLen, texLen, texLen, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_3D, seg.volume_occupancy_tex_id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_LUMINANCE, blocks, blocks, blocks, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        volumeTexLen = texLen;
+        volumeUploadPending = false;// a running build has the old size
+        seg.volume_update_required = true;
+    }
 
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    if (volumeUploadPending && volumeBuild.isFinished()) {
+        static Profiler tex_transfer_profiler;
+        tex_transfer_profiler.start(); // ----------------------------------------------------------- profiling
+        glBindTexture(GL_TEXTURE_3D, seg.volume_tex_id);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, texLen, texLen, texLen, GL_RGBA, GL_UNSIGNED_BYTE, volumeColors.data());
+        glBindTexture(GL_TEXTURE_3D, seg.volume_occupancy_tex_id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, blocks, blocks, blocks, GL_LUMINANCE, GL_UNSIGNED_BYTE, volumeOccupancy.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        volumeUploadPending = false;
+        tex_transfer_profiler.end(); // ----------------------------------------------------------- profiling
+        // qDebug() << "    tex transfer: " << tex_transfer_profiler.average_time()*1000 << "ms";
+    }
 
-        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, texLen, texLen, texLen, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    if (!seg.volume_update_required || volumeBuild.isRunning()) {// the finished build requests a frame for the next one
+        return;
     }
+    seg.volume_update_required = false;
+
+    VolumeSource source;
+    source.center = (state->viewerState->currentPosition / Dataset::current().magnification / Dataset::current().cubeEdgeLength).cube(1, 1);
+    source.magIndex = int_log(Dataset::current().magnification);
+    source.cubeEdgeLength = Dataset::current().cubeEdgeLength;
+    source.M = state->M;
+    source.texLen = texLen;
+    source.occupancyBlock = seg.volume_occupancy_block;
+    source.backgroundId = seg.getBackgroundId();
+    source.resampleAll = source.center != volumeCenter || Dataset::current().magnification != volumeMag || volumeIds.size() != static_cast<std::size_t>(texLen * texLen * texLen);
+    {
+        QMutexLocker locker(&volumeDirtyMutex);
+        source.dirtyCubes.assign(std::begin(volumeDirtyCubes), std::end(volumeDirtyCubes));
+        volumeDirtyCubes.clear();
+    }
+    source.colors = seg.selectedSubobjectColors();
+    volumeCenter = source.center;
+    volumeMag = Dataset::current().magnification;
+    volumeUploadPending = true;
+    volumeBuild = QtConcurrent::run([this, source]() {
+        buildVolume(source);
+        state->viewer->requestFrame();
+    });
+}
 
+/**
+ * @brief Viewport3D::buildVolume fills the rgba staging buffer from the overlay cubes around source.center.
+ *      Every texel gets the most frequent non-background id of its footprint, only the cubes that changed are sampled again.
+ */
+void Viewport3D::buildVolume(const VolumeSource & source) {
     static Profiler tex_gen_profiler;
-    static Profiler dcfetch_profiler;
+    static Profiler sample_profiler;
     static Profiler colorfetch_profiler;
     static Profiler occlusion_profiler;
-    static Profiler tex_transfer_profiler;
 
     tex_gen_profiler.start(); // ----------------------------------------------------------- profiling
-    auto currentPosDc = state->viewerState->currentPosition / Dataset::current().magnification / Dataset::current().cubeEdgeLength;
-    int cubeLen = Dataset::current().cubeEdgeLength;
-    int M = state->M;
-    int M_radius = (M - 1) / 2;
-    GLubyte* colcube = new GLubyte[4*texLen*texLen*texLen];
-    std::tuple<uint64_t, std::tuple<uint8_t, uint8_t, uint8_t, uint8_t>> lastIdColor;
-
-    state->protectCube2Pointer.lock();
-
-    dcfetch_profiler.start(); // ----------------------------------------------------------- profiling
-    uint64_t** rawcubes = new uint64_t*[M*M*M];
-    for(int z = 0; z < M; ++z)
-    for(int y = 0; y < M; ++y)
-    for(int x = 0; x < M; ++x) {
-        auto cubeIndex = z*M*M + y*M + x;
-        Coordinate cubeCoordRelative{x - M_radius, y - M_radius, z - M_radius};
-        rawcubes[cubeIndex] = reinterpret_cast<uint64_t*>(
-            Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[int_log(Dataset::current().magnification)],
-            {currentPosDc.x + cubeCoordRelative.x, currentPosDc.y + cubeCoordRelative.y, currentPosDc.z + cubeCoordRelative.z}));
+    const int texLen = source.texLen;
+    const int cubeLen = source.cubeEdgeLength;
+    const int M = source.M;
+    const int M_radius = (M - 1) / 2;
+    const std::size_t texels = static_cast<std::size_t>(texLen) * texLen * texLen;
+    if (volumeIds.size() != texels) {
+        volumeIds.assign(texels, source.backgroundId);
     }
-    dcfetch_profiler.end(); // ----------------------------------------------------------- profiling
-
-    colorfetch_profiler.start(); // ----------------------------------------------------------- profiling
-
-    for(int z = 0; z < texLen; ++z)
-    for(int y = 0; y < texLen; ++y)
-    for(int x = 0; x < texLen; ++x) {
-        Coordinate DcCoord{(x * M)/cubeLen, (y * M)/cubeLen, (z * M)/cubeLen};
-        auto cubeIndex = DcCoord.z*M*M + DcCoord.y*M + DcCoord.x;
-        auto& rawcube = rawcubes[cubeIndex];
-
-        if(rawcube != nullptr) {
-            auto indexInDc  = ((z * M)%cubeLen)*cubeLen*cubeLen + ((y * M)%cubeLen)*cubeLen + (x * M)%cubeLen;
-            auto indexInTex = z*texLen*texLen + y*texLen + x;
-            auto subobjectId = rawcube[indexInDc];
-            if(subobjectId == std::get<0>(lastIdColor)) {
-                auto idColor = std::get<1>(lastIdColor);
-                colcube[4*indexInTex+0] = std::get<0>(idColor);
-                colcube[4*indexInTex+1] = std::get<1>(idColor);
-                colcube[4*indexInTex+2] = std::get<2>(idColor);
-                colcube[4*indexInTex+3] = std::get<3>(idColor);
-            } else if (seg.isSubObjectIdSelected(subobjectId)) {
-                auto idColor = seg.colorObjectFromSubobjectId(subobjectId);
-                std::get<3>(idColor) = 255; // ignore color alpha
-                colcube[4*indexInTex+0] = std::get<0>(idColor);
-                colcube[4*indexInTex+1] = std::get<1>(idColor);
-                colcube[4*indexInTex+2] = std::get<2>(idColor);
-                colcube[4*indexInTex+3] = std::get<3>(idColor);
-                lastIdColor = std::make_tuple(subobjectId, idColor);
-            } else {
-                colcube[4*indexInTex+0] = 0;
-                colcube[4*indexInTex+1] = 0;
-                colcube[4*indexInTex+2] = 0;
-                colcube[4*indexInTex+3] = 0;
+    volumeColors.resize(4 * texels);
+
+    // footprint of each texel along one axis: cube index and voxel range inside that cube (clipped to the cube of its first voxel)
+    struct Span {
+        int cube;
+        int begin;
+        int end;
+    };
+    std::vector<Span> spans(texLen);
+    for (int t = 0; t < texLen; ++t) {
+        const int first = t * M * cubeLen / texLen;
+        const int next = std::max(first + 1, (t + 1) * M * cubeLen / texLen);
+        spans[t] = {first / cubeLen, first % cubeLen, std::min(cubeLen, first % cubeLen + next - first)};
+    }
+    std::vector<Coordinate> cubes;// relative to the lower corner of the M³ cubes
+    if (source.resampleAll) {
+        for (int z = 0; z < M; ++z)
+        for (int y = 0; y < M; ++y)
+        for (int x = 0; x < M; ++x) {
+            cubes.push_back({x, y, z});
+        }
+    } else {
+        for (const auto & cubeCoord : source.dirtyCubes) {
+            const Coordinate relative{cubeCoord.x - source.center.x + M_radius, cubeCoord.y - source.center.y + M_radius, cubeCoord.z - source.center.z + M_radius};
+            if (relative.x >= 0 && relative.x < M && relative.y >= 0 && relative.y < M && relative.z >= 0 && relative.z < M) {
+                cubes.push_back(relative);
             }
-        } else {
-            auto indexInTex = z*texLen*texLen + y*texLen + x;
-            colcube[4*indexInTex+0] = 0;
-            colcube[4*indexInTex+1] = 0;
-            colcube[4*indexInTex+2] = 0;
-            colcube[4*indexInTex+3] = 0;
         }
     }
 
-    delete[] rawcubes;
-
-    state->protectCube2Pointer.unlock();
-
-    colorfetch_profiler.end(); // ----------------------------------------------------------- profiling
-
-    occlusion_profiler.start(); // ----------------------------------------------------------- profiling
-    for(int z = 1; z < texLen - 1; ++z)
-    for(int y = 1; y < texLen - 1; ++y)
-    for(int x = 1; x < texLen - 1; ++x) {
-        auto indexInTex = (z)*texLen*texLen + (y)*texLen + x;
-        if(colcube[4*indexInTex+3] != 0) {
-            for(int xi = -1; xi <= 1; ++xi) {
-                auto othrIndexInTex = (z)*texLen*texLen + (y)*texLen + x+xi;
-                if((xi != 0) && colcube[4*othrIndexInTex+3] != 0) {
-                    colcube[4*indexInTex+0] *= 0.95f;
-                    colcube[4*indexInTex+1] *= 0.95f;
-                    colcube[4*indexInTex+2] *= 0.95f;
-                }
+    sample_profiler.start(); // ----------------------------------------------------------- profiling
+    for (const auto & cube : cubes) {// one cube at a time keeps the lock short, its slabs are sampled in parallel
+        std::vector<int> slabs;
+        for (int z = 0; z < texLen; ++z) {
+            if (spans[z].cube == cube.z) {
+                slabs.push_back(z);
             }
         }
-    }
-
-    for(int z = 1; z < texLen - 1; ++z)
-    for(int y = 1; y < texLen - 1; ++y)
-    for(int x = 1; x < texLen - 1; ++x) {
-        auto indexInTex = (z)*texLen*texLen + (y)*texLen + x;
-        if(colcube[4*indexInTex+3] != 0) {
-            for(int yi = -1; yi <= 1; ++yi) {
-                auto othrIndexInTex = (z)*texLen*texLen + (y+yi)*texLen + x;
-                if((yi != 0) && colcube[4*othrIndexInTex+3] != 0) {
-                    colcube[4*indexInTex+0] *= 0.95f;
-                    colcube[4*indexInTex+1] *= 0.95f;
-                    colcube[4*indexInTex+2] *= 0.95f;
+        QMutexLocker locker(&state->protectCube2Pointer);
+        const CoordOfCube cubeCoord{source.center.x + cube.x - M_radius, source.center.y + cube.y - M_radius, source.center.z + cube.z - M_radius};
+        const auto * data = reinterpret_cast<const std::uint64_t *>(Coordinate2BytePtr_hash_get_or_fail(state->Oc2Pointer[source.magIndex], cubeCoord));
+        QtConcurrent::blockingMap(slabs, [this, &source, &spans, &cube, data, texLen, cubeLen](const int z) {
+            std::vector<std::pair<std::uint64_t, int>> counts;
+            for (int y = 0; y < texLen; ++y)
+            for (int x = 0; x < texLen; ++x) {
+                if (spans[y].cube != cube.y || spans[x].cube != cube.x) {
+                    continue;
+                }
+                auto & id = volumeIds[static_cast<std::size_t>(z) * texLen * texLen + y * texLen + x];
+                id = source.backgroundId;
+                if (data == nullptr) {
+                    continue;
+                }
+                counts.clear();
+                for (int vz = spans[z].begin; vz < spans[z].end; ++vz)
+                for (int vy = spans[y].begin; vy < spans[y].end; ++vy)
+                for (int vx = spans[x].begin; vx < spans[x].end; ++vx) {
+                    const auto voxel = data[vz * cubeLen * cubeLen + vy * cubeLen + vx];
+                    if (voxel != source.backgroundId) {
+                        auto it = std::find_if(std::begin(counts), std::end(counts), [voxel](const std::pair<std::uint64_t, int> & count){ return count.first == voxel; });
+                        if (it != std::end(counts)) {
+                            ++it->second;
+                        } else {
+                            counts.emplace_back(voxel, 1);
+                        }
+                    }
+                }
+                if (!counts.empty()) {
+                    id = std::max_element(std::begin(counts), std::end(counts), [](const std::pair<std::uint64_t, int> & lhs, const std::pair<std::uint64_t, int> & rhs){
+                        return lhs.second < rhs.second;
+                    })->first;
                 }
             }
-        }
+        });
+    }
+    sample_profiler.end(); // ----------------------------------------------------------- profiling
+
+    colorfetch_profiler.start(); // ----------------------------------------------------------- profiling
+    flat_id_map<std::array<std::uint8_t, 4>> colorOfId(source.colors.size());
+    for (const auto & pair : source.colors) {
+        const auto & color = pair.second;
+        colorOfId.emplace(pair.first, {{std::get<0>(color), std::get<1>(color), std::get<2>(color), 255}});// ignore color alpha
     }
+    std::vector<int> slabs(texLen);
+    std::iota(std::begin(slabs), std::end(slabs), 0);
+    QtConcurrent::blockingMap(slabs, [this, &colorOfId, texLen](const int z) {
+        const auto begin = static_cast<std::size_t>(z) * texLen * texLen;
+        for (auto i = begin; i < begin + texLen * texLen; ++i) {
+            const auto * color = colorOfId.find(volumeIds[i]);
+            std::copy_n(color != nullptr ? color->data() : std::array<std::uint8_t, 4>{{}}.data(), 4, &volumeColors[4 * i]);
+        }
+    });
+    colorfetch_profiler.end(); // ----------------------------------------------------------- profiling
 
-    for(int z = 1; z < texLen - 1; ++z)
-    for(int y = 1; y < texLen - 1; ++y)
-    for(int x = 1; x < texLen - 1; ++x) {
-        auto indexInTex = (z)*texLen*texLen + (y)*texLen + x;
-        if(colcube[4*indexInTex+3] != 0) {
-            for(int zi = -1; zi <= 1; ++zi) {
-                auto othrIndexInTex = (z+zi)*texLen*texLen + (y)*texLen + x;
-                if((zi != 0) && colcube[4*othrIndexInTex+3] != 0) {
-                    colcube[4*indexInTex+0] *= 0.95f;
-                    colcube[4*indexInTex+1] *= 0.95f;
-                    colcube[4*indexInTex+2] *= 0.95f;
+    occlusion_profiler.start(); // ----------------------------------------------------------- profiling
+    // darken each voxel once per occupied axis neighbour, only the alpha of the neighbours is read
+    QtConcurrent::blockingMap(slabs, [this, texLen](const int z) {
+        if (z < 1 || z >= texLen - 1) {
+            return;
+        }
+        const std::size_t strides[] = {1, static_cast<std::size_t>(texLen), static_cast<std::size_t>(texLen) * texLen};
+        for (int y = 1; y < texLen - 1; ++y)
+        for (int x = 1; x < texLen - 1; ++x) {
+            const auto indexInTex = z * strides[2] + y * strides[1] + x;
+            if (volumeColors[4 * indexInTex + 3] != 0) {
+                int neighbours = 0;
+                for (const auto stride : strides) {
+                    neighbours += (volumeColors[4 * (indexInTex - stride) + 3] != 0) + (volumeColors[4 * (indexInTex + stride) + 3] != 0);
+                }
+                for (int i = 0; i < neighbours; ++i) {
+                    volumeColors[4 * indexInTex + 0] *= 0.95f;
+                    volumeColors[4 * indexInTex + 1] *= 0.95f;
+                    volumeColors[4 * indexInTex + 2] *= 0.95f;
                 }
             }
         }
-    }
+    });
     occlusion_profiler.end(); // ----------------------------------------------------------- profiling
 
-    tex_transfer_profiler.start(); // ----------------------------------------------------------- profiling
-    glBindTexture(GL_TEXTURE_3D, seg.volume_tex_id);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, texLen, texLen, texLen, 0, GL_RGBA, GL_UNSIGNED_BYTE, colcube);
-    delete[] colcube;
-    tex_transfer_profiler.end(); // ----------------------------------------------------------- profiling
+    const int block = source.occupancyBlock;
+    const int blocks = texLen / block;
+    volumeOccupancy.assign(static_cast<std::size_t>(blocks) * blocks * blocks, 0);
+    std::vector<int> blockSlabs(blocks);
+    std::iota(std::begin(blockSlabs), std::end(blockSlabs), 0);
+    QtConcurrent::blockingMap(blockSlabs, [this, texLen, block, blocks](const int blockZ) {
+        for (int z = blockZ * block; z < (blockZ + 1) * block; ++z)
+        for (int y = 0; y < blocks * block; ++y)
+        for (int x = 0; x < blocks * block; ++x) {
+            if (volumeColors[4 * (static_cast<std::size_t>(z) * texLen * texLen + y * texLen + x) + 3] != 0) {
+                volumeOccupancy[blockZ * blocks * blocks + (y / block) * blocks + x / block] = 255;
+            }
+        }
+    });
 
     tex_gen_profiler.end(); // ----------------------------------------------------------- profiling
 
     // --------------------- display some profiling information ------------------------
     // qDebug() << "tex gen avg time: " << tex_gen_profiler.average_time()*1000 << "ms";
-    // qDebug() << "    dc fetch    : " << dcfetch_profiler.average_time()*1000 << "ms";
+    // qDebug() << "    sampling    : " << sample_profiler.average_time()*1000 << "ms";
     // qDebug() << "    color fetch : " << colorfetch_profiler.average_time()*1000 << "ms";
     // qDebug() << "    occlusion   : " << occlusion_profiler.average_time()*1000 << "ms";
-    // qDebug() << "    tex transfer: " << tex_transfer_profiler.average_time()*1000 << "ms";
     // qDebug() << "---------------------------------------------";
 }
 
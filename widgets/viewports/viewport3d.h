@@ -23,11 +23,20 @@
 #ifndef VIEWPORT3D_H
 #define VIEWPORT3D_H
 
+#include "coordinate.h"
 #include "viewportbase.h"
 
+#include <QFuture>
 #include <QMatrix4x4>
+#include <QMutex>
 #include <QTimer>
 
+#include <cstdint>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 class Viewport3D : public ViewportBase {
     Q_OBJECT
     QPushButton wiggleButton{"w"}, xyButton{"xy"}, xzButton{"xz"}, zyButton{"zy"}, r90Button{"r90"}, r180Button{"r180"}, resetButton{"reset"};
@@ -35,10 +44,34 @@ class Viewport3D : public ViewportBase {
     void resetWiggle();
     virtual void zoom(const float zoomStep) override;
     virtual float zoomStep() const override;
+    virtual void initializeGL() override;
     virtual void paintGL() override;
     bool wiggleDirection{true};
     int wiggle{0};
     QTimer wiggletimer;
+    // everything buildVolume needs, collected in the gui thread
+    struct VolumeSource {
+        CoordOfCube center;
+        std::size_t magIndex;
+        int cubeEdgeLength;
+        int M;
+        int texLen;
+        int occupancyBlock;
+        std::uint64_t backgroundId;
+        bool resampleAll;
+        std::vector<CoordOfCube> dirtyCubes;
+        std::unordered_map<std::uint64_t, std::tuple<std::uint8_t, std::uint8_t, std::uint8_t, std::uint8_t>> colors;
+    };
+    QFuture<void> volumeBuild;
+    bool volumeUploadPending{false};
+    int volumeTexLen{0};
+    CoordOfCube volumeCenter;
+    int volumeMag{0};
+    std::vector<std::uint64_t> volumeIds;// most frequent id within the footprint of each texel
+    std::vector<std::uint8_t> volumeColors;// rgba staging of the texture
+    std::vector<std::uint8_t> volumeOccupancy;// coarse grid of non-empty blocks for empty-space skipping
+    QOpenGLShaderProgram volumeShader;
+    void buildVolume(const VolumeSource & source);
     void renderVolumeVP();
     void renderSkeletonVP(const RenderOptions & options = RenderOptions());
     virtual void renderViewport(const RenderOptions &options = RenderOptions()) override;
@@ -64,6 +97,8 @@ public:
     ~Viewport3D();
     virtual void showHideButtons(bool isShow) override;
     void updateVolumeTexture();
+    QMutex volumeDirtyMutex;
+    std::unordered_set<CoordOfCube> volumeDirtyCubes;// overlay cubes changed since the last volume build
     static bool showBoundariesInUm;
 
 public slots:
@@ -63,13 +63,14 @@ void ViewportArb::updateOverlayTexture() {
     const auto begin = leftUpperPxInAbsPx_float;
     std::vector<char> texData(4 * std::pow(state->viewerState->texEdgeLength, 2));
     boost::multi_array_ref<uint8_t, 3> viewportView(reinterpret_cast<uint8_t *>(texData.data()), boost::extents[width][height][4]);
+    VoxelCursor cursor;// every cube is looked up once
     for (int y = 0; y < height; ++y)
     for (int x = 0; x < width; ++x) {
         const auto dataPos = static_cast<Coordinate>(begin + v1 * Dataset::current().magnification * x - v2 * Dataset::current().magnification * y);
         if (dataPos.x < 0 || dataPos.y < 0 || dataPos.z < 0) {
             viewportView[y][x][0] = viewportView[y][x][1] = viewportView[y][x][2] = viewportView[y][x][3] = 0;
         } else {
-            const auto soid = readVoxel(dataPos);
+            const auto soid = cursor.read(dataPos);
             const auto color = Segmentation::singleton().colorObjectFromSubobjectId(soid);
             viewportView[y][x][0] = std::get<0>(color);
             viewportView[y][x][1] = std::get<1>(color);
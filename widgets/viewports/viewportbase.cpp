@@ -451,7 +451,7 @@ void ViewportBase::takeSnapshot(const SnapshotOptions & o) {
     QImage fboImage;
     { // fbo scope
     auto fbo = std::make_shared<QOpenGLFramebufferObject>(o.size, o.size, format);
-    snapshotFbo = fbo;
+    offscreenFbo = fbo;
     const auto options = RenderOptions::snapshotRenderOptions(o.withAxes, o.withBox, o.withOverlay, o.withMesh, o.withSkeleton, o.withVpPlanes);
     fbo->bind();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Qt does not clear it?
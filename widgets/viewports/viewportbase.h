@@ -41,6 +41,9 @@
 
 #include <boost/optional.hpp>
 
+#include <functional>
+#include <memory>
+
 enum ViewportType {VIEWPORT_XY, VIEWPORT_XZ, VIEWPORT_ZY, VIEWPORT_ARBITRARY, VIEWPORT_SKELETON, VIEWPORT_UNDEFINED};
 Q_DECLARE_METATYPE(ViewportType)
 
@@ -129,7 +132,9 @@ Coordinate getCoordinateFromOrthogonalClick(const QPointF pos, ViewportOrtho & v
 class ViewportBase : public QOpenGLWidget, protected QOpenGLFunctions_1_4 { // glBlendFuncSeparate requires 1.4
     Q_OBJECT
 protected:
-    std::weak_ptr<QOpenGLFramebufferObject> snapshotFbo;
+    std::weak_ptr<QOpenGLFramebufferObject> offscreenFbo;// target of snapshots and reduced resolution frames, rebound after intermediate passes
+    std::shared_ptr<QOpenGLFramebufferObject> reducedFbo;
+    float reducedScale{1.f};// fraction of the viewport resolution the current frame is rendered at
     QVBoxLayout vpLayout;
     QHBoxLayout vpHeadLayout;
     QToolButton menuButton;
@@ -179,6 +184,7 @@ protected:
     virtual void renderNode(const nodeListElement & node, const RenderOptions & options = RenderOptions());
     bool updateFrustumClippingPlanes();
     virtual void renderViewportFrontFace();
+    void renderAdaptive(const std::function<void()> & render);
     hash_list<nodeListElement *> pickNodes(int centerX, int centerY, int width, int height);
     boost::optional<nodeListElement &> pickNode(int x, int y, int width);
     void handleLinkToggle(const QMouseEvent & event);
@@ -30,6 +30,7 @@
 #include "gui_wrapper.h"
 #include "scriptengine/scripting.h"
 #include "segmentation/cubeloader.h"
+#include "segmentation/editjournal.h"
 #include "segmentation/segmentation.h"
 #include "segmentation/segmentationsplit.h"
 #include "session.h"
@@ -116,7 +117,7 @@ void ViewportOrtho::handleMouseHover(const QMouseEvent *event) {
     Segmentation::singleton().hoverSubObject(subObjectId);
     EmitOnCtorDtor eocd(&SignalRelay::Signal_EventModel_handleMouseHover, state->signalRelay, coord, subObjectId, viewportType, event);
     if(Segmentation::singleton().hoverVersion && Dataset::current().overlay) {
-        Segmentation::singleton().mouseFocusedObjectId = Segmentation::singleton().tryLargestObjectContainingSubobject(subObjectId);
+        Segmentation::singleton().mouseFocusedObjectId = Segmentation::singleton().subobjectRenderInfo(subObjectId).objectId;
     }
     ViewportBase::handleMouseHover(event);
 }
@@ -171,6 +172,7 @@ void ViewportOrtho::handleMouseButtonRight(const QMouseEvent *event) {
     const auto & annotationMode = Session::singleton().annotationMode;
     if (annotationMode.testFlag(AnnotationMode::Brush)) {
         Segmentation::singleton().brush.setInverse(event->modifiers().testFlag(Qt::ShiftModifier));
+        beginBrushStroke();
         segmentation_brush_work(event, *this);
         return;
     }
@@ -327,6 +329,7 @@ void ViewportOrtho::handleMouseMotionRightHold(const QMouseEvent *event) {
     if (Session::singleton().annotationMode.testFlag(AnnotationMode::Brush)) {
         const bool notOrigin = event->pos() != mouseDown;//don’t do redundant work
         if (notOrigin) {
+            beginBrushStroke();// a new one if the stroke was closed meanwhile
             segmentation_brush_work(event, *this);
         }
     }
@@ -414,9 +417,11 @@ void ViewportOrtho::handleMouseReleaseLeft(const QMouseEvent *event) {
 void ViewportOrtho::handleMouseReleaseRight(const QMouseEvent *event) {
     if (Session::singleton().annotationMode.testFlag(AnnotationMode::Brush)) {
         if (event->pos() != mouseDown) {//merge took already place on mouse down
+            beginBrushStroke();
             segmentation_brush_work(event, *this);
         }
     }
+    endBrushStroke();
     ViewportBase::handleMouseReleaseRight(event);
 }
 
@@ -674,6 +679,30 @@ void Viewport3D::handleKeyRelease(const QKeyEvent *event) {
     ViewportBase::handleKeyRelease(event);
 }
 
+void ViewportOrtho::beginBrushStroke() {
+    if (!brushStrokeOpen) {
+        brushStrokeOpen = true;
+        EditJournal::singleton().beginEdit();
+    }
+}
+
+void ViewportOrtho::endBrushStroke() {
+    if (brushStrokeOpen) {
+        brushStrokeOpen = false;
+        EditJournal::singleton().endEdit();
+    }
+}
+
+void ViewportOrtho::focusOutEvent(QFocusEvent * event) {
+    endBrushStroke();
+    ViewportBase::focusOutEvent(event);
+}
+
+void ViewportOrtho::leaveEvent(QEvent * event) {
+    endBrushStroke();
+    ViewportBase::leaveEvent(event);
+}
+
 void Viewport3D::focusOutEvent(QFocusEvent * event) {
     resetWiggle();
     QWidget::focusOutEvent(event);
@@ -26,6 +26,8 @@
 #include "stateInfo.h"
 #include "viewer.h"
 
+#include <cmath>
+
 bool ViewportOrtho::showNodeComments = false;
 
 ViewportOrtho::ViewportOrtho(QWidget *parent, ViewportType viewportType) : ViewportBase(parent, viewportType) {
@@ -68,6 +70,11 @@ ViewportOrtho::~ViewportOrtho() {
         glDeleteTextures(1, &texture.overlayHandle);
     }
     texture.texHandle = texture.overlayHandle = 0;
+    dcUploadBuffer.destroy();
+    ocUploadBuffer.destroy();
+    dcUploadRing.destroy();
+    ocUploadRing.destroy();
+    uploadTimes.destroy();
 }
 
 void ViewportOrtho::initializeGL() {
@@ -98,15 +105,36 @@ void ViewportOrtho::initializeGL() {
 
     resetTexture();// allocates textures
 
+    if (context()->hasExtension("GL_ARB_pixel_buffer_object") || context()->format().version() >= qMakePair(2, 1)) {
+        for (auto * buffer : {&dcUploadBuffer, &ocUploadBuffer}) {
+            buffer->create();
+            buffer->setUsagePattern(QOpenGLBuffer::StreamDraw);
+        }
+    }
+    if (viewportType != VIEWPORT_ARBITRARY) {// arb slices are uploaded from the staging buffer
+        dcUploadRing.initialize(*context());
+        ocUploadRing.initialize(*context());
+    }
+    uploadTimes.setSampleCount(2);
+    uploadTimes.create();// stays uncreated without timer query support
+
     if (state->gpuSlicer) {
         if (viewportType == ViewportType::VIEWPORT_XY) {
 //            state->viewer->gpucubeedge = 128;
+            const auto cpucubeedge = Dataset::current().cubeEdgeLength;
+            const auto gpucubeedge = state->viewer->gpucubeedge;
+            const std::size_t supercubeedge = state->M * cpucubeedge / gpucubeedge - (cpucubeedge / gpucubeedge - 1);
             state->viewer->layers.emplace_back(*context());
-            state->viewer->layers.back().createBogusCube(Dataset::current().cubeEdgeLength, state->viewer->gpucubeedge);
+            state->viewer->layers.back().createBogusCube(cpucubeedge, gpucubeedge);
+            state->viewer->layers.back().preallocate(std::pow(supercubeedge, 3));
+            state->viewer->layers.back().startStreaming();
             state->viewer->layers.emplace_back(*context());
 //            state->viewer->layers.back().enabled = false;
             state->viewer->layers.back().isOverlayData = true;
-            state->viewer->layers.back().createBogusCube(Dataset::current().cubeEdgeLength, state->viewer->gpucubeedge);
+            state->viewer->layers.back().createBogusCube(cpucubeedge, gpucubeedge);
+            state->viewer->layers.back().preallocate(std::pow(supercubeedge, 3));
+            state->viewer->layers.back().startStreaming();
+            makeCurrent();// the layers’ contexts were current while setting them up
         }
 
         glEnable(GL_TEXTURE_3D);
@@ -128,10 +156,10 @@ void ViewportOrtho::paintGL() {
     glEnable(GL_BLEND);
     glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
     if (state->gpuSlicer && state->viewer->gpuRendering) {
-        renderViewportFast();
+        renderAdaptive([this]() { renderViewportFast(); });
     } else {
         state->viewer->vpGenerateTexture(*this);
-        renderViewport();
+        renderAdaptive([this]() { renderViewport(); });
     }
     renderViewportFrontFace();
 }
@@ -26,15 +26,45 @@
 #include "coordinate.h"
 #include "mesh/mesh.h"
 #include "skeleton/node.h"
+#include "uploadring.h"
 #include "viewportbase.h"
 
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QOpenGLBuffer>
+#include <QOpenGLTimeMonitor>
+
+#include <array>
 #include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class gpu_raw_cube;
+class TextureLayer;
 
 class ViewportOrtho : public ViewportBase {
     Q_OBJECT
     QOpenGLShaderProgram raw_data_shader;
     QOpenGLShaderProgram overlay_data_shader;
 
+    struct GpuCubeDraw {
+        gpu_raw_cube * cube;
+        QMatrix4x4 modelMatrix;
+        std::vector<std::array<GLfloat, 3>> triangleVertices;// arb only, intersection of cube and plane
+        std::vector<std::array<GLfloat, 3>> textureVertices;
+    };
+    // the gpu cubes to draw per layer, only rebuilt when they or their placement change
+    struct GpuDrawList {
+        bool valid{false};
+        floatCoordinate origin;
+        floatCoordinate v1, v2, n;
+        std::size_t texturesRevision{0};
+        std::vector<GpuCubeDraw> draws;
+    };
+    std::unordered_map<const TextureLayer *, GpuDrawList> gpuDrawLists;
+    const std::vector<GpuCubeDraw> & gpuDrawList(TextureLayer & layer, const floatCoordinate & cpos, const float scale);
+
     QAction zoomResetAction{tr("Reset zoom"), &menuButton};
 
     floatCoordinate handleMovement(const QPoint & pos);
@@ -66,6 +96,11 @@ class ViewportOrtho : public ViewportBase {
     virtual void handleMouseMotionMiddleHold(const QMouseEvent *event) override;
     virtual void handleMouseReleaseMiddle(const QMouseEvent *event) override;
     virtual void handleWheelEvent(const QWheelEvent *event) override;
+    virtual void focusOutEvent(QFocusEvent *event) override;
+    virtual void leaveEvent(QEvent *event) override;
+
+    bool brushStrokeOpen{false};// holds an EditJournal edit, so that the whole stroke is undone at once
+    void beginBrushStroke();
 
 protected:
     virtual void initializeGL() override;
@@ -76,6 +111,7 @@ public:
     explicit ViewportOrtho(QWidget *parent, ViewportType viewportType);
     ~ViewportOrtho();
     void resetTexture();
+    void endBrushStroke();// when the release is not delivered, e.g. the work mode changed mid-stroke
     static bool showNodeComments;
 
     void sendCursorPosition();
@@ -86,12 +122,25 @@ public:
     floatCoordinate  n;// faces away from the vp plane towards the camera
     std::atomic_bool dcResliceNecessary{true};
     std::atomic_bool ocResliceNecessary{true};
+    // cubes whose tiles have changed, only these are resliced unless a full reslice is necessary
+    QMutex dirtyCubesMutex;
+    std::unordered_set<CoordOfCube> dcDirtyCubes;
+    std::unordered_set<CoordOfCube> ocDirtyCubes;
     float displayedIsoPx;
     float screenPxYPerDataPx;
     float displayedlengthInNmY;
 
     char * viewPortData;
     viewportTexture texture;
+    // slices of all cubes as assembled by vpGenerateTexture, written directly into the upload rings if supported
+    // otherwise into the staging buffers which are uploaded through the pixel buffers if those are supported
+    UploadRing dcUploadRing;
+    UploadRing ocUploadRing;
+    std::vector<std::uint8_t> dcStaging;
+    std::vector<std::uint8_t> ocStaging;
+    QOpenGLBuffer dcUploadBuffer{QOpenGLBuffer::PixelUnpackBuffer};
+    QOpenGLBuffer ocUploadBuffer{QOpenGLBuffer::PixelUnpackBuffer};
+    QOpenGLTimeMonitor uploadTimes;// gpu time of the uploads, reset every frame
     float screenPxXPerDataPxForZoomFactor(const float zoomFactor) const { return edgeLength / (displayedEdgeLenghtXForZoomFactor(zoomFactor) / texture.texUnitsPerDataPx); }
     virtual float displayedEdgeLenghtXForZoomFactor(const float zoomFactor) const;
 